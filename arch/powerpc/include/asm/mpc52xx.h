@@ -14,6 +14,7 @@
 #define __ASM_POWERPC_MPC52xx_H__
 
 #ifndef __ASSEMBLY__
+#include <linux/list.h>
 #include <asm/types.h>
 #include <asm/prom.h>
 #include <asm/mpc5xxx.h>
@@ -112,6 +113,14 @@ struct mpc52xx_gpt {
 	u32 status;		/* GPTx + 0X0c */
 };
 
+/* SLT */
+struct mpc52xx_slt {
+	u32 terminal_count;	/* SLTx + 0x00 */
+	u32 control;		/* SLTx + 0x04 */
+	u32 count;		/* SLTx + 0x08 */
+	u32 status;		/* SLTx + 0x0c */
+};
+
 /* GPIO */
 struct mpc52xx_gpio {
 	u32 port_config;	/* GPIO + 0x00 */
@@ -293,6 +302,64 @@ extern void mpc52xx_restart(char *cmd);
 extern void mpc52xx_init_irq(void);
 extern unsigned int mpc52xx_get_irq(void);
 
+/* mpc52xx_gpt.c */
+struct mpc52xx_gpt_priv;
+extern struct mpc52xx_gpt_priv *mpc52xx_gpt_from_node(struct device_node *np);
+extern int mpc52xx_gpt_request_timer(struct mpc52xx_gpt_priv *gpt,
+				     void (*fn)(void *data), void *data);
+extern void mpc52xx_gpt_free_timer(struct mpc52xx_gpt_priv *gpt);
+extern int mpc52xx_gpt_start_timer(struct mpc52xx_gpt_priv *gpt, u64 period,
+				   int continuous);
+extern void mpc52xx_gpt_stop_timer(struct mpc52xx_gpt_priv *gpt);
+
+/* One edge of the input pin of a GPT in input capture mode */
+struct mpc52xx_gpt_capture {
+	u32 ticks;		/* since the previous edge, in counter clocks */
+	u32 flags;
+};
+#define MPC52xx_GPT_CAPTURE_LEVEL	0x1	/* pin high after the edge */
+#define MPC52xx_GPT_CAPTURE_OVERFLOW	0x2	/* ticks is only a minimum */
+#define MPC52xx_GPT_CAPTURE_LOST	0x4	/* edges dropped before this */
+
+extern int mpc52xx_gpt_request_capture(struct mpc52xx_gpt_priv *gpt, u32 rate,
+				       unsigned int depth,
+				       void (*fn)(void *data), void *data);
+extern int mpc52xx_gpt_read_capture(struct mpc52xx_gpt_priv *gpt,
+				    struct mpc52xx_gpt_capture *cap);
+extern u32 mpc52xx_gpt_capture_rate(struct mpc52xx_gpt_priv *gpt);
+extern void mpc52xx_gpt_free_capture(struct mpc52xx_gpt_priv *gpt);
+
+/* mpc52xx_lpbfifo.c */
+#define MPC52xx_LPBFIFO_FLAG_READ		(0)
+#define MPC52xx_LPBFIFO_FLAG_WRITE		(1<<0)
+#define MPC52xx_LPBFIFO_FLAG_NO_INCREMENT	(1<<1)
+
+struct mpc52xx_lpbfifo_request {
+	struct list_head list;
+
+	/* LocalPlus bus side: chip select and offset into its window */
+	unsigned int cs;
+	size_t offset;
+
+	/* Memory side; must be DMA-able, everything 32-bit aligned */
+	void *data;
+	size_t size;
+	int flags;
+
+	/* Called from interrupt context once the request is finished */
+	void (*callback)(struct mpc52xx_lpbfifo_request *req);
+	void *priv;
+
+	/* Filled in by the driver */
+	size_t pos;		/* bytes transferred so far */
+	int status;		/* 0 or -errno once finished */
+	dma_addr_t data_phys;
+};
+
+extern int mpc52xx_lpbfifo_submit(struct mpc52xx_lpbfifo_request *req);
+extern int mpc52xx_lpbfifo_abort(struct mpc52xx_lpbfifo_request *req);
+extern int mpc52xx_lpbfifo_transfer(struct mpc52xx_lpbfifo_request *req);
+
 /* mpc52xx_pci.c */
 #ifdef CONFIG_PCI
 extern int __init mpc52xx_add_bridge(struct device_node *node);
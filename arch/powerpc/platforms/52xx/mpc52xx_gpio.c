@@ -22,15 +22,15 @@
 #include <linux/of_gpio.h>
 #include <linux/io.h>
 #include <linux/of_platform.h>
+#include <linux/bitrev.h>
 
 #include <asm/gpio.h>
 #include <asm/mpc52xx.h>
 #include <sysdev/fsl_soc.h>
 
-static DEFINE_SPINLOCK(gpio_lock);
-
 struct mpc52xx_gpiochip {
 	struct of_mm_gpio_chip mmchip;
+	spinlock_t lock;	/* protects the shadow registers */
 	unsigned int shadow_dvo;
 	unsigned int shadow_gpioe;
 	unsigned int shadow_ddr;
@@ -84,13 +84,16 @@ __mpc52xx_wkup_gpio_set(struct gpio_chip *gc, unsigned int gpio, int val)
 static void
 mpc52xx_wkup_gpio_set(struct gpio_chip *gc, unsigned int gpio, int val)
 {
+	struct of_mm_gpio_chip *mm_gc = to_of_mm_gpio_chip(gc);
+	struct mpc52xx_gpiochip *chip = container_of(mm_gc,
+			struct mpc52xx_gpiochip, mmchip);
 	unsigned long flags;
 
-	spin_lock_irqsave(&gpio_lock, flags);
+	spin_lock_irqsave(&chip->lock, flags);
 
 	__mpc52xx_wkup_gpio_set(gc, gpio, val);
 
-	spin_unlock_irqrestore(&gpio_lock, flags);
+	spin_unlock_irqrestore(&chip->lock, flags);
 
 	pr_debug("%s: gpio: %d val: %d\n", __func__, gpio, val);
 }
@@ -103,7 +106,7 @@ static int mpc52xx_wkup_gpio_dir_in(struct gpio_chip *gc, unsigned int gpio)
 	struct mpc52xx_gpio_wkup __iomem *regs = mm_gc->regs;
 	unsigned long flags;
 
-	spin_lock_irqsave(&gpio_lock, flags);
+	spin_lock_irqsave(&chip->lock, flags);
 
 	/* set the direction */
 	chip->shadow_ddr &= ~(1 << (7 - gpio));
@@ -113,7 +116,7 @@ static int mpc52xx_wkup_gpio_dir_in(struct gpio_chip *gc, unsigned int gpio)
 	chip->shadow_gpioe |= 1 << (7 - gpio);
 	out_8(&regs->wkup_gpioe, chip->shadow_gpioe);
 
-	spin_unlock_irqrestore(&gpio_lock, flags);
+	spin_unlock_irqrestore(&chip->lock, flags);
 
 	return 0;
 }
@@ -127,7 +130,7 @@ mpc52xx_wkup_gpio_dir_out(struct gpio_chip *gc, unsigned int gpio, int val)
 			struct mpc52xx_gpiochip, mmchip);
 	unsigned long flags;
 
-	spin_lock_irqsave(&gpio_lock, flags);
+	spin_lock_irqsave(&chip->lock, flags);
 
 	__mpc52xx_wkup_gpio_set(gc, gpio, val);
 
@@ -139,13 +142,45 @@ mpc52xx_wkup_gpio_dir_out(struct gpio_chip *gc, unsigned int gpio, int val)
 	chip->shadow_gpioe |= 1 << (7 - gpio);
 	out_8(&regs->wkup_gpioe, chip->shadow_gpioe);
 
-	spin_unlock_irqrestore(&gpio_lock, flags);
+	spin_unlock_irqrestore(&chip->lock, flags);
 
 	pr_debug("%s: gpio: %d val: %d\n", __func__, gpio, val);
 
 	return 0;
 }
 
+/*
+ * Port access.  gpiolib numbers the lines from bit 0 up while the port
+ * registers count from the MSB down, so masks and values are mirrored.
+ */
+static unsigned long
+mpc52xx_wkup_gpio_get_port(struct gpio_chip *gc, unsigned long mask)
+{
+	struct of_mm_gpio_chip *mm_gc = to_of_mm_gpio_chip(gc);
+	struct mpc52xx_gpio_wkup __iomem *regs = mm_gc->regs;
+
+	return bitrev8(in_8(&regs->wkup_ival)) & mask;
+}
+
+static void
+mpc52xx_wkup_gpio_set_port(struct gpio_chip *gc, unsigned long mask,
+			   unsigned long val)
+{
+	struct of_mm_gpio_chip *mm_gc = to_of_mm_gpio_chip(gc);
+	struct mpc52xx_gpiochip *chip = container_of(mm_gc,
+			struct mpc52xx_gpiochip, mmchip);
+	struct mpc52xx_gpio_wkup __iomem *regs = mm_gc->regs;
+	unsigned long flags;
+	u8 m = bitrev8(mask), v = bitrev8(val);
+
+	spin_lock_irqsave(&chip->lock, flags);
+
+	chip->shadow_dvo = (chip->shadow_dvo & ~m) | (v & m);
+	out_8(&regs->wkup_dvo, chip->shadow_dvo);
+
+	spin_unlock_irqrestore(&chip->lock, flags);
+}
+
 static int __devinit mpc52xx_wkup_gpiochip_probe(struct of_device *ofdev,
 					const struct of_device_id *match)
 {
@@ -158,6 +193,7 @@ static int __devinit mpc52xx_wkup_gpiochip_probe(struct of_device *ofdev,
 	if (!chip)
 		return -ENOMEM;
 
+	spin_lock_init(&chip->lock);
 	ofchip = &chip->mmchip.of_gc;
 
 	ofchip->gpio_cells          = 2;
@@ -166,6 +202,8 @@ static int __devinit mpc52xx_wkup_gpiochip_probe(struct of_device *ofdev,
 	ofchip->gc.direction_output = mpc52xx_wkup_gpio_dir_out;
 	ofchip->gc.get              = mpc52xx_wkup_gpio_get;
 	ofchip->gc.set              = mpc52xx_wkup_gpio_set;
+	ofchip->gc.get_port         = mpc52xx_wkup_gpio_get_port;
+	ofchip->gc.set_port         = mpc52xx_wkup_gpio_set_port;
 
 	ret = of_mm_gpiochip_add(ofdev->node, &chip->mmchip);
 	if (ret)
@@ -244,13 +282,16 @@ __mpc52xx_simple_gpio_set(struct gpio_chip *gc, unsigned int gpio, int val)
 static void
 mpc52xx_simple_gpio_set(struct gpio_chip *gc, unsigned int gpio, int val)
 {
+	struct of_mm_gpio_chip *mm_gc = to_of_mm_gpio_chip(gc);
+	struct mpc52xx_gpiochip *chip = container_of(mm_gc,
+			struct mpc52xx_gpiochip, mmchip);
 	unsigned long flags;
 
-	spin_lock_irqsave(&gpio_lock, flags);
+	spin_lock_irqsave(&chip->lock, flags);
 
 	__mpc52xx_simple_gpio_set(gc, gpio, val);
 
-	spin_unlock_irqrestore(&gpio_lock, flags);
+	spin_unlock_irqrestore(&chip->lock, flags);
 
 	pr_debug("%s: gpio: %d val: %d\n", __func__, gpio, val);
 }
@@ -263,7 +304,7 @@ static int mpc52xx_simple_gpio_dir_in(struct gpio_chip *gc, unsigned int gpio)
 	struct mpc52xx_gpio __iomem *regs = mm_gc->regs;
 	unsigned long flags;
 
-	spin_lock_irqsave(&gpio_lock, flags);
+	spin_lock_irqsave(&chip->lock, flags);
 
 	/* set the direction */
 	chip->shadow_ddr &= ~(1 << (31 - gpio));
@@ -273,7 +314,7 @@ static int mpc52xx_simple_gpio_dir_in(struct gpio_chip *gc, unsigned int gpio)
 	chip->shadow_gpioe |= 1 << (31 - gpio);
 	out_be32(&regs->simple_gpioe, chip->shadow_gpioe);
 
-	spin_unlock_irqrestore(&gpio_lock, flags);
+	spin_unlock_irqrestore(&chip->lock, flags);
 
 	return 0;
 }
@@ -287,7 +328,7 @@ mpc52xx_simple_gpio_dir_out(struct gpio_chip *gc, unsigned int gpio, int val)
 	struct mpc52xx_gpio __iomem *regs = mm_gc->regs;
 	unsigned long flags;
 
-	spin_lock_irqsave(&gpio_lock, flags);
+	spin_lock_irqsave(&chip->lock, flags);
 
 	/* First set initial value */
 	__mpc52xx_simple_gpio_set(gc, gpio, val);
@@ -300,13 +341,41 @@ mpc52xx_simple_gpio_dir_out(struct gpio_chip *gc, unsigned int gpio, int val)
 	chip->shadow_gpioe |= 1 << (31 - gpio);
 	out_be32(&regs->simple_gpioe, chip->shadow_gpioe);
 
-	spin_unlock_irqrestore(&gpio_lock, flags);
+	spin_unlock_irqrestore(&chip->lock, flags);
 
 	pr_debug("%s: gpio: %d val: %d\n", __func__, gpio, val);
 
 	return 0;
 }
 
+static unsigned long
+mpc52xx_simple_gpio_get_port(struct gpio_chip *gc, unsigned long mask)
+{
+	struct of_mm_gpio_chip *mm_gc = to_of_mm_gpio_chip(gc);
+	struct mpc52xx_gpio __iomem *regs = mm_gc->regs;
+
+	return bitrev32(in_be32(&regs->simple_ival)) & mask;
+}
+
+static void
+mpc52xx_simple_gpio_set_port(struct gpio_chip *gc, unsigned long mask,
+			     unsigned long val)
+{
+	struct of_mm_gpio_chip *mm_gc = to_of_mm_gpio_chip(gc);
+	struct mpc52xx_gpiochip *chip = container_of(mm_gc,
+			struct mpc52xx_gpiochip, mmchip);
+	struct mpc52xx_gpio __iomem *regs = mm_gc->regs;
+	unsigned long flags;
+	u32 m = bitrev32(mask), v = bitrev32(val);
+
+	spin_lock_irqsave(&chip->lock, flags);
+
+	chip->shadow_dvo = (chip->shadow_dvo & ~m) | (v & m);
+	out_be32(&regs->simple_dvo, chip->shadow_dvo);
+
+	spin_unlock_irqrestore(&chip->lock, flags);
+}
+
 static int __devinit mpc52xx_simple_gpiochip_probe(struct of_device *ofdev,
 					const struct of_device_id *match)
 {
@@ -319,6 +388,7 @@ static int __devinit mpc52xx_simple_gpiochip_probe(struct of_device *ofdev,
 	if (!chip)
 		return -ENOMEM;
 
+	spin_lock_init(&chip->lock);
 	ofchip = &chip->mmchip.of_gc;
 
 	ofchip->gpio_cells          = 2;
@@ -327,6 +397,8 @@ static int __devinit mpc52xx_simple_gpiochip_probe(struct of_device *ofdev,
 	ofchip->gc.direction_output = mpc52xx_simple_gpio_dir_out;
 	ofchip->gc.get              = mpc52xx_simple_gpio_get;
 	ofchip->gc.set              = mpc52xx_simple_gpio_set;
+	ofchip->gc.get_port         = mpc52xx_simple_gpio_get_port;
+	ofchip->gc.set_port         = mpc52xx_simple_gpio_set_port;
 
 	ret = of_mm_gpiochip_add(ofdev->node, &chip->mmchip);
 	if (ret)
@@ -16,8 +16,12 @@
  * output signals or measure input signals.
  *
  * This driver supports the GPIO and IRQ controller functions of the GPT
- * device.  Timer functions are not yet supported, nor is the watchdog
- * timer.
+ * device.  A GPT which is used for neither can be claimed by other drivers
+ * as a simple one-shot or periodic timer (see mpc52xx_gpt_request_timer()).
+ * One such GPT can also be registered as a clock event device by adding
+ * the empty property 'fsl,clockevent' to its node, and a claimed GPT can
+ * timestamp the edges of its input pin (see mpc52xx_gpt_request_capture()).
+ * The watchdog timer is not yet supported.
  *
  * To use the GPIO function, the following two properties must be added
  * to the device tree node for the gpt device (typically in the .dts file
@@ -48,11 +52,16 @@
 
 #include <linux/irq.h>
 #include <linux/interrupt.h>
+#include <linux/clockchips.h>
 #include <linux/io.h>
 #include <linux/of.h>
 #include <linux/of_platform.h>
 #include <linux/of_gpio.h>
 #include <linux/kernel.h>
+#include <linux/kfifo.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <asm/div64.h>
 #include <asm/mpc52xx.h>
 
 MODULE_DESCRIPTION("Freescale MPC52xx gpt driver");
@@ -61,17 +70,35 @@ MODULE_LICENSE("GPL");
 
 /**
  * struct mpc52xx_gpt - Private data structure for MPC52xx GPT driver
+ * @list: entry in the list of all GPT devices
  * @dev: pointer to device structure
  * @regs: virtual address of GPT registers
  * @lock: spinlock to coordinate between different functions.
  * @of_gc: of_gpio_chip instance structure; used when GPIO is enabled
  * @irqhost: Pointer to irq_host instance; used when IRQ mode is supported
+ * @ipb_freq: frequency of the IPB bus clocking the timer
+ * @irq: virq of the GPT interrupt; used when the timer is claimed
+ * @timer_fn: callback on timer expiry; non-NULL when the timer is claimed
+ * @timer_data: argument of @timer_fn
+ * @capture: FIFO of struct mpc52xx_gpt_capture; used in input capture mode
+ * @capture_rate: frequency of the counter in input capture mode
+ * @capture_prev: counter value latched on the previous edge
+ * @capture_lost: set when the FIFO was full and an edge had to be dropped
  */
 struct mpc52xx_gpt_priv {
+	struct list_head list;
 	struct device *dev;
 	struct mpc52xx_gpt __iomem *regs;
 	spinlock_t lock;
 	struct irq_host *irqhost;
+	u32 ipb_freq;
+	int irq;
+	void (*timer_fn)(void *data);
+	void *timer_data;
+	struct kfifo *capture;
+	u32 capture_rate;
+	u16 capture_prev;
+	int capture_lost;
 
 #if defined(CONFIG_GPIOLIB)
 	struct of_gpio_chip of_gc;
@@ -89,6 +116,8 @@ struct mpc52xx_gpt_priv {
 #define MPC52xx_GPT_MODE_GPIO_OUT_HIGH	(0x30)
 
 #define MPC52xx_GPT_MODE_IRQ_EN		(0x0100)
+#define MPC52xx_GPT_MODE_CONTINUOUS	(0x0400)
+#define MPC52xx_GPT_MODE_COUNTER_ENABLE	(0x1000)
 
 #define MPC52xx_GPT_MODE_ICT_MASK	(0x030000)
 #define MPC52xx_GPT_MODE_ICT_RISING	(0x010000)
@@ -96,6 +125,10 @@ struct mpc52xx_gpt_priv {
 #define MPC52xx_GPT_MODE_ICT_TOGGLE	(0x030000)
 
 #define MPC52xx_GPT_STATUS_IRQMASK	(0x000f)
+#define MPC52xx_GPT_STATUS_PIN		(0x0100)
+#define MPC52xx_GPT_STATUS_OVF_SHIFT	(12)
+#define MPC52xx_GPT_STATUS_OVF_MASK	(0x7000)
+#define MPC52xx_GPT_STATUS_CAPTURE_SHIFT (16)
 
 /* ---------------------------------------------------------------------
  * Cascaded interrupt controller hooks
@@ -335,6 +368,406 @@ static void
 mpc52xx_gpt_gpio_setup(struct mpc52xx_gpt_priv *p, struct device_node *np) { }
 #endif /* defined(CONFIG_GPIOLIB) */
 
+/* ---------------------------------------------------------------------
+ * Timer API
+ */
+static LIST_HEAD(mpc52xx_gpt_list);
+static DEFINE_MUTEX(mpc52xx_gpt_list_mutex);
+
+/**
+ * mpc52xx_gpt_from_node - Find the GPT instance for a device tree node
+ * @np: the GPT node, usually obtained through a phandle
+ */
+struct mpc52xx_gpt_priv *mpc52xx_gpt_from_node(struct device_node *np)
+{
+	struct mpc52xx_gpt_priv *gpt;
+
+	mutex_lock(&mpc52xx_gpt_list_mutex);
+	list_for_each_entry(gpt, &mpc52xx_gpt_list, list) {
+		if (gpt->dev->archdata.of_node == np) {
+			mutex_unlock(&mpc52xx_gpt_list_mutex);
+			return gpt;
+		}
+	}
+	mutex_unlock(&mpc52xx_gpt_list_mutex);
+
+	return NULL;
+}
+EXPORT_SYMBOL(mpc52xx_gpt_from_node);
+
+/* Called from the interrupt handler in input capture mode; the only
+ * producer of the capture FIFO, so no locking is needed */
+static void mpc52xx_gpt_capture_push(struct mpc52xx_gpt_priv *gpt, u32 status)
+{
+	struct mpc52xx_gpt_capture cap;
+	u16 count = status >> MPC52xx_GPT_STATUS_CAPTURE_SHIFT;
+	u32 ovf = (status & MPC52xx_GPT_STATUS_OVF_MASK) >>
+		  MPC52xx_GPT_STATUS_OVF_SHIFT;
+
+	/* The hardware counts at most 7 overflows between two captures;
+	 * at 7 the gap may have been longer than what can be measured */
+	cap.ticks = ovf * 0x10000 + count - gpt->capture_prev;
+	cap.flags = 0;
+	if (ovf == MPC52xx_GPT_STATUS_OVF_MASK >> MPC52xx_GPT_STATUS_OVF_SHIFT)
+		cap.flags |= MPC52xx_GPT_CAPTURE_OVERFLOW;
+	if (status & MPC52xx_GPT_STATUS_PIN)
+		cap.flags |= MPC52xx_GPT_CAPTURE_LEVEL;
+	if (gpt->capture_lost)
+		cap.flags |= MPC52xx_GPT_CAPTURE_LOST;
+	gpt->capture_prev = count;
+
+	/* The FIFO size is a multiple of the record size, so a record
+	 * either fits entirely or not at all */
+	gpt->capture_lost = !__kfifo_put(gpt->capture, (unsigned char *)&cap,
+					 sizeof(cap));
+}
+
+static irqreturn_t mpc52xx_gpt_timer_irq(int irq, void *dev_id)
+{
+	struct mpc52xx_gpt_priv *gpt = dev_id;
+	u32 status;
+
+	status = in_be32(&gpt->regs->status);
+	if (!(status & MPC52xx_GPT_STATUS_IRQMASK))
+		return IRQ_NONE;
+
+	out_be32(&gpt->regs->status, MPC52xx_GPT_STATUS_IRQMASK);
+	if (gpt->capture)
+		mpc52xx_gpt_capture_push(gpt, status);
+	gpt->timer_fn(gpt->timer_data);
+
+	return IRQ_HANDLED;
+}
+
+static int __mpc52xx_gpt_request_timer(struct mpc52xx_gpt_priv *gpt,
+				       void (*fn)(void *data), void *data,
+				       unsigned long irqflags)
+{
+	unsigned long flags;
+	int rc;
+
+	if (gpt->irqhost || gpt->irq == NO_IRQ)
+		return -EINVAL;
+#if defined(CONFIG_GPIOLIB)
+	if (gpt->of_gc.gc.label)
+		return -EBUSY;
+#endif
+
+	spin_lock_irqsave(&gpt->lock, flags);
+	if (gpt->timer_fn) {
+		spin_unlock_irqrestore(&gpt->lock, flags);
+		return -EBUSY;
+	}
+	gpt->timer_fn = fn;
+	gpt->timer_data = data;
+
+	/* Internal timer only, counter stopped */
+	out_be32(&gpt->regs->mode, 0);
+	spin_unlock_irqrestore(&gpt->lock, flags);
+
+	rc = request_irq(gpt->irq, mpc52xx_gpt_timer_irq, irqflags,
+			 "mpc52xx-gpt", gpt);
+	if (rc)
+		gpt->timer_fn = NULL;
+
+	return rc;
+}
+
+/**
+ * mpc52xx_gpt_request_timer - Claim a GPT for use as an internal timer
+ * @gpt: the GPT instance
+ * @fn: called from interrupt context each time the timer expires
+ * @data: argument passed to @fn
+ *
+ * A GPT used as GPIO or interrupt controller cannot be claimed.
+ */
+int mpc52xx_gpt_request_timer(struct mpc52xx_gpt_priv *gpt,
+			      void (*fn)(void *data), void *data)
+{
+	return __mpc52xx_gpt_request_timer(gpt, fn, data, 0);
+}
+EXPORT_SYMBOL(mpc52xx_gpt_request_timer);
+
+/**
+ * mpc52xx_gpt_free_timer - Release a GPT claimed with mpc52xx_gpt_request_timer()
+ * @gpt: the GPT instance
+ */
+void mpc52xx_gpt_free_timer(struct mpc52xx_gpt_priv *gpt)
+{
+	mpc52xx_gpt_stop_timer(gpt);
+	free_irq(gpt->irq, gpt);
+	gpt->timer_fn = NULL;
+}
+EXPORT_SYMBOL(mpc52xx_gpt_free_timer);
+
+/**
+ * mpc52xx_gpt_start_timer - (Re)start a claimed GPT
+ * @gpt: the GPT instance
+ * @period: expiry time in nanoseconds
+ * @continuous: non-zero to reload and fire every @period
+ *
+ * May be called from any context, including the expiry callback.
+ */
+int mpc52xx_gpt_start_timer(struct mpc52xx_gpt_priv *gpt, u64 period,
+			    int continuous)
+{
+	u32 clear, set;
+	u64 clocks;
+	u32 prescale;
+	unsigned long flags;
+
+	clear = MPC52xx_GPT_MODE_MS_MASK | MPC52xx_GPT_MODE_CONTINUOUS;
+	set = MPC52xx_GPT_MODE_COUNTER_ENABLE | MPC52xx_GPT_MODE_IRQ_EN;
+	if (continuous)
+		set |= MPC52xx_GPT_MODE_CONTINUOUS;
+
+	/* Determine the number of clocks in the requested period.  64 bit
+	 * arithmetic is done here to preserve the precision until the value
+	 * is scaled back down into the u32 range.  Period is in 'ns', bus
+	 * frequency is in Hz. */
+	clocks = period * (u64)gpt->ipb_freq;
+	do_div(clocks, 1000000000);
+
+	/* The counter is 16 bits with a 16 bit prescaler in front of it */
+	if (clocks == 0 || clocks > 0xffffffffull)
+		return -EINVAL;
+
+	/* The prescaler is '1' based: 0x0000 divides by 0x10000, which is
+	 * why prescale is a u32 here. */
+	prescale = (clocks >> 16) + 1;
+	do_div(clocks, prescale);
+	if (clocks > 0xffff)
+		return -EINVAL;
+
+	spin_lock_irqsave(&gpt->lock, flags);
+	clrbits32(&gpt->regs->mode, MPC52xx_GPT_MODE_COUNTER_ENABLE);
+	out_be32(&gpt->regs->count, prescale << 16 | clocks);
+	clrsetbits_be32(&gpt->regs->mode, clear, set);
+	spin_unlock_irqrestore(&gpt->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(mpc52xx_gpt_start_timer);
+
+/**
+ * mpc52xx_gpt_stop_timer - Stop a claimed GPT
+ * @gpt: the GPT instance
+ */
+void mpc52xx_gpt_stop_timer(struct mpc52xx_gpt_priv *gpt)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&gpt->lock, flags);
+	clrbits32(&gpt->regs->mode, MPC52xx_GPT_MODE_COUNTER_ENABLE |
+				    MPC52xx_GPT_MODE_IRQ_EN);
+	out_be32(&gpt->regs->status, MPC52xx_GPT_STATUS_IRQMASK);
+	spin_unlock_irqrestore(&gpt->lock, flags);
+}
+EXPORT_SYMBOL(mpc52xx_gpt_stop_timer);
+
+/**
+ * mpc52xx_gpt_request_capture - Claim a GPT to timestamp its input edges
+ * @gpt: the GPT instance
+ * @rate: requested counter frequency in Hz; the resolution of the stamps
+ * @depth: number of edges buffered until read
+ * @fn: called from interrupt context after each edge has been queued
+ * @data: argument passed to @fn
+ *
+ * The counter value is latched by the hardware on every edge of the input
+ * pin, so interrupt latency does not affect the measurements.  Edges are
+ * retrieved with mpc52xx_gpt_read_capture(), from @fn or from any other
+ * single context.  mpc52xx_gpt_capture_rate() returns the exact counter
+ * frequency.
+ */
+int mpc52xx_gpt_request_capture(struct mpc52xx_gpt_priv *gpt, u32 rate,
+				unsigned int depth, void (*fn)(void *data),
+				void *data)
+{
+	struct kfifo *fifo;
+	unsigned long flags;
+	u32 prescale;
+	int rc;
+
+	if (!rate || !depth)
+		return -EINVAL;
+	prescale = DIV_ROUND_UP(gpt->ipb_freq, rate);
+	if (prescale == 0 || prescale > 0xffff)
+		return -EINVAL;
+
+	fifo = kfifo_alloc(roundup_pow_of_two(depth) *
+			   sizeof(struct mpc52xx_gpt_capture), GFP_KERNEL, NULL);
+	if (IS_ERR(fifo))
+		return PTR_ERR(fifo);
+
+	/* Leaves the counter stopped and its interrupt disabled */
+	rc = mpc52xx_gpt_request_timer(gpt, fn, data);
+	if (rc) {
+		kfifo_free(fifo);
+		return rc;
+	}
+
+	gpt->capture = fifo;
+	gpt->capture_rate = gpt->ipb_freq / prescale;
+	gpt->capture_prev = 0;
+	gpt->capture_lost = 0;
+
+	spin_lock_irqsave(&gpt->lock, flags);
+	out_be32(&gpt->regs->count, prescale << 16);
+	out_be32(&gpt->regs->mode, MPC52xx_GPT_MODE_MS_IC |
+				   MPC52xx_GPT_MODE_CONTINUOUS |
+				   MPC52xx_GPT_MODE_IRQ_EN);
+	spin_unlock_irqrestore(&gpt->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(mpc52xx_gpt_request_capture);
+
+/**
+ * mpc52xx_gpt_read_capture - Retrieve the oldest buffered edge
+ * @gpt: the GPT instance
+ * @cap: filled with the edge
+ *
+ * Returns 0, or -EAGAIN if no edge is buffered.  Must not be called from
+ * more than one context at a time.
+ */
+int mpc52xx_gpt_read_capture(struct mpc52xx_gpt_priv *gpt,
+			     struct mpc52xx_gpt_capture *cap)
+{
+	if (__kfifo_get(gpt->capture, (unsigned char *)cap, sizeof(*cap)) !=
+	    sizeof(*cap))
+		return -EAGAIN;
+	return 0;
+}
+EXPORT_SYMBOL(mpc52xx_gpt_read_capture);
+
+/**
+ * mpc52xx_gpt_capture_rate - Frequency of the counter in capture mode
+ * @gpt: the GPT instance, claimed with mpc52xx_gpt_request_capture()
+ */
+u32 mpc52xx_gpt_capture_rate(struct mpc52xx_gpt_priv *gpt)
+{
+	return gpt->capture_rate;
+}
+EXPORT_SYMBOL(mpc52xx_gpt_capture_rate);
+
+/**
+ * mpc52xx_gpt_free_capture - Release a GPT claimed for input capture
+ * @gpt: the GPT instance
+ */
+void mpc52xx_gpt_free_capture(struct mpc52xx_gpt_priv *gpt)
+{
+	struct kfifo *fifo = gpt->capture;
+
+	mpc52xx_gpt_free_timer(gpt);
+	gpt->capture = NULL;
+	kfifo_free(fifo);
+}
+EXPORT_SYMBOL(mpc52xx_gpt_free_capture);
+
+/* ---------------------------------------------------------------------
+ * Clock event device
+ */
+#define MPC52xx_GPT_CE_FREQ	1000000	/* Hz, resolution of the events */
+
+static struct mpc52xx_gpt_priv *mpc52xx_gpt_ce_gpt;
+static u32 mpc52xx_gpt_ce_prescale;
+
+static void mpc52xx_gpt_ce_event(void *data)
+{
+	struct clock_event_device *ce = data;
+
+	ce->event_handler(ce);
+}
+
+static int mpc52xx_gpt_ce_set_next_event(unsigned long cycles,
+					 struct clock_event_device *ce)
+{
+	struct mpc52xx_gpt_priv *gpt = mpc52xx_gpt_ce_gpt;
+	unsigned long flags;
+
+	/* Same as mpc52xx_gpt_start_timer() in one-shot mode, but with the
+	 * prescaler fixed so that cycles translate directly */
+	spin_lock_irqsave(&gpt->lock, flags);
+	clrbits32(&gpt->regs->mode, MPC52xx_GPT_MODE_COUNTER_ENABLE);
+	out_be32(&gpt->regs->count, mpc52xx_gpt_ce_prescale << 16 | cycles);
+	clrsetbits_be32(&gpt->regs->mode,
+			MPC52xx_GPT_MODE_MS_MASK | MPC52xx_GPT_MODE_CONTINUOUS,
+			MPC52xx_GPT_MODE_COUNTER_ENABLE |
+			MPC52xx_GPT_MODE_IRQ_EN);
+	spin_unlock_irqrestore(&gpt->lock, flags);
+
+	return 0;
+}
+
+static void mpc52xx_gpt_ce_set_mode(enum clock_event_mode mode,
+				    struct clock_event_device *ce)
+{
+	struct mpc52xx_gpt_priv *gpt = mpc52xx_gpt_ce_gpt;
+
+	switch (mode) {
+	case CLOCK_EVT_MODE_PERIODIC:
+		mpc52xx_gpt_start_timer(gpt, NSEC_PER_SEC / HZ, 1);
+		break;
+	case CLOCK_EVT_MODE_RESUME:
+		break;
+	default:
+		/* Shutdown, or oneshot waiting for set_next_event() */
+		mpc52xx_gpt_stop_timer(gpt);
+		break;
+	}
+}
+
+static struct clock_event_device mpc52xx_gpt_ce = {
+	.name		= "mpc52xx-gpt",
+	.features	= CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT,
+	.rating		= 250,	/* preferred over the decrementer */
+	.shift		= 32,
+	.set_next_event	= mpc52xx_gpt_ce_set_next_event,
+	.set_mode	= mpc52xx_gpt_ce_set_mode,
+};
+
+static void
+mpc52xx_gpt_ce_setup(struct mpc52xx_gpt_priv *gpt, struct device_node *node)
+{
+	struct clock_event_device *ce = &mpc52xx_gpt_ce;
+	u32 prescale;
+	int rc;
+
+	if (!of_find_property(node, "fsl,clockevent", NULL))
+		return;
+
+	if (mpc52xx_gpt_ce_gpt) {
+		dev_err(gpt->dev, "clock event device already registered\n");
+		return;
+	}
+
+	prescale = DIV_ROUND_UP(gpt->ipb_freq, MPC52xx_GPT_CE_FREQ);
+	if (prescale == 0 || prescale > 0xffff) {
+		dev_err(gpt->dev, "bad IPB frequency %u\n", gpt->ipb_freq);
+		return;
+	}
+
+	rc = __mpc52xx_gpt_request_timer(gpt, mpc52xx_gpt_ce_event, ce,
+					 IRQF_DISABLED | IRQF_TIMER);
+	if (rc) {
+		dev_err(gpt->dev, "cannot claim timer for clock events\n");
+		return;
+	}
+
+	mpc52xx_gpt_ce_gpt = gpt;
+	mpc52xx_gpt_ce_prescale = prescale;
+
+	ce->mult = div_sc(gpt->ipb_freq / prescale, NSEC_PER_SEC, ce->shift);
+	ce->max_delta_ns = clockevent_delta2ns(0xffff, ce);
+	ce->min_delta_ns = clockevent_delta2ns(2, ce);
+	ce->irq = gpt->irq;
+	ce->cpumask = cpumask_of(0);
+	clockevents_register_device(ce);
+
+	dev_info(gpt->dev, "clock event device, %u Hz\n",
+		 gpt->ipb_freq / prescale);
+}
+
 /* ---------------------------------------------------------------------
  * of_platform bus binding code
  */
@@ -349,6 +782,7 @@ static int __devinit mpc52xx_gpt_probe(struct of_device *ofdev,
 
 	spin_lock_init(&gpt->lock);
 	gpt->dev = &ofdev->dev;
+	gpt->ipb_freq = mpc5xxx_get_bus_frequency(ofdev->node);
 	gpt->regs = of_iomap(ofdev->node, 0);
 	if (!gpt->regs) {
 		kfree(gpt);
@@ -360,6 +794,18 @@ static int __devinit mpc52xx_gpt_probe(struct of_device *ofdev,
 	mpc52xx_gpt_gpio_setup(gpt, ofdev->node);
 	mpc52xx_gpt_irq_setup(gpt, ofdev->node);
 
+	/* Only needed when the timer gets claimed; when the GPT is an
+	 * interrupt controller the cascade owns this interrupt */
+	gpt->irq = NO_IRQ;
+	if (!gpt->irqhost)
+		gpt->irq = irq_of_parse_and_map(ofdev->node, 0);
+
+	mpc52xx_gpt_ce_setup(gpt, ofdev->node);
+
+	mutex_lock(&mpc52xx_gpt_list_mutex);
+	list_add(&gpt->list, &mpc52xx_gpt_list);
+	mutex_unlock(&mpc52xx_gpt_list_mutex);
+
 	return 0;
 }
 
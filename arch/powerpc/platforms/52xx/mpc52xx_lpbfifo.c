@@ -0,0 +1,579 @@
+/*
+ * LocalPlus Bus FIFO driver for the Freescale MPC52xx
+ *
+ * This program is free software; you can redistribute  it and/or modify it
+ * under  the terms of  the GNU General  Public License as published by the
+ * Free Software Foundation;  either version 2 of the  License, or (at your
+ * option) any later version.
+ *
+ * The SCLPC block of the MPC5200 moves data between memory and a device on
+ * the LocalPlus bus (flash, FPGA, ...) through a FIFO which is fed or
+ * drained by a BestComm gen_bd task, so the core is not involved in the
+ * transfer itself.
+ *
+ * Users describe a transfer with a struct mpc52xx_lpbfifo_request and queue
+ * it with mpc52xx_lpbfifo_submit().  Requests are carried out one at a time
+ * in submission order and finished through their callback, which is called
+ * from interrupt context.  mpc52xx_lpbfifo_transfer() wraps this for
+ * callers which can sleep.
+ *
+ * A request is split into packets of at most LPBFIFO_PACKET_MAX bytes.
+ * Each packet is one SCLPC transaction and is queued to BestComm as a
+ * single chain of BDs of up to LPBFIFO_BD_MAX bytes each.  A packet is
+ * complete once the SCLPC reports the bus transaction done *and* BestComm
+ * has completed all of its BDs; for reads the latter is what guarantees
+ * the data has reached memory.
+ */
+
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/of.h>
+#include <linux/of_platform.h>
+#include <linux/spinlock.h>
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <linux/jiffies.h>
+#include <asm/io.h>
+#include <asm/mpc52xx.h>
+
+#include <sysdev/bestcomm/bestcomm.h>
+#include <sysdev/bestcomm/bestcomm_priv.h>
+#include <sysdev/bestcomm/gen_bd.h>
+
+MODULE_DESCRIPTION("Freescale MPC52xx LocalPlus Bus FIFO driver");
+MODULE_LICENSE("GPL");
+
+#define LPBFIFO_REG_PACKET_SIZE		(0x00)
+#define LPBFIFO_REG_START_ADDRESS	(0x04)
+#define LPBFIFO_REG_CONTROL		(0x08)
+#define LPBFIFO_REG_ENABLE		(0x0C)
+#define LPBFIFO_REG_BYTES_DONE_STATUS	(0x14)
+#define LPBFIFO_REG_FIFO_DATA		(0x40)
+#define LPBFIFO_REG_FIFO_STATUS		(0x44)
+#define LPBFIFO_REG_FIFO_CONTROL	(0x48)
+#define LPBFIFO_REG_FIFO_ALARM		(0x4C)
+
+#define LPBFIFO_PACKET_RESTART		0x01000000
+
+#define LPBFIFO_CTRL_CS(cs)		((cs) << 24)
+#define LPBFIFO_CTRL_READ		0x00010000
+#define LPBFIFO_CTRL_DAI		0x00000100	/* no address increment */
+#define LPBFIFO_CTRL_BPT(bytes)		(bytes)		/* bytes per transfer */
+
+#define LPBFIFO_ENABLE_RC		0x01000000	/* reset controller */
+#define LPBFIFO_ENABLE_RF		0x00010000	/* reset FIFO */
+#define LPBFIFO_ENABLE_AIE		0x00000200	/* abort irq enable */
+#define LPBFIFO_ENABLE_NIE		0x00000100	/* done irq enable */
+#define LPBFIFO_ENABLE_ME		0x00000001	/* master enable */
+
+#define LPBFIFO_STATUS_AT		0x10000000	/* transaction aborted */
+#define LPBFIFO_STATUS_TD		0x01000000	/* transaction done */
+
+/* FIFO level at which BestComm gets requested, in bytes */
+#define LPBFIFO_ALARM			64
+
+#define LPBFIFO_NUM_BD			32
+#define LPBFIFO_BD_MAX			0x4000
+#define LPBFIFO_PACKET_MAX		((LPBFIFO_NUM_BD - 1) * LPBFIFO_BD_MAX)
+
+/**
+ * struct mpc52xx_lpbfifo - Private data of the LocalPlus Bus FIFO driver
+ * @dev: device the transfers are DMA mapped for; NULL until probed
+ * @regs: virtual address of the SCLPC registers
+ * @irq: virq of the SCLPC interrupt
+ * @lock: protects everything below, and the hardware
+ * @bcom_tx_task: BestComm task used for writes to the bus
+ * @bcom_rx_task: BestComm task used for reads from the bus
+ * @bcom_cur_task: the one of the two used by the current packet
+ * @queue: requests waiting for the FIFO
+ * @req: request in progress, or NULL when idle
+ * @packet: bytes in the current packet
+ * @packet_bds: BDs queued for the current packet
+ * @bds_done: BDs of the current packet completed so far
+ * @sclpc_done: the SCLPC finished the bus transaction of the packet
+ * @stopped: the driver is being unbound, no new requests are accepted
+ */
+struct mpc52xx_lpbfifo {
+	struct device *dev;
+	void __iomem *regs;
+	int irq;
+	spinlock_t lock;
+
+	struct bcom_task *bcom_tx_task;
+	struct bcom_task *bcom_rx_task;
+	struct bcom_task *bcom_cur_task;
+
+	struct list_head queue;
+	struct mpc52xx_lpbfifo_request *req;
+	size_t packet;
+	int packet_bds;
+	int bds_done;
+	int sclpc_done;
+	int stopped;
+};
+
+/* The MPC5200 has only one LocalPlus bus FIFO */
+static struct mpc52xx_lpbfifo lpbfifo;
+
+static enum dma_data_direction
+mpc52xx_lpbfifo_dir(struct mpc52xx_lpbfifo_request *req)
+{
+	return (req->flags & MPC52xx_LPBFIFO_FLAG_WRITE) ?
+			DMA_TO_DEVICE : DMA_FROM_DEVICE;
+}
+
+/**
+ * mpc52xx_lpbfifo_kick - Start the next packet of the current request
+ *
+ * Called with lpbfifo.lock held.
+ */
+static void mpc52xx_lpbfifo_kick(void)
+{
+	struct mpc52xx_lpbfifo_request *req = lpbfifo.req;
+	int write = req->flags & MPC52xx_LPBFIFO_FLAG_WRITE;
+	struct bcom_task *tsk;
+	size_t packet, len;
+	u32 ctrl, addr;
+	int i, n;
+
+	tsk = write ? lpbfifo.bcom_tx_task : lpbfifo.bcom_rx_task;
+	packet = min_t(size_t, req->size - req->pos, LPBFIFO_PACKET_MAX);
+
+	/* Reset both the controller and the FIFO before every transaction */
+	out_be32(lpbfifo.regs + LPBFIFO_REG_ENABLE,
+		 LPBFIFO_ENABLE_RC | LPBFIFO_ENABLE_RF);
+
+	ctrl = LPBFIFO_CTRL_CS(req->cs) | LPBFIFO_CTRL_BPT(4);
+	if (!write)
+		ctrl |= LPBFIFO_CTRL_READ;
+	addr = req->offset;
+	if (req->flags & MPC52xx_LPBFIFO_FLAG_NO_INCREMENT)
+		ctrl |= LPBFIFO_CTRL_DAI;
+	else
+		addr += req->pos;
+
+	out_be32(lpbfifo.regs + LPBFIFO_REG_CONTROL, ctrl);
+	out_be32(lpbfifo.regs + LPBFIFO_REG_START_ADDRESS, addr);
+	out_be32(lpbfifo.regs + LPBFIFO_REG_FIFO_ALARM, LPBFIFO_ALARM);
+	out_be32(lpbfifo.regs + LPBFIFO_REG_ENABLE, LPBFIFO_ENABLE_ME |
+		 LPBFIFO_ENABLE_NIE | LPBFIFO_ENABLE_AIE);
+
+	/* Hand the whole packet to BestComm as one chain of BDs */
+	n = DIV_ROUND_UP(packet, LPBFIFO_BD_MAX);
+	for (i = 0; i < n; i++) {
+		struct bcom_gen_bd *bd;
+
+		len = min_t(size_t, packet - i * LPBFIFO_BD_MAX,
+			    LPBFIFO_BD_MAX);
+		bd = (struct bcom_gen_bd *)bcom_prepare_buffer(tsk, i);
+		bd->status = len;
+		bd->buf_pa = req->data_phys + req->pos + i * LPBFIFO_BD_MAX;
+	}
+	bcom_submit_buffers_lazy(tsk, n, req);
+
+	lpbfifo.bcom_cur_task = tsk;
+	lpbfifo.packet = packet;
+	lpbfifo.packet_bds = n;
+	lpbfifo.bds_done = 0;
+	lpbfifo.sclpc_done = 0;
+
+	/* Go */
+	out_be32(lpbfifo.regs + LPBFIFO_REG_PACKET_SIZE,
+		 LPBFIFO_PACKET_RESTART | packet);
+}
+
+/**
+ * mpc52xx_lpbfifo_start - Start the next queued request if idle
+ *
+ * Called with lpbfifo.lock held.
+ */
+static void mpc52xx_lpbfifo_start(void)
+{
+	if (lpbfifo.req || lpbfifo.stopped || list_empty(&lpbfifo.queue))
+		return;
+
+	lpbfifo.req = list_first_entry(&lpbfifo.queue,
+				       struct mpc52xx_lpbfifo_request, list);
+	list_del_init(&lpbfifo.req->list);
+	mpc52xx_lpbfifo_kick();
+}
+
+/**
+ * mpc52xx_lpbfifo_finish - Retire the current request
+ * @status: 0 or -errno to report in the request
+ *
+ * Stops the hardware, starts the next queued request and returns the
+ * retired one, whose callback must be called once lpbfifo.lock has been
+ * released.  Called with lpbfifo.lock held.
+ */
+static struct mpc52xx_lpbfifo_request *mpc52xx_lpbfifo_finish(int status)
+{
+	struct mpc52xx_lpbfifo_request *req = lpbfifo.req;
+	struct bcom_task *tsk = lpbfifo.bcom_cur_task;
+
+	out_be32(lpbfifo.regs + LPBFIFO_REG_ENABLE,
+		 LPBFIFO_ENABLE_RC | LPBFIFO_ENABLE_RF);
+	bcom_disable(tsk);
+
+	/* Throw away whatever is left of an interrupted packet */
+	if (status) {
+		if (tsk == lpbfifo.bcom_tx_task)
+			bcom_gen_bd_tx_reset(tsk);
+		else
+			bcom_gen_bd_rx_reset(tsk);
+	}
+
+	dma_unmap_single(lpbfifo.dev, req->data_phys, req->size,
+			 mpc52xx_lpbfifo_dir(req));
+	req->status = status;
+
+	lpbfifo.req = NULL;
+	mpc52xx_lpbfifo_start();
+
+	return req;
+}
+
+/**
+ * mpc52xx_lpbfifo_advance - Move on once both halves of a packet are done
+ *
+ * Returns the finished request if this was its last packet, see
+ * mpc52xx_lpbfifo_finish().  Called with lpbfifo.lock held.
+ */
+static struct mpc52xx_lpbfifo_request *mpc52xx_lpbfifo_advance(void)
+{
+	struct mpc52xx_lpbfifo_request *req = lpbfifo.req;
+
+	if (!lpbfifo.sclpc_done || lpbfifo.bds_done < lpbfifo.packet_bds)
+		return NULL;
+
+	req->pos += lpbfifo.packet;
+	if (req->pos < req->size) {
+		mpc52xx_lpbfifo_kick();
+		return NULL;
+	}
+
+	return mpc52xx_lpbfifo_finish(0);
+}
+
+static void mpc52xx_lpbfifo_complete(struct mpc52xx_lpbfifo_request *req)
+{
+	if (req && req->callback)
+		req->callback(req);
+}
+
+static irqreturn_t mpc52xx_lpbfifo_irq(int irq, void *dev_id)
+{
+	struct mpc52xx_lpbfifo_request *done = NULL;
+	u32 status;
+
+	spin_lock(&lpbfifo.lock);
+
+	status = in_be32(lpbfifo.regs + LPBFIFO_REG_BYTES_DONE_STATUS);
+	status &= LPBFIFO_STATUS_AT | LPBFIFO_STATUS_TD;
+	if (!status) {
+		spin_unlock(&lpbfifo.lock);
+		return IRQ_NONE;
+	}
+	out_be32(lpbfifo.regs + LPBFIFO_REG_BYTES_DONE_STATUS, status);
+
+	if (lpbfifo.req) {
+		if (status & LPBFIFO_STATUS_AT) {
+			dev_err(lpbfifo.dev, "transaction aborted at 0x%zx\n",
+				lpbfifo.req->offset + lpbfifo.req->pos);
+			done = mpc52xx_lpbfifo_finish(-EIO);
+		} else {
+			lpbfifo.sclpc_done = 1;
+			done = mpc52xx_lpbfifo_advance();
+		}
+	}
+
+	spin_unlock(&lpbfifo.lock);
+
+	mpc52xx_lpbfifo_complete(done);
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t mpc52xx_lpbfifo_bcom_irq(int irq, void *dev_id)
+{
+	struct bcom_task *tsk = dev_id;
+	struct mpc52xx_lpbfifo_request *done = NULL;
+
+	spin_lock(&lpbfifo.lock);
+
+	while (bcom_buffer_done(tsk)) {
+		bcom_retrieve_buffer(tsk, NULL, NULL);
+		lpbfifo.bds_done++;
+	}
+
+	if (lpbfifo.req && tsk == lpbfifo.bcom_cur_task)
+		done = mpc52xx_lpbfifo_advance();
+
+	spin_unlock(&lpbfifo.lock);
+
+	mpc52xx_lpbfifo_complete(done);
+	return IRQ_HANDLED;
+}
+
+/**
+ * mpc52xx_lpbfifo_submit - Queue a transfer on the LocalPlus bus FIFO
+ * @req: the request, owned by the driver until its callback is called
+ *
+ * The data buffer must be suitable for DMA (kmalloc()ed, or a page cache
+ * page), and @req->data, @req->offset and @req->size must all be multiples
+ * of 4.  Returns -ENODEV if the FIFO is not available, in which case the
+ * caller has to fall back to CPU accesses.
+ */
+int mpc52xx_lpbfifo_submit(struct mpc52xx_lpbfifo_request *req)
+{
+	unsigned long flags;
+
+	if (!lpbfifo.dev)
+		return -ENODEV;
+
+	if (!req->size || (((unsigned long)req->data | req->offset |
+			    req->size) & 3))
+		return -EINVAL;
+
+	req->pos = 0;
+	req->status = -EINPROGRESS;
+	req->data_phys = dma_map_single(lpbfifo.dev, req->data, req->size,
+					mpc52xx_lpbfifo_dir(req));
+
+	spin_lock_irqsave(&lpbfifo.lock, flags);
+	if (lpbfifo.stopped) {
+		spin_unlock_irqrestore(&lpbfifo.lock, flags);
+		dma_unmap_single(lpbfifo.dev, req->data_phys, req->size,
+				 mpc52xx_lpbfifo_dir(req));
+		return -ENODEV;
+	}
+	list_add_tail(&req->list, &lpbfifo.queue);
+	mpc52xx_lpbfifo_start();
+	spin_unlock_irqrestore(&lpbfifo.lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(mpc52xx_lpbfifo_submit);
+
+/**
+ * mpc52xx_lpbfifo_abort - Cancel a queued or running transfer
+ * @req: the request passed to mpc52xx_lpbfifo_submit()
+ *
+ * The callback is called with @req->status set to -ECANCELED before this
+ * returns.  @req->pos tells how much had been transferred, at packet
+ * granularity.  Returns -ENOENT if the request had already finished.
+ */
+int mpc52xx_lpbfifo_abort(struct mpc52xx_lpbfifo_request *req)
+{
+	struct mpc52xx_lpbfifo_request *done = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&lpbfifo.lock, flags);
+	if (req == lpbfifo.req) {
+		done = mpc52xx_lpbfifo_finish(-ECANCELED);
+	} else if (req->status == -EINPROGRESS) {
+		list_del_init(&req->list);
+		dma_unmap_single(lpbfifo.dev, req->data_phys, req->size,
+				 mpc52xx_lpbfifo_dir(req));
+		req->status = -ECANCELED;
+		done = req;
+	}
+	spin_unlock_irqrestore(&lpbfifo.lock, flags);
+
+	if (!done)
+		return -ENOENT;
+
+	mpc52xx_lpbfifo_complete(done);
+	return 0;
+}
+EXPORT_SYMBOL(mpc52xx_lpbfifo_abort);
+
+static void mpc52xx_lpbfifo_transfer_done(struct mpc52xx_lpbfifo_request *req)
+{
+	complete(req->priv);
+}
+
+/**
+ * mpc52xx_lpbfifo_transfer - Carry out a transfer and wait for it
+ * @req: the request; its callback and priv fields are overwritten
+ *
+ * Must be called from process context.  Gives up after a timeout based on
+ * a very conservative 1MB/s.  Returns 0, or -errno as described for
+ * mpc52xx_lpbfifo_submit() and -ETIMEDOUT.
+ */
+int mpc52xx_lpbfifo_transfer(struct mpc52xx_lpbfifo_request *req)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	unsigned long timeout;
+	int rc;
+
+	req->callback = mpc52xx_lpbfifo_transfer_done;
+	req->priv = &done;
+
+	rc = mpc52xx_lpbfifo_submit(req);
+	if (rc)
+		return rc;
+
+	timeout = msecs_to_jiffies(1000 + req->size / 1024);
+	if (!wait_for_completion_timeout(&done, timeout)) {
+		/* Either this cancels it or the callback is on its way */
+		mpc52xx_lpbfifo_abort(req);
+		wait_for_completion(&done);
+		if (req->status == -ECANCELED)
+			return -ETIMEDOUT;
+	}
+
+	return req->status;
+}
+EXPORT_SYMBOL(mpc52xx_lpbfifo_transfer);
+
+/* ---------------------------------------------------------------------
+ * of_platform bus binding code
+ */
+static int __devinit mpc52xx_lpbfifo_probe(struct of_device *op,
+					   const struct of_device_id *match)
+{
+	struct resource res;
+	phys_addr_t fifo;
+	int rc = -ENOMEM;
+
+	if (lpbfifo.dev)
+		return -ENOSPC;
+
+	if (of_address_to_resource(op->node, 0, &res))
+		return -ENODEV;
+	fifo = res.start + LPBFIFO_REG_FIFO_DATA;
+
+	lpbfifo.irq = irq_of_parse_and_map(op->node, 0);
+	if (lpbfifo.irq == NO_IRQ)
+		return -ENODEV;
+
+	lpbfifo.regs = of_iomap(op->node, 0);
+	if (!lpbfifo.regs)
+		goto err_regs;
+
+	spin_lock_init(&lpbfifo.lock);
+	INIT_LIST_HEAD(&lpbfifo.queue);
+
+	/* Keep the controller in reset until there is something to do */
+	out_be32(lpbfifo.regs + LPBFIFO_REG_ENABLE,
+		 LPBFIFO_ENABLE_RC | LPBFIFO_ENABLE_RF);
+
+	lpbfifo.bcom_tx_task = bcom_gen_bd_tx_init(LPBFIFO_NUM_BD, fifo,
+				BCOM_INITIATOR_SCLPC, BCOM_IPR_SCLPC);
+	if (!lpbfifo.bcom_tx_task)
+		goto err_tx_task;
+
+	lpbfifo.bcom_rx_task = bcom_gen_bd_rx_init(LPBFIFO_NUM_BD, fifo,
+				BCOM_INITIATOR_SCLPC, BCOM_IPR_SCLPC,
+				LPBFIFO_BD_MAX);
+	if (!lpbfifo.bcom_rx_task)
+		goto err_rx_task;
+
+	/*
+	 * Every packet is queued to an idle task, so let
+	 * bcom_submit_buffers_lazy() start it.
+	 */
+	lpbfifo.bcom_tx_task->flags |= BCOM_FLAGS_ENABLE_TASK;
+	lpbfifo.bcom_rx_task->flags |= BCOM_FLAGS_ENABLE_TASK;
+
+	rc = request_irq(lpbfifo.irq, mpc52xx_lpbfifo_irq, 0,
+			 "mpc52xx-lpbfifo", &lpbfifo);
+	if (rc)
+		goto err_irq;
+
+	rc = request_irq(bcom_get_task_irq(lpbfifo.bcom_tx_task),
+			 mpc52xx_lpbfifo_bcom_irq, 0, "mpc52xx-lpbfifo-tx",
+			 lpbfifo.bcom_tx_task);
+	if (rc)
+		goto err_tx_irq;
+
+	rc = request_irq(bcom_get_task_irq(lpbfifo.bcom_rx_task),
+			 mpc52xx_lpbfifo_bcom_irq, 0, "mpc52xx-lpbfifo-rx",
+			 lpbfifo.bcom_rx_task);
+	if (rc)
+		goto err_rx_irq;
+
+	lpbfifo.dev = &op->dev;
+	return 0;
+
+ err_rx_irq:
+	free_irq(bcom_get_task_irq(lpbfifo.bcom_tx_task), lpbfifo.bcom_tx_task);
+ err_tx_irq:
+	free_irq(lpbfifo.irq, &lpbfifo);
+ err_irq:
+	bcom_gen_bd_rx_release(lpbfifo.bcom_rx_task);
+ err_rx_task:
+	bcom_gen_bd_tx_release(lpbfifo.bcom_tx_task);
+ err_tx_task:
+	iounmap(lpbfifo.regs);
+	lpbfifo.regs = NULL;
+ err_regs:
+	irq_dispose_mapping(lpbfifo.irq);
+	dev_err(&op->dev, "mpc52xx_lpbfifo_probe() failed\n");
+	return rc;
+}
+
+static int mpc52xx_lpbfifo_remove(struct of_device *op)
+{
+	struct mpc52xx_lpbfifo_request *req, *tmp;
+	unsigned long flags;
+	LIST_HEAD(cancelled);
+
+	/*
+	 * The driver core ignores our return value, so quiesce: refuse new
+	 * requests and cancel the running and queued ones.  Users see
+	 * -ECANCELED, and -ENODEV from then on.
+	 */
+	spin_lock_irqsave(&lpbfifo.lock, flags);
+	lpbfifo.stopped = 1;
+	if (lpbfifo.req) {
+		req = mpc52xx_lpbfifo_finish(-ECANCELED);
+		list_add_tail(&req->list, &cancelled);
+	}
+	list_for_each_entry(req, &lpbfifo.queue, list) {
+		dma_unmap_single(lpbfifo.dev, req->data_phys, req->size,
+				 mpc52xx_lpbfifo_dir(req));
+		req->status = -ECANCELED;
+	}
+	list_splice_tail_init(&lpbfifo.queue, &cancelled);
+	spin_unlock_irqrestore(&lpbfifo.lock, flags);
+
+	list_for_each_entry_safe(req, tmp, &cancelled, list) {
+		list_del_init(&req->list);
+		mpc52xx_lpbfifo_complete(req);
+	}
+
+	free_irq(bcom_get_task_irq(lpbfifo.bcom_rx_task), lpbfifo.bcom_rx_task);
+	free_irq(bcom_get_task_irq(lpbfifo.bcom_tx_task), lpbfifo.bcom_tx_task);
+	free_irq(lpbfifo.irq, &lpbfifo);
+	bcom_gen_bd_rx_release(lpbfifo.bcom_rx_task);
+	bcom_gen_bd_tx_release(lpbfifo.bcom_tx_task);
+	iounmap(lpbfifo.regs);
+	lpbfifo.regs = NULL;
+	irq_dispose_mapping(lpbfifo.irq);
+
+	lpbfifo.dev = NULL;
+	lpbfifo.stopped = 0;
+	return 0;
+}
+
+static const struct of_device_id mpc52xx_lpbfifo_match[] = {
+	{ .compatible = "fsl,mpc5200-lpbfifo", },
+	{}
+};
+
+static struct of_platform_driver mpc52xx_lpbfifo_driver = {
+	.name = "mpc52xx-lpbfifo",
+	.match_table = mpc52xx_lpbfifo_match,
+	.probe = mpc52xx_lpbfifo_probe,
+	.remove = mpc52xx_lpbfifo_remove,
+};
+
+static int __init mpc52xx_lpbfifo_init(void)
+{
+	if (of_register_platform_driver(&mpc52xx_lpbfifo_driver))
+		pr_err("error registering MPC52xx LPB FIFO driver\n");
+
+	return 0;
+}
+module_init(mpc52xx_lpbfifo_init);
@@ -52,10 +52,13 @@
  * interrupt group called 'bestcomm'.  The bestcomm group isn't physically
  * part of the MPC5200 interrupt controller, but it is used here to assign
  * a separate virq number for each bestcomm task (since any of the 16
- * bestcomm tasks can cause the bestcomm interrupt to be raised).  When a
- * bestcomm interrupt occurs (peripheral group, irq 0) this driver determines
- * which task needs servicing and returns the irq number for that task.  This
- * allows drivers which use bestcomm to define their own interrupt handlers.
+ * bestcomm tasks can cause the bestcomm interrupt to be raised).  The
+ * bestcomm interrupt (peripheral group, irq 0) is a chained handler which
+ * dispatches every pending task irq in one pass, so several tasks finishing
+ * together cost a single exception.  This allows drivers which use bestcomm
+ * to define their own interrupt handlers.  With debugfs, the number of
+ * dispatches and a histogram of handler run times per task are reported in
+ * <debugfs>/powerpc/mpc52xx_sdma_irqs.
  *
  * irq_chip structures
  * -------------------
@@ -101,8 +104,11 @@
 #include <linux/interrupt.h>
 #include <linux/irq.h>
 #include <linux/of.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <asm/io.h>
 #include <asm/prom.h>
+#include <asm/time.h>
 #include <asm/mpc52xx.h>
 
 /* HW IRQ mapping */
@@ -342,6 +348,74 @@ static struct irq_chip mpc52xx_sdma_irqchip = {
 	.set_type = mpc52xx_null_set_type,
 };
 
+/*
+ * SDMA cascade statistics
+ */
+#define MPC52xx_SDMA_SOURCES	32
+#define MPC52xx_SDMA_HIST	12	/* <1us, <2us, <4us, ... >=1ms */
+
+#ifdef CONFIG_DEBUG_FS
+struct mpc52xx_sdma_stats {
+	unsigned long count[MPC52xx_SDMA_SOURCES];
+	unsigned long hist[MPC52xx_SDMA_SOURCES][MPC52xx_SDMA_HIST];
+	unsigned long batch[MPC52xx_SDMA_SOURCES + 1];
+};
+
+static struct mpc52xx_sdma_stats mpc52xx_sdma_stats;
+
+static inline u64 mpc52xx_sdma_stat_start(void)
+{
+	return get_tb();
+}
+
+static inline void mpc52xx_sdma_stat_end(int l2irq, u64 start)
+{
+	unsigned long usecs = (unsigned long)(get_tb() - start) /
+			      tb_ticks_per_usec;
+	int bucket = min(fls(usecs), MPC52xx_SDMA_HIST - 1);
+
+	mpc52xx_sdma_stats.count[l2irq]++;
+	mpc52xx_sdma_stats.hist[l2irq][bucket]++;
+}
+
+static inline void mpc52xx_sdma_stat_batch(int n)
+{
+	mpc52xx_sdma_stats.batch[n]++;
+}
+#else
+static inline u64 mpc52xx_sdma_stat_start(void) { return 0; }
+static inline void mpc52xx_sdma_stat_end(int l2irq, u64 start) { }
+static inline void mpc52xx_sdma_stat_batch(int n) { }
+#endif /* CONFIG_DEBUG_FS */
+
+/**
+ * mpc52xx_sdma_cascade - Dispatch all pending bestcomm task irqs
+ *
+ * Only the pending bits sampled on entry are serviced; tasks completing
+ * meanwhile keep the bestcomm interrupt asserted and get picked up by the
+ * next exception.
+ */
+static void mpc52xx_sdma_cascade(unsigned int virq, struct irq_desc *desc)
+{
+	u32 pending;
+	u64 start;
+	int l2irq, n = 0;
+
+	pending = in_be32(&sdma->IntPend) & ~in_be32(&sdma->IntMask);
+	while (pending) {
+		l2irq = ffs(pending) - 1;
+		pending &= ~(1 << l2irq);
+
+		start = mpc52xx_sdma_stat_start();
+		generic_handle_irq(irq_linear_revmap(mpc52xx_irqhost,
+				(MPC52xx_IRQ_L1_SDMA << MPC52xx_IRQ_L1_OFFSET) |
+				l2irq));
+		mpc52xx_sdma_stat_end(l2irq, start);
+		n++;
+	}
+	mpc52xx_sdma_stat_batch(n);
+}
+
 /**
  * mpc52xx_is_extirq - Returns true if hwirq number is for an external IRQ
  */
@@ -506,6 +580,11 @@ void __init mpc52xx_init_irq(void)
 
 	irq_set_default_host(mpc52xx_irqhost);
 
+	/* Bestcomm task irqs are demultiplexed by a chained handler */
+	set_irq_chained_handler(irq_create_mapping(mpc52xx_irqhost,
+				MPC52xx_IRQ_L1_PERP << MPC52xx_IRQ_L1_OFFSET),
+				mpc52xx_sdma_cascade);
+
 	pr_info("MPC52xx PIC is up and running!\n");
 }
 
@@ -531,10 +610,9 @@ void __init mpc52xx_init_irq(void)
  * This function checks each of the 3 irq request fields and returns the
  * first pending interrupt that it finds.
  *
- * This function also identifies a 4th type of interrupt; 'bestcomm'.  Each
- * bestcomm DMA task can raise the bestcomm peripheral interrupt.  When this
- * occurs at task-specific IRQ# is decoded so that each task can have its
- * own IRQ handler.
+ * The 'bestcomm' peripheral interrupt is returned as is; its chained
+ * handler, mpc52xx_sdma_cascade(), decodes the task-specific IRQs so that
+ * each task can have its own IRQ handler.
  */
 unsigned int mpc52xx_get_irq(void)
 {
@@ -555,14 +633,73 @@ unsigned int mpc52xx_get_irq(void)
 	} else if (status & 0x20000000) {	/* peripheral */
 	      peripheral:
 		irq = (status >> 24) & 0x1f;
-		if (irq == 0) {	/* bestcomm */
-			status = in_be32(&sdma->IntPend);
-			irq = ffs(status) - 1;
-			irq |= (MPC52xx_IRQ_L1_SDMA << MPC52xx_IRQ_L1_OFFSET);
-		} else {
-			irq |= (MPC52xx_IRQ_L1_PERP << MPC52xx_IRQ_L1_OFFSET);
-		}
+		irq |= (MPC52xx_IRQ_L1_PERP << MPC52xx_IRQ_L1_OFFSET);
 	}
 
 	return irq_linear_revmap(mpc52xx_irqhost, irq);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int mpc52xx_sdma_irqs_show(struct seq_file *m, void *v)
+{
+	struct mpc52xx_sdma_stats *st = &mpc52xx_sdma_stats;
+	int i, j;
+
+	seq_printf(m, "task      count  run time histogram (<1us, <2us, ..."
+		      " >=1ms)\n");
+	for (i = 0; i < MPC52xx_SDMA_SOURCES; i++) {
+		if (!st->count[i])
+			continue;
+		seq_printf(m, "%4d %10lu ", i, st->count[i]);
+		for (j = 0; j < MPC52xx_SDMA_HIST; j++)
+			seq_printf(m, " %lu", st->hist[i][j]);
+		seq_printf(m, "\n");
+	}
+
+	seq_printf(m, "\ntasks per exception:");
+	for (i = 0; i <= MPC52xx_SDMA_SOURCES; i++)
+		if (st->batch[i])
+			seq_printf(m, " %d:%lu", i, st->batch[i]);
+	seq_printf(m, "\n");
+
+	return 0;
+}
+
+static int mpc52xx_sdma_irqs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mpc52xx_sdma_irqs_show, NULL);
+}
+
+/* Writing anything clears the statistics */
+static ssize_t mpc52xx_sdma_irqs_write(struct file *file,
+				       const char __user *buf, size_t len,
+				       loff_t *ppos)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	memset(&mpc52xx_sdma_stats, 0, sizeof(mpc52xx_sdma_stats));
+	local_irq_restore(flags);
+
+	return len;
+}
+
+static const struct file_operations mpc52xx_sdma_irqs_fops = {
+	.open		= mpc52xx_sdma_irqs_open,
+	.read		= seq_read,
+	.write		= mpc52xx_sdma_irqs_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init mpc52xx_pic_debugfs_init(void)
+{
+	if (!sdma)
+		return 0;
+
+	debugfs_create_file("mpc52xx_sdma_irqs", 0644, powerpc_debugfs_root,
+			    NULL, &mpc52xx_sdma_irqs_fops);
+	return 0;
+}
+device_initcall(mpc52xx_pic_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
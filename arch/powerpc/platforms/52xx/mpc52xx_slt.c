@@ -0,0 +1,86 @@
+/*
+ * MPC5200 slice timer clocksource
+ *
+ * This program is free software; you can redistribute  it and/or modify it
+ * under  the terms of  the GNU General  Public License as published by the
+ * Free Software Foundation;  either version 2 of the  License, or (at your
+ * option) any later version.
+ *
+ * The GPTs can generate clock events, but cannot back a clocksource: the
+ * CPU can read their counter only as a value latched by an input capture.
+ * The two slice timers (SLT) have a count value register which can be read
+ * at any time, so one of them is used instead.  An SLT node carrying the
+ * empty property 'fsl,clocksource' is set up to count down continuously
+ * from 0xffffffff at the IPB clock, and registered as a clocksource.
+ *
+ * The SLT is rated below the timebase, which stays the default system
+ * clocksource.  It can be selected through
+ * /sys/devices/system/clocksource/clocksource0/current_clocksource.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/clocksource.h>
+#include <linux/io.h>
+#include <linux/of.h>
+#include <asm/mpc52xx.h>
+
+/* SLT control register bits */
+#define MPC52xx_SLT_CR_RUN	0x04000000	/* reload, don't wait */
+#define MPC52xx_SLT_CR_ENABLE	0x01000000
+
+static struct mpc52xx_slt __iomem *mpc52xx_slt_cs_regs;
+
+static cycle_t mpc52xx_slt_cs_read(struct clocksource *cs)
+{
+	/* The SLT counts down; a clocksource has to count up */
+	return (cycle_t)~in_be32(&mpc52xx_slt_cs_regs->count);
+}
+
+static struct clocksource mpc52xx_slt_cs = {
+	.name		= "mpc52xx-slt",
+	.rating		= 200,
+	.read		= mpc52xx_slt_cs_read,
+	.mask		= CLOCKSOURCE_MASK(32),
+	.shift		= 24,
+	.flags		= CLOCK_SOURCE_IS_CONTINUOUS,
+};
+
+static int __init mpc52xx_slt_cs_init(void)
+{
+	struct device_node *np;
+	struct mpc52xx_slt __iomem *slt;
+	unsigned long freq;
+
+	for_each_compatible_node(np, NULL, "fsl,mpc5200-slt")
+		if (of_find_property(np, "fsl,clocksource", NULL))
+			break;
+	if (!np)
+		return 0;
+
+	freq = mpc5xxx_get_bus_frequency(np);
+	if (!freq) {
+		pr_err("%s: unknown IPB frequency\n", np->full_name);
+		goto out;
+	}
+
+	slt = of_iomap(np, 0);
+	if (!slt) {
+		pr_err("%s: cannot map registers\n", np->full_name);
+		goto out;
+	}
+
+	out_be32(&slt->control, 0);
+	out_be32(&slt->terminal_count, 0xffffffff);
+	out_be32(&slt->control, MPC52xx_SLT_CR_RUN | MPC52xx_SLT_CR_ENABLE);
+	mpc52xx_slt_cs_regs = slt;
+
+	mpc52xx_slt_cs.mult = clocksource_hz2mult(freq, mpc52xx_slt_cs.shift);
+	clocksource_register(&mpc52xx_slt_cs);
+
+	pr_info("%s: clocksource, %lu Hz\n", np->full_name, freq);
+ out:
+	of_node_put(np);
+	return 0;
+}
+device_initcall(mpc52xx_slt_cs_init);
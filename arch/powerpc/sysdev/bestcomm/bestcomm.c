@@ -16,6 +16,11 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/time.h>
+#include <linux/cache.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/kernel_stat.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
 #include <linux/of_platform.h>
@@ -51,6 +56,7 @@ bcom_task_alloc(int bd_count, int bd_size, int priv_size)
 {
 	int i, tasknum = -1;
 	struct bcom_task *tsk;
+	size_t cookie_ofs, priv_ofs;
 
 	/* Don't try to do anything if bestcomm init failed */
 	if (!bcom_eng)
@@ -71,14 +77,21 @@ bcom_task_alloc(int bd_count, int bd_size, int priv_size)
 	if (tasknum < 0)
 		return NULL;
 
-	/* Allocate our structure */
-	tsk = kzalloc(sizeof(struct bcom_task) + priv_size, GFP_KERNEL);
+	/* Allocate our structure, the cookies and the private data in one
+	 * block.  Each part starts on a cache line of its own so the ring
+	 * indexes the engine user polls don't share one with the cookies */
+	cookie_ofs = L1_CACHE_ALIGN(sizeof(struct bcom_task));
+	priv_ofs = L1_CACHE_ALIGN(cookie_ofs + sizeof(void *) * bd_count);
+
+	tsk = kzalloc(priv_ofs + priv_size, GFP_KERNEL);
 	if (!tsk)
 		goto error;
 
 	tsk->tasknum = tasknum;
+	if (bd_count)
+		tsk->cookie = (void *)tsk + cookie_ofs;
 	if (priv_size)
-		tsk->priv = (void*)tsk + sizeof(struct bcom_task);
+		tsk->priv = (void *)tsk + priv_ofs;
 
 	/* Get IRQ of that task */
 	tsk->irq = irq_of_parse_and_map(bcom_eng->ofnode, tsk->tasknum);
@@ -87,11 +100,8 @@ bcom_task_alloc(int bd_count, int bd_size, int priv_size)
 
 	/* Init the BDs, if needed */
 	if (bd_count) {
-		tsk->cookie = kmalloc(sizeof(void*) * bd_count, GFP_KERNEL);
-		if (!tsk->cookie)
-			goto error;
-
-		tsk->bd = bcom_sram_alloc(bd_count * bd_size, 4, &tsk->bd_pa);
+		tsk->bd = bcom_sram_alloc(bd_count * bd_size, L1_CACHE_BYTES,
+					  &tsk->bd_pa);
 		if (!tsk->bd)
 			goto error;
 		memset(tsk->bd, 0x00, bd_count * bd_size);
@@ -100,6 +110,10 @@ bcom_task_alloc(int bd_count, int bd_size, int priv_size)
 		tsk->bd_size = bd_size;
 	}
 
+	spin_lock(&bcom_eng->lock);
+	bcom_eng->tasks[tasknum] = tsk;
+	spin_unlock(&bcom_eng->lock);
+
 	return tsk;
 
 error:
@@ -107,7 +121,6 @@ error:
 		if (tsk->irq != NO_IRQ)
 			irq_dispose_mapping(tsk->irq);
 		bcom_sram_free(tsk->bd);
-		kfree(tsk->cookie);
 		kfree(tsk);
 	}
 
@@ -124,13 +137,16 @@ bcom_task_free(struct bcom_task *tsk)
 	bcom_disable_task(tsk->tasknum);
 
 	/* Clear TDT */
+	spin_lock(&bcom_eng->lock);
+	bcom_eng->tasks[tsk->tasknum] = NULL;
 	bcom_eng->tdt[tsk->tasknum].start = 0;
 	bcom_eng->tdt[tsk->tasknum].stop  = 0;
+	spin_unlock(&bcom_eng->lock);
 
 	/* Free everything */
+	bcom_coalesce_detach(tsk);
 	irq_dispose_mapping(tsk->irq);
 	bcom_sram_free(tsk->bd);
-	kfree(tsk->cookie);
 	kfree(tsk);
 }
 EXPORT_SYMBOL_GPL(bcom_task_free);
@@ -246,6 +262,167 @@ bcom_disable(struct bcom_task *tsk)
 }
 EXPORT_SYMBOL_GPL(bcom_disable);
 
+int
+bcom_coalesce_attach(struct bcom_task *tsk, struct device_node *timer,
+		     void (*expire)(void *data), void *data)
+{
+	struct mpc52xx_gpt_priv *gpt;
+	int rv;
+
+	if (tsk->coal_gpt)
+		return -EBUSY;
+
+	gpt = mpc52xx_gpt_from_node(timer);
+	if (!gpt)
+		return -ENODEV;
+
+	rv = mpc52xx_gpt_request_timer(gpt, expire, data);
+	if (rv)
+		return rv;
+
+	tsk->coal_gpt = gpt;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(bcom_coalesce_attach);
+
+void
+bcom_coalesce_detach(struct bcom_task *tsk)
+{
+	if (!tsk->coal_gpt)
+		return;
+
+	mpc52xx_gpt_free_timer(tsk->coal_gpt);
+	tsk->coal_gpt = NULL;
+	tsk->coal_usecs = 0;
+}
+EXPORT_SYMBOL_GPL(bcom_coalesce_detach);
+
+int
+bcom_set_coalesce(struct bcom_task *tsk, unsigned int max_bds,
+		  unsigned int usecs)
+{
+	if (usecs && !tsk->coal_gpt)
+		return -EOPNOTSUPP;
+
+	if (max_bds >= tsk->num_bd || usecs > BCOM_COALESCE_MAX_USECS)
+		return -EINVAL;
+
+	tsk->coal_bds = max_bds;
+	tsk->coal_usecs = usecs;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(bcom_set_coalesce);
+
+int
+bcom_coalesce_holdoff(struct bcom_task *tsk)
+{
+	if (!tsk->coal_gpt || !tsk->coal_usecs)
+		return 0;
+
+	return mpc52xx_gpt_start_timer(tsk->coal_gpt,
+			(u64)tsk->coal_usecs * NSEC_PER_USEC, 0) == 0;
+}
+EXPORT_SYMBOL_GPL(bcom_coalesce_holdoff);
+
+void
+bcom_coalesce_cancel(struct bcom_task *tsk)
+{
+	if (tsk->coal_gpt)
+		mpc52xx_gpt_stop_timer(tsk->coal_gpt);
+}
+EXPORT_SYMBOL_GPL(bcom_coalesce_cancel);
+
+
+/* ======================================================================== */
+/* Statistics                                                               */
+/* ======================================================================== */
+
+#ifdef CONFIG_DEBUG_FS
+static int
+bcom_debugfs_show(struct seq_file *m, void *v)
+{
+	struct bcom_task *tsk;
+	int i;
+
+	seq_printf(m, "task  bds used  max       full  completed       irqs\n");
+
+	spin_lock(&bcom_eng->lock);
+	for (i=0; i<BCOM_MAX_TASKS; i++) {
+		tsk = bcom_eng->tasks[i];
+		if (!tsk)
+			continue;
+		seq_printf(m, "%4d %4u %4d %4u %10lu %10lu %10u\n",
+			   tsk->tasknum, tsk->num_bd,
+			   tsk->num_bd ? bcom_queue_used(tsk) : 0,
+			   tsk->stat_max_used, tsk->stat_full,
+			   tsk->stat_completed, kstat_irqs(tsk->irq));
+	}
+	spin_unlock(&bcom_eng->lock);
+
+	return 0;
+}
+
+static int
+bcom_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bcom_debugfs_show, NULL);
+}
+
+/* Writing anything clears the statistics */
+static ssize_t
+bcom_debugfs_write(struct file *file, const char __user *buf, size_t len,
+		   loff_t *ppos)
+{
+	struct bcom_task *tsk;
+	int i;
+
+	spin_lock(&bcom_eng->lock);
+	for (i=0; i<BCOM_MAX_TASKS; i++) {
+		tsk = bcom_eng->tasks[i];
+		if (!tsk)
+			continue;
+		tsk->stat_completed = 0;
+		tsk->stat_full = 0;
+		tsk->stat_max_used = 0;
+	}
+	spin_unlock(&bcom_eng->lock);
+
+	return len;
+}
+
+static const struct file_operations bcom_debugfs_fops = {
+	.owner		= THIS_MODULE,
+	.open		= bcom_debugfs_open,
+	.read		= seq_read,
+	.write		= bcom_debugfs_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* powerpc_debugfs_root isn't exported, and we may be a module */
+static void
+bcom_debugfs_init(void)
+{
+	bcom_eng->debugfs = debugfs_create_dir("bestcomm", NULL);
+	if (!bcom_eng->debugfs)
+		return;
+
+	debugfs_create_file("tasks", 0644, bcom_eng->debugfs, NULL,
+			    &bcom_debugfs_fops);
+}
+
+static void
+bcom_debugfs_cleanup(void)
+{
+	debugfs_remove_recursive(bcom_eng->debugfs);
+}
+#else
+static inline void bcom_debugfs_init(void) { }
+static inline void bcom_debugfs_cleanup(void) { }
+#endif /* CONFIG_DEBUG_FS */
+
 
 /* ======================================================================== */
 /* Engine init/cleanup                                                      */
@@ -438,6 +615,8 @@ mpc52xx_bcom_probe(struct of_device *op, const struct of_device_id *match)
 	if (rv)
 		goto error_unmap;
 
+	bcom_debugfs_init();
+
 	/* Done ! */
 	printk(KERN_INFO "DMA: MPC52xx BestComm engine @%08lx ok !\n",
 		(long)bcom_eng->regs_base);
@@ -464,6 +643,8 @@ error_ofput:
 static int
 mpc52xx_bcom_remove(struct of_device *op)
 {
+	bcom_debugfs_cleanup();
+
 	/* Clean up the engine */
 	bcom_engine_cleanup();
 
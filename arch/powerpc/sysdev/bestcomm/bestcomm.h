@@ -16,6 +16,9 @@
 #ifndef __BESTCOMM_H__
 #define __BESTCOMM_H__
 
+struct device_node;
+struct mpc52xx_gpt_priv;
+
 /**
  * struct bcom_bd - Structure describing a generic BestComm buffer descriptor
  * @status: The current status of this buffer. Exact meaning depends on the
@@ -43,6 +46,10 @@ struct bcom_bd {
  *
  * Most likely you don't need to poke around inside this structure. The
  * fields are exposed in the header just for the sake of inline functions
+ *
+ * The structure, the cookie array and the private data are allocated as one
+ * block, each part starting on its own cache line; the ring state and its
+ * statistics below share the first one.
  */
 struct bcom_task {
 	unsigned int	tasknum;
@@ -57,6 +64,16 @@ struct bcom_task {
 	unsigned int	num_bd;
 	unsigned int	bd_size;
 
+	/* Ring statistics, reported in debugfs */
+	unsigned long	stat_completed;	/* BDs retrieved */
+	unsigned long	stat_full;	/* submissions that filled the ring */
+	unsigned int	stat_max_used;	/* highest number of BDs queued */
+
+	/* Interrupt coalescing, see bcom_coalesce_attach() */
+	struct mpc52xx_gpt_priv	*coal_gpt;
+	unsigned int	coal_bds;
+	unsigned int	coal_usecs;
+
 	void*		priv;
 };
 
@@ -91,6 +108,77 @@ bcom_get_task_irq(struct bcom_task *tsk) {
 	return tsk->irq;
 }
 
+/* ======================================================================== */
+/* Interrupt coalescing                                                     */
+/* ======================================================================== */
+
+/*
+ * BestComm tasks raise their interrupt once per completed BD.  Coalescing
+ * is done on top of that: after draining a task, a driver that finds it
+ * completed at least coal_bds BDs in one pass keeps the task interrupt
+ * masked and lets a GPT one-shot call it back coal_usecs later.  A busy
+ * task is thus serviced at most once every coal_usecs, while a lightly
+ * loaded one still gets an interrupt per BD.
+ */
+
+/**
+ * bcom_coalesce_attach - Bind a GPT timer to a task for interrupt coalescing
+ * @tsk: The BestComm task structure
+ * @timer: Device tree node of the GPT to use
+ * @expire: Called from interrupt context when a holdoff period ends
+ * @data: Argument passed to @expire
+ */
+extern int bcom_coalesce_attach(struct bcom_task *tsk,
+		struct device_node *timer, void (*expire)(void *data),
+		void *data);
+
+/**
+ * bcom_coalesce_detach - Release the coalescing timer of a task
+ * @tsk: The BestComm task structure
+ *
+ * Called automatically when the task is released.
+ */
+extern void bcom_coalesce_detach(struct bcom_task *tsk);
+
+/**
+ * bcom_set_coalesce - Configure interrupt coalescing of a task
+ * @tsk: The BestComm task structure
+ * @max_bds: Number of BDs completed in one pass that triggers a holdoff,
+ *           0 to never trigger one
+ * @usecs: Length of the holdoff period, 0 to disable coalescing.  Only
+ *         allowed when a timer is attached.
+ */
+extern int bcom_set_coalesce(struct bcom_task *tsk, unsigned int max_bds,
+		unsigned int usecs);
+
+/**
+ * bcom_coalesce_holdoff - Start a holdoff period
+ * @tsk: The BestComm task structure
+ *
+ * Returns 1 if the expire callback will be called, in which case the
+ * caller should keep its interrupts masked until then.  Returns 0 when
+ * the task has no usable timer or coalescing is disabled.
+ */
+extern int bcom_coalesce_holdoff(struct bcom_task *tsk);
+
+/**
+ * bcom_coalesce_cancel - Abort a pending holdoff period
+ * @tsk: The BestComm task structure
+ */
+extern void bcom_coalesce_cancel(struct bcom_task *tsk);
+
+/**
+ * bcom_coalesce_due - Checks if a pass over a task warrants a holdoff
+ * @tsk: The BestComm task structure
+ * @done: Number of BDs completed during the pass
+ */
+static inline int
+bcom_coalesce_due(struct bcom_task *tsk, unsigned int done)
+{
+	return tsk->coal_bds && done >= tsk->coal_bds;
+}
+
+
 /* ======================================================================== */
 /* BD based tasks helpers                                                   */
 /* ======================================================================== */
@@ -119,6 +207,17 @@ _bcom_next_outdex(struct bcom_task *tsk)
 	return ((tsk->outdex + 1) == tsk->num_bd) ? 0 : tsk->outdex + 1;
 }
 
+/** _bcom_prev_index - Get the index preceding the next input index.
+ * @tsk: pointer to task structure
+ *
+ * Support function; Device drivers should not call this
+ */
+static inline int
+_bcom_prev_index(struct bcom_task *tsk)
+{
+	return (tsk->index == 0) ? tsk->num_bd - 1 : tsk->index - 1;
+}
+
 /**
  * bcom_queue_empty - Checks if a BestComm task BD queue is empty
  * @tsk: The BestComm task structure
@@ -139,6 +238,46 @@ bcom_queue_full(struct bcom_task *tsk)
 	return tsk->outdex == _bcom_next_index(tsk);
 }
 
+/**
+ * bcom_queue_used - Number of BDs submitted and not yet retrieved
+ * @tsk: The BestComm task structure
+ */
+static inline int
+bcom_queue_used(struct bcom_task *tsk)
+{
+	int used = tsk->index - tsk->outdex;
+
+	if (used < 0)
+		used += tsk->num_bd;
+	return used;
+}
+
+/**
+ * bcom_queue_space - Number of BDs that can still be submitted
+ * @tsk: The BestComm task structure
+ */
+static inline int
+bcom_queue_space(struct bcom_task *tsk)
+{
+	return tsk->num_bd - 1 - bcom_queue_used(tsk);
+}
+
+/** _bcom_account_submit - Update the ring statistics after a submission
+ * @tsk: pointer to task structure
+ *
+ * Support function; Device drivers should not call this
+ */
+static inline void
+_bcom_account_submit(struct bcom_task *tsk)
+{
+	unsigned int used = bcom_queue_used(tsk);
+
+	if (used > tsk->stat_max_used)
+		tsk->stat_max_used = used;
+	if (used == tsk->num_bd - 1)
+		tsk->stat_full++;
+}
+
 /**
  * bcom_get_bd - Get a BD from the queue
  * @tsk: The BestComm task structure
@@ -192,10 +331,93 @@ bcom_submit_next_buffer(struct bcom_task *tsk, void *cookie)
 	mb();	/* ensure the bd is really up-to-date */
 	bd->status |= BCOM_BD_READY;
 	tsk->index = _bcom_next_index(tsk);
+	_bcom_account_submit(tsk);
 	if (tsk->flags & BCOM_FLAGS_ENABLE_TASK)
 		bcom_enable(tsk);
 }
 
+/**
+ * bcom_prepare_buffer - clear status of the n-th next available buffer.
+ * @tsk: The BestComm task structure
+ * @n: Position after the next available buffer, 0 is that buffer itself
+ *
+ * Used to build a chain of BDs submitted with bcom_submit_buffers_lazy().
+ * Returns pointer to the buffer descriptor
+ */
+static inline struct bcom_bd *
+bcom_prepare_buffer(struct bcom_task *tsk, unsigned int n)
+{
+	struct bcom_bd *bd;
+	unsigned int index = tsk->index + n;
+
+	if (index >= tsk->num_bd)
+		index -= tsk->num_bd;
+
+	bd = bcom_get_bd(tsk, index);
+	bd->status = 0;	/* cleanup last status */
+	return bd;
+}
+
+/**
+ * bcom_submit_buffers_lazy - Submit a chain of BDs, kicking the task only if idle
+ * @tsk: The BestComm task structure
+ * @count: Number of BDs in the chain, prepared with bcom_prepare_buffer()
+ * @cookie: Opaque value returned by bcom_retrieve_buffer() for each BD
+ *
+ * The BDs are made ready last to first so the engine never starts on a
+ * partially submitted chain.  For self-disabling tasks with
+ * BCOM_FLAGS_ENABLE_TASK set, the task control register is only touched
+ * when the BD preceding the chain has already been completed.  While the
+ * engine is still busy with earlier BDs it will pick the chain up on its
+ * own, so a burst of submissions costs a single task enable.
+ *
+ * Only one context may submit to a given task at a time.
+ */
+static inline void
+bcom_submit_buffers_lazy(struct bcom_task *tsk, unsigned int count,
+			 void *cookie)
+{
+	struct bcom_bd *prev = bcom_get_bd(tsk, _bcom_prev_index(tsk));
+	unsigned int first = tsk->index;
+	unsigned int index = first;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		tsk->cookie[index] = cookie;
+		index = (index + 1 == tsk->num_bd) ? 0 : index + 1;
+	}
+
+	mb();	/* ensure the bds are really up-to-date */
+	while (i-- > 1) {
+		index = (index == 0) ? tsk->num_bd - 1 : index - 1;
+		bcom_get_bd(tsk, index)->status |= BCOM_BD_READY;
+	}
+	wmb();	/* the rest of the chain must be ready before its head */
+	bcom_get_bd(tsk, first)->status |= BCOM_BD_READY;
+
+	first += count;
+	tsk->index = (first >= tsk->num_bd) ? first - tsk->num_bd : first;
+	_bcom_account_submit(tsk);
+	mb();	/* publish the new bds before sampling the previous one */
+	if ((tsk->flags & BCOM_FLAGS_ENABLE_TASK) &&
+	    !(prev->status & BCOM_BD_READY))
+		bcom_enable(tsk);
+}
+
+/**
+ * bcom_submit_next_buffer_lazy - Submit a buffer, kicking the task only if idle
+ * @tsk: The BestComm task structure
+ * @cookie: Opaque value returned by bcom_retrieve_buffer()
+ *
+ * Same as bcom_submit_next_buffer(), with the task enable policy of
+ * bcom_submit_buffers_lazy().
+ */
+static inline void
+bcom_submit_next_buffer_lazy(struct bcom_task *tsk, void *cookie)
+{
+	bcom_submit_buffers_lazy(tsk, 1, cookie);
+}
+
 static inline void *
 bcom_retrieve_buffer(struct bcom_task *tsk, u32 *p_status, struct bcom_bd **p_bd)
 {
@@ -207,6 +429,7 @@ bcom_retrieve_buffer(struct bcom_task *tsk, u32 *p_status, struct bcom_bd **p_bd
 	if (p_bd)
 		*p_bd = bd;
 	tsk->outdex = _bcom_next_outdex(tsk);
+	tsk->stat_completed++;
 	return cookie;
 }
 
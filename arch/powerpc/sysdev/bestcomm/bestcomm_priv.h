@@ -45,6 +45,9 @@
 #define BCOM_FDT_SIZE		(BCOM_MAX_FDT * sizeof(u32))
 #define BCOM_FDT_ALIGN		0x100
 
+/* Longest interrupt coalescing holdoff */
+#define BCOM_COALESCE_MAX_USECS	USEC_PER_SEC
+
 /**
  * struct bcom_tdt - Task Descriptor Table Entry
  *
@@ -76,6 +79,10 @@ struct bcom_engine {
 	u32				*fdt;
 
 	spinlock_t			lock;
+
+	/* Allocated tasks, for the debugfs statistics */
+	struct bcom_task		*tasks[BCOM_MAX_TASKS];
+	struct dentry			*debugfs;
 };
 
 extern struct bcom_engine *bcom_eng;
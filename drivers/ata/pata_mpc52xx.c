@@ -18,10 +18,13 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/delay.h>
+#include <linux/blkdev.h>
 #include <linux/libata.h>
 #include <linux/of_platform.h>
 #include <linux/types.h>
 
+#include <scsi/scsi_device.h>
+
 #include <asm/cacheflush.h>
 #include <asm/prom.h>
 #include <asm/mpc52xx.h>
@@ -60,6 +63,7 @@ struct mpc52xx_ata_priv {
 	const struct mdmaspec		*mdmaspec;
 	int 				mpc52xx_ata_dma_last_write;
 	int				waiting_for_dma;
+	int				dmatable_failed;
 };
 
 
@@ -198,9 +202,13 @@ static const struct udmaspec udmaspec132[6] = {
 #define MPC52xx_ATA_DMAMODE_FR		0x20 /* FIFO Reset */
 #define MPC52xx_ATA_DMAMODE_HUT		0x40 /* Host UDMA burst terminate */
 
-#define MAX_DMA_BUFFERS 128
 #define MAX_DMA_BUFFER_SIZE 0x20000u
 
+/* Size of the BestComm BD ring; "fsl,bestcomm-bds" in the device tree
+ * overrides the default.  One BD is needed per scatterlist entry */
+#define MPC52xx_ATA_DMA_NUM_BD	256
+#define MPC52xx_ATA_DMA_MAX_BD	1024
+
 /* Structure of the hardware registers */
 struct mpc52xx_ata {
 
@@ -447,7 +455,6 @@ mpc52xx_ata_build_dmatable(struct ata_queued_cmd *qc)
 	struct bcom_ata_bd *bd;
 	unsigned int read = !(qc->tf.flags & ATA_TFLAG_WRITE), si;
 	struct scatterlist *sg;
-	int count = 0;
 
 	if (read)
 		bcom_ata_rx_prepare(priv->dmatsk);
@@ -460,6 +467,14 @@ mpc52xx_ata_build_dmatable(struct ata_queued_cmd *qc)
 
 		while (cur_len) {
 			unsigned int tc = min(cur_len, MAX_DMA_BUFFER_SIZE);
+
+			/* Don't write over a BD that is still queued */
+			if (bcom_queue_full(priv->dmatsk)) {
+				dev_alert(ap->dev, "dma table "
+					"too small\n");
+				goto use_pio_instead;
+			}
+
 			bd = (struct bcom_ata_bd *)
 				bcom_prepare_next_buffer(priv->dmatsk);
 
@@ -479,13 +494,6 @@ mpc52xx_ata_build_dmatable(struct ata_queued_cmd *qc)
 
 			cur_addr += tc;
 			cur_len -= tc;
-			count++;
-
-			if (count > MAX_DMA_BUFFERS) {
-				dev_alert(ap->dev, "dma table"
-					"too small\n");
-				goto use_pio_instead;
-			}
 		}
 	}
 	return 1;
@@ -505,10 +513,6 @@ mpc52xx_bmdma_setup(struct ata_queued_cmd *qc)
 	unsigned int read = !(qc->tf.flags & ATA_TFLAG_WRITE);
 	u8 dma_mode;
 
-	if (!mpc52xx_ata_build_dmatable(qc))
-		dev_alert(ap->dev, "%s: %i, return 1?\n",
-			__func__, __LINE__);
-
 	/* Check FIFO is OK... */
 	if (in_8(&priv->ata_regs->fifo_status) & MPC52xx_ATA_FIFOSTAT_ERROR)
 		dev_alert(ap->dev, "%s: FIFO error detected: 0x%02x!\n",
@@ -605,8 +609,70 @@ mpc52xx_ata_task_irq(int irq, void *vpriv)
 	return IRQ_HANDLED;
 }
 
+/*
+ * The BD table is built here rather than in bmdma_setup: ->qc_prep runs
+ * before the taskfile is loaded, and libata never issues the next command
+ * on this port before the current one has completed, so the BestComm task
+ * is guaranteed to be idle.
+ */
+static void
+mpc52xx_ata_qc_prep(struct ata_queued_cmd *qc)
+{
+	struct mpc52xx_ata_priv *priv = qc->ap->host->private_data;
+
+	priv->dmatable_failed = 0;
+	if (!(qc->flags & ATA_QCFLAG_DMAMAP))
+		return;
+
+	if (!mpc52xx_ata_build_dmatable(qc))
+		priv->dmatable_failed = 1;
+}
+
+/*
+ * ->qc_prep cannot fail a command, so a DMA table that could not be built
+ * is reported here.  mpc52xx_ata_slave_config() keeps requests within the
+ * BD ring, so this should never happen.
+ */
+static unsigned int
+mpc52xx_ata_qc_issue(struct ata_queued_cmd *qc)
+{
+	struct mpc52xx_ata_priv *priv = qc->ap->host->private_data;
+
+	if (WARN_ON(priv->dmatable_failed))
+		return AC_ERR_SYSTEM;
+
+	return ata_sff_qc_issue(qc);
+}
+
+/*
+ * Limit the requests to what the BD ring can take in one go, so that a
+ * fragmented request never overflows the DMA table.
+ */
+static int
+mpc52xx_ata_slave_config(struct scsi_device *sdev)
+{
+	struct ata_port *ap = ata_shost_to_port(sdev->host);
+	struct mpc52xx_ata_priv *priv = ap->host->private_data;
+	struct request_queue *q = sdev->request_queue;
+	unsigned int max_sg = priv->dmatsk->num_bd - 1;
+	int rc;
+
+	rc = ata_scsi_slave_config(sdev);
+	if (rc)
+		return rc;
+
+	blk_queue_max_phys_segments(q, max_sg);
+	blk_queue_max_hw_segments(q, max_sg);
+	blk_queue_max_sectors(q, min(queue_max_sectors(q),
+				     max_sg << (PAGE_SHIFT - 9)));
+
+	return 0;
+}
+
 static struct scsi_host_template mpc52xx_ata_sht = {
 	ATA_PIO_SHT(DRV_NAME),
+	.sg_tablesize		= MPC52xx_ATA_DMA_MAX_BD - 1,
+	.slave_configure	= mpc52xx_ata_slave_config,
 };
 
 static struct ata_port_operations mpc52xx_ata_port_ops = {
@@ -618,7 +684,8 @@ static struct ata_port_operations mpc52xx_ata_port_ops = {
 	.bmdma_start		= mpc52xx_bmdma_start,
 	.bmdma_stop		= mpc52xx_bmdma_stop,
 	.bmdma_status		= mpc52xx_bmdma_status,
-	.qc_prep		= ata_noop_qc_prep,
+	.qc_prep		= mpc52xx_ata_qc_prep,
+	.qc_issue		= mpc52xx_ata_qc_issue,
 };
 
 static int __devinit
@@ -689,6 +756,7 @@ mpc52xx_ata_probe(struct of_device *op, const struct of_device_id *match)
 	struct mpc52xx_ata_priv *priv = NULL;
 	int rv, ret, task_irq = 0;
 	int mwdma_mask = 0, udma_mask = 0;
+	int num_bd = MPC52xx_ATA_DMA_NUM_BD;
 	const __be32 *prop;
 	int proplen;
 	struct bcom_task *dmatsk = NULL;
@@ -742,6 +810,12 @@ mpc52xx_ata_probe(struct of_device *op, const struct of_device_id *match)
 	if ((prop) && (proplen >= 4))
 		udma_mask = ATA_UDMA2 & ((1 << (*prop + 1)) - 1);
 
+	/* The BD ring lives in the BestComm SRAM, shared with the other
+	 * tasks.  Boards short on SRAM can ask for a smaller one. */
+	prop = of_get_property(op->node, "fsl,bestcomm-bds", &proplen);
+	if ((prop) && (proplen >= 4))
+		num_bd = clamp_t(int, *prop, 2, MPC52xx_ATA_DMA_MAX_BD);
+
 	ata_irq = irq_of_parse_and_map(op->node, 0);
 	if (ata_irq == NO_IRQ) {
 		dev_err(&op->dev, "error mapping irq\n");
@@ -772,7 +846,7 @@ mpc52xx_ata_probe(struct of_device *op, const struct of_device_id *match)
 	}
 
 	/* Allocate a BestComm task for DMA */
-	dmatsk = bcom_ata_init(MAX_DMA_BUFFERS, MAX_DMA_BUFFER_SIZE);
+	dmatsk = bcom_ata_init(num_bd, MAX_DMA_BUFFER_SIZE);
 	if (!dmatsk) {
 		dev_err(&op->dev, "bestcomm initialization failed\n");
 		rv = -ENOMEM;
@@ -1130,6 +1130,105 @@ void gpio_set_value_cansleep(unsigned gpio, int value)
 EXPORT_SYMBOL_GPL(gpio_set_value_cansleep);
 
 
+/* Ports let bitbanging code move several signals with one register access.
+ * Bit n of "mask" and "value" stands for GPIO number (gpio + n); all of
+ * them must belong to the same chip.  Chips without port methods fall back
+ * to one get() or set() call per bit.
+ */
+
+/**
+ * gpio_port_valid() - check that several gpios form a port of one chip
+ * @gpio: lowest gpio number of the port
+ * @mask: bit n set for gpio number (@gpio + n)
+ *
+ * Returns nonzero if @gpio and @mask may be passed to gpio_get_port() and
+ * gpio_set_port(), zero if the gpios don't all belong to one chip.
+ */
+int gpio_port_valid(unsigned gpio, unsigned long mask)
+{
+	struct gpio_chip	*chip;
+
+	if (!gpio_is_valid(gpio))
+		return 0;
+	chip = gpio_to_chip(gpio);
+	return chip && gpio - chip->base + fls_long(mask) <=
+		min_t(unsigned, chip->ngpio, BITS_PER_LONG);
+}
+EXPORT_SYMBOL_GPL(gpio_port_valid);
+
+static struct gpio_chip *gpio_port_chip(unsigned gpio, unsigned long mask)
+{
+	struct gpio_chip	*chip;
+
+	if (WARN_ON(!gpio_port_valid(gpio, mask)))
+		return NULL;
+	chip = gpio_to_chip(gpio);
+	might_sleep_if(extra_checks && chip->can_sleep);
+	return chip;
+}
+
+/**
+ * gpio_get_port() - return the values of several gpios of one chip
+ * @gpio: lowest gpio number of the port
+ * @mask: bit n set to read gpio number (@gpio + n)
+ * Context: any, unless gpio_cansleep() is nonzero for @gpio
+ *
+ * Returns the values of the gpios in @mask in the corresponding bits, and
+ * zero in all other bits.
+ */
+unsigned long gpio_get_port(unsigned gpio, unsigned long mask)
+{
+	struct gpio_chip	*chip;
+	unsigned		offset;
+	unsigned long		value = 0;
+	int			i;
+
+	chip = gpio_port_chip(gpio, mask);
+	if (!chip)
+		return 0;
+	offset = gpio - chip->base;
+
+	if (chip->get_port)
+		return chip->get_port(chip, mask << offset) >> offset;
+
+	for (i = 0; i < fls_long(mask); i++)
+		if ((mask & (1UL << i)) && chip->get &&
+		    chip->get(chip, offset + i))
+			value |= 1UL << i;
+	return value;
+}
+EXPORT_SYMBOL_GPL(gpio_get_port);
+
+/**
+ * gpio_set_port() - assign the values of several gpios of one chip
+ * @gpio: lowest gpio number of the port
+ * @mask: bit n set to assign gpio number (@gpio + n)
+ * @value: bit n is the value for gpio number (@gpio + n)
+ * Context: any, unless gpio_cansleep() is nonzero for @gpio
+ */
+void gpio_set_port(unsigned gpio, unsigned long mask, unsigned long value)
+{
+	struct gpio_chip	*chip;
+	unsigned		offset;
+	int			i;
+
+	chip = gpio_port_chip(gpio, mask);
+	if (!chip)
+		return;
+	offset = gpio - chip->base;
+
+	if (chip->set_port) {
+		chip->set_port(chip, mask << offset, value << offset);
+		return;
+	}
+
+	for (i = 0; i < fls_long(mask); i++)
+		if (mask & (1UL << i))
+			chip->set(chip, offset + i, !!(value & (1UL << i)));
+}
+EXPORT_SYMBOL_GPL(gpio_set_port);
+
+
 #ifdef CONFIG_DEBUG_FS
 
 static void gpiolib_dbg_show(struct seq_file *s, struct gpio_chip *chip)
@@ -52,13 +52,33 @@
 #define CSR_MIF  0x02
 #define CSR_RXAK 0x01
 
+/*
+ * A transfer is run by a state machine driven from the I2C interrupt: the
+ * caller sets up the first message and sleeps until the whole i2c_msg
+ * array, repeated starts included, has been done.  Without an interrupt
+ * the caller drives the same state machine by polling the status register.
+ */
+enum mpc_i2c_action {
+	MPC_I2C_ACTION_IDLE,
+	MPC_I2C_ACTION_ADDR,	/* address byte of a message in flight */
+	MPC_I2C_ACTION_WRITE,	/* data byte of a write in flight */
+	MPC_I2C_ACTION_READ,	/* data byte of a read in flight */
+};
+
 struct mpc_i2c {
 	struct device *dev;
 	void __iomem *base;
-	u32 interrupt;
 	wait_queue_head_t queue;
 	struct i2c_adapter adap;
 	int irq;
+	u32 real_clk;		/* bus clock in Hz, 0 if unknown */
+
+	spinlock_t lock;	/* protects the transfer state below */
+	enum mpc_i2c_action action;
+	struct i2c_msg *msg;	/* message in progress */
+	struct i2c_msg *msgs_end;
+	int pos;		/* next byte of *msg */
+	int result;
 };
 
 struct mpc_i2c_divider {
@@ -78,90 +98,165 @@ static inline void writeccr(struct mpc_i2c *i2c, u32 x)
 	writeb(x, i2c->base + MPC_I2C_CR);
 }
 
-static irqreturn_t mpc_i2c_isr(int irq, void *dev_id)
+/* Time for one byte plus acknowledge on the bus, in microseconds */
+static unsigned int mpc_i2c_byte_time(struct mpc_i2c *i2c)
 {
-	struct mpc_i2c *i2c = dev_id;
-	if (readb(i2c->base + MPC_I2C_SR) & CSR_MIF) {
-		/* Read again to allow register to stabilise */
-		i2c->interrupt = readb(i2c->base + MPC_I2C_SR);
-		writeb(0, i2c->base + MPC_I2C_SR);
-		wake_up(&i2c->queue);
-	}
-	return IRQ_HANDLED;
+	if (!i2c->real_clk)
+		return 100;	/* assume the slowest standard mode clock */
+	return DIV_ROUND_UP(9 * 1000000, i2c->real_clk);
 }
 
 /* Sometimes 9th clock pulse isn't generated, and slave doesn't release
  * the bus, because it wants to send ACK.
- * Following sequence of enabling/disabling and sending start/stop generates
- * the pulse, so it's all OK.
+ * Enabling the controller in master mode and disabling it again clocks
+ * out one pulse; nine of them get any slave to let go of SDA.
  */
 static void mpc_i2c_fixup(struct mpc_i2c *i2c)
 {
-	writeccr(i2c, 0);
-	udelay(30);
-	writeccr(i2c, CCR_MEN);
-	udelay(30);
-	writeccr(i2c, CCR_MSTA | CCR_MTX);
-	udelay(30);
-	writeccr(i2c, CCR_MSTA | CCR_MTX | CCR_MEN);
-	udelay(30);
-	writeccr(i2c, CCR_MEN);
-	udelay(30);
+	unsigned int delay = 30;
+	int k;
+
+	if (i2c->real_clk)
+		delay = max(2u, 2 * DIV_ROUND_UP(1000000, i2c->real_clk));
+
+	for (k = 9; k; k--) {
+		writeccr(i2c, 0);
+		writeccr(i2c, CCR_MSTA | CCR_MTX | CCR_MEN);
+		readb(i2c->base + MPC_I2C_DR);
+		writeccr(i2c, CCR_MEN);
+		udelay(delay);
+	}
 }
 
-static int i2c_wait(struct mpc_i2c *i2c, unsigned timeout, int writing)
+/*
+ * Put the address byte of i2c->msg on the bus, with a repeated start if
+ * the bus is still ours from the previous message.
+ */
+static void mpc_i2c_start_msg(struct mpc_i2c *i2c, int restart)
 {
-	unsigned long orig_jiffies = jiffies;
-	u32 x;
-	int result = 0;
+	struct i2c_msg *msg = i2c->msg;
+	u8 addr = msg->addr << 1;
 
-	if (i2c->irq == NO_IRQ) {
-		while (!(readb(i2c->base + MPC_I2C_SR) & CSR_MIF)) {
-			schedule();
-			if (time_after(jiffies, orig_jiffies + timeout)) {
-				dev_dbg(i2c->dev, "timeout\n");
-				writeccr(i2c, 0);
-				result = -EIO;
-				break;
-			}
-		}
-		x = readb(i2c->base + MPC_I2C_SR);
-		writeb(0, i2c->base + MPC_I2C_SR);
-	} else {
-		/* Interrupt mode */
-		result = wait_event_timeout(i2c->queue,
-			(i2c->interrupt & CSR_MIF), timeout);
+	if (msg->flags & I2C_M_RD)
+		addr |= 1;
 
-		if (unlikely(!(i2c->interrupt & CSR_MIF))) {
-			dev_dbg(i2c->dev, "wait timeout\n");
-			writeccr(i2c, 0);
-			result = -ETIMEDOUT;
-		}
+	i2c->pos = 0;
+	i2c->action = MPC_I2C_ACTION_ADDR;
 
-		x = i2c->interrupt;
-		i2c->interrupt = 0;
-	}
+	writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA | CCR_MTX |
+		 (restart ? CCR_RSTA : 0));
+	writeb(addr, i2c->base + MPC_I2C_DR);
+}
 
-	if (result < 0)
-		return result;
+/* Release the bus and report @result to the waiting caller */
+static void mpc_i2c_finish(struct mpc_i2c *i2c, int result)
+{
+	/* Dropping MSTA generates the stop condition */
+	writeccr(i2c, CCR_MEN);
 
-	if (!(x & CSR_MCF)) {
-		dev_dbg(i2c->dev, "unfinished\n");
-		return -EIO;
-	}
+	i2c->result = result;
+	i2c->action = MPC_I2C_ACTION_IDLE;
+	wake_up(&i2c->queue);
+}
 
-	if (x & CSR_MAL) {
+/*
+ * Advance the transfer after the byte in flight has completed with status
+ * @sr.  Called with i2c->lock held, from the interrupt or the poll loop.
+ */
+static void mpc_i2c_do_intr(struct mpc_i2c *i2c, u8 sr)
+{
+	struct i2c_msg *msg = i2c->msg;
+
+	if (i2c->action == MPC_I2C_ACTION_IDLE)
+		return;
+
+	if (sr & CSR_MAL) {
 		dev_dbg(i2c->dev, "MAL\n");
-		return -EIO;
+		/* Another master has the bus, so there is no stop to send */
+		mpc_i2c_finish(i2c, -EAGAIN);
+		return;
 	}
 
-	if (writing && (x & CSR_RXAK)) {
+	if (!(sr & CSR_MCF)) {
+		dev_dbg(i2c->dev, "unfinished\n");
+		mpc_i2c_finish(i2c, -EIO);
+		return;
+	}
+
+	if (i2c->action != MPC_I2C_ACTION_READ && (sr & CSR_RXAK)) {
 		dev_dbg(i2c->dev, "No RXAK\n");
-		/* generate stop */
-		writeccr(i2c, CCR_MEN);
-		return -EIO;
+		mpc_i2c_finish(i2c, i2c->action == MPC_I2C_ACTION_ADDR ?
+			       -ENXIO : -EIO);
+		return;
 	}
-	return 0;
+
+	switch (i2c->action) {
+	case MPC_I2C_ACTION_ADDR:
+		if (msg->flags & I2C_M_RD) {
+			if (!msg->len)
+				break;
+			/* Switch to receive; the dummy read clocks in byte 0 */
+			writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA |
+				 (msg->len == 1 ? CCR_TXAK : 0));
+			readb(i2c->base + MPC_I2C_DR);
+			i2c->action = MPC_I2C_ACTION_READ;
+			return;
+		}
+		i2c->action = MPC_I2C_ACTION_WRITE;
+		/* fall through - send the first data byte */
+	case MPC_I2C_ACTION_WRITE:
+		if (i2c->pos < msg->len) {
+			writeb(msg->buf[i2c->pos++], i2c->base + MPC_I2C_DR);
+			return;
+		}
+		break;
+
+	case MPC_I2C_ACTION_READ:
+		/*
+		 * Reading DR starts the next byte unless the controller is in
+		 * transmit mode: NAK the last byte and keep the bus for the
+		 * stop or repeated start that follows.
+		 */
+		if (i2c->pos == msg->len - 2)
+			writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA |
+				 CCR_TXAK);
+		else if (i2c->pos == msg->len - 1)
+			writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA |
+				 CCR_MTX | CCR_TXAK);
+		msg->buf[i2c->pos++] = readb(i2c->base + MPC_I2C_DR);
+		if (i2c->pos < msg->len)
+			return;
+		break;
+
+	default:
+		break;
+	}
+
+	/* Message done */
+	i2c->msg++;
+	if (i2c->msg == i2c->msgs_end)
+		mpc_i2c_finish(i2c, 0);
+	else
+		mpc_i2c_start_msg(i2c, 1);
+}
+
+static irqreturn_t mpc_i2c_isr(int irq, void *dev_id)
+{
+	struct mpc_i2c *i2c = dev_id;
+	u8 sr;
+
+	if (!(readb(i2c->base + MPC_I2C_SR) & CSR_MIF))
+		return IRQ_NONE;
+
+	/* Read again to allow register to stabilise */
+	sr = readb(i2c->base + MPC_I2C_SR);
+	writeb(0, i2c->base + MPC_I2C_SR);
+
+	spin_lock(&i2c->lock);
+	mpc_i2c_do_intr(i2c, sr);
+	spin_unlock(&i2c->lock);
+
+	return IRQ_HANDLED;
 }
 
 #ifdef CONFIG_PPC_MPC52xx
@@ -186,18 +281,20 @@ static const struct mpc_i2c_divider mpc_i2c_dividers_52xx[] = {
 	{10240, 0x9d}, {12288, 0x9e}, {15360, 0x9f}
 };
 
-int mpc_i2c_get_fdr_52xx(struct device_node *node, u32 clock, int prescaler)
+int mpc_i2c_get_fdr_52xx(struct device_node *node, u32 clock, int prescaler,
+			 u32 *real_clk)
 {
 	const struct mpc_i2c_divider *div = NULL;
 	unsigned int pvr = mfspr(SPRN_PVR);
-	u32 divider;
+	u32 divider, ipb;
 	int i;
 
 	if (!clock)
 		return -EINVAL;
 
 	/* Determine divider value */
-	divider = mpc5xxx_get_bus_frequency(node) / clock;
+	ipb = mpc5xxx_get_bus_frequency(node);
+	divider = ipb / clock;
 
 	/*
 	 * We want to choose an FDR/DFSR that generates an I2C bus speed that
@@ -212,7 +309,11 @@ int mpc_i2c_get_fdr_52xx(struct device_node *node, u32 clock, int prescaler)
 			break;
 	}
 
-	return div ? (int)div->fdr : -EINVAL;
+	if (!div)
+		return -EINVAL;
+
+	*real_clk = ipb / div->divider;
+	return div->fdr;
 }
 
 static void mpc_i2c_setclock_52xx(struct device_node *node,
@@ -221,13 +322,14 @@ static void mpc_i2c_setclock_52xx(struct device_node *node,
 {
 	int ret, fdr;
 
-	ret = mpc_i2c_get_fdr_52xx(node, clock, prescaler);
+	ret = mpc_i2c_get_fdr_52xx(node, clock, prescaler, &i2c->real_clk);
 	fdr = (ret >= 0) ? ret : 0x3f; /* backward compatibility */
 
 	writeb(fdr & 0xff, i2c->base + MPC_I2C_FDR);
 
 	if (ret >= 0)
-		dev_info(i2c->dev, "clock %d Hz (fdr=%d)\n", clock, fdr);
+		dev_info(i2c->dev, "clock %u Hz (fdr=%d)\n", i2c->real_clk,
+			 fdr);
 }
 #else /* !CONFIG_PPC_MPC52xx */
 static void mpc_i2c_setclock_52xx(struct device_node *node,
@@ -260,10 +362,14 @@ static const struct mpc_i2c_divider mpc_i2c_dividers_8xxx[] = {
 
 u32 mpc_i2c_get_sec_cfg_8xxx(void)
 {
+	static int sec_cfg = -1;	/* PORDEVSR2 is fixed at reset */
 	struct device_node *node = NULL;
 	u32 __iomem *reg;
 	u32 val = 0;
 
+	if (sec_cfg >= 0)
+		return sec_cfg;
+
 	node = of_find_node_by_name(NULL, "global-utilities");
 	if (node) {
 		const u32 *prop = of_get_property(node, "reg", NULL);
@@ -284,13 +390,15 @@ u32 mpc_i2c_get_sec_cfg_8xxx(void)
 	if (node)
 		of_node_put(node);
 
+	sec_cfg = val;
 	return val;
 }
 
-int mpc_i2c_get_fdr_8xxx(struct device_node *node, u32 clock, u32 prescaler)
+int mpc_i2c_get_fdr_8xxx(struct device_node *node, u32 clock, u32 prescaler,
+			 u32 *real_clk)
 {
 	const struct mpc_i2c_divider *div = NULL;
-	u32 divider;
+	u32 divider, src_clock;
 	int i;
 
 	if (!clock)
@@ -302,10 +410,11 @@ int mpc_i2c_get_fdr_8xxx(struct device_node *node, u32 clock, u32 prescaler)
 	if (!prescaler)
 		prescaler = 1;
 
-	divider = fsl_get_sys_freq() / clock / prescaler;
+	src_clock = fsl_get_sys_freq() / prescaler;
+	divider = src_clock / clock;
 
 	pr_debug("I2C: src_clock=%d clock=%d divider=%d\n",
-		 fsl_get_sys_freq(), clock, divider);
+		 src_clock, clock, divider);
 
 	/*
 	 * We want to choose an FDR/DFSR that generates an I2C bus speed that
@@ -317,7 +426,11 @@ int mpc_i2c_get_fdr_8xxx(struct device_node *node, u32 clock, u32 prescaler)
 			break;
 	}
 
-	return div ? (int)div->fdr : -EINVAL;
+	if (!div)
+		return -EINVAL;
+
+	*real_clk = src_clock / div->divider;
+	return div->fdr;
 }
 
 static void mpc_i2c_setclock_8xxx(struct device_node *node,
@@ -326,15 +439,15 @@ static void mpc_i2c_setclock_8xxx(struct device_node *node,
 {
 	int ret, fdr;
 
-	ret = mpc_i2c_get_fdr_8xxx(node, clock, prescaler);
+	ret = mpc_i2c_get_fdr_8xxx(node, clock, prescaler, &i2c->real_clk);
 	fdr = (ret >= 0) ? ret : 0x1031; /* backward compatibility */
 
 	writeb(fdr & 0xff, i2c->base + MPC_I2C_FDR);
 	writeb((fdr >> 8) & 0xff, i2c->base + MPC_I2C_DFSRR);
 
 	if (ret >= 0)
-		dev_info(i2c->dev, "clock %d Hz (dfsrr=%d fdr=%d)\n",
-			 clock, fdr >> 8, fdr & 0xff);
+		dev_info(i2c->dev, "clock %u Hz (dfsrr=%d fdr=%d)\n",
+			 i2c->real_clk, fdr >> 8, fdr & 0xff);
 }
 
 #else /* !CONFIG_FSL_SOC */
@@ -345,104 +458,61 @@ static void mpc_i2c_setclock_8xxx(struct device_node *node,
 }
 #endif /* CONFIG_FSL_SOC */
 
-static void mpc_i2c_start(struct mpc_i2c *i2c)
-{
-	/* Clear arbitration */
-	writeb(0, i2c->base + MPC_I2C_SR);
-	/* Start with MEN */
-	writeccr(i2c, CCR_MEN);
-}
-
-static void mpc_i2c_stop(struct mpc_i2c *i2c)
+static int mpc_i2c_idle(struct mpc_i2c *i2c)
 {
-	writeccr(i2c, CCR_MEN);
-}
+	unsigned long flags;
+	int idle;
 
-static int mpc_write(struct mpc_i2c *i2c, int target,
-		     const u8 *data, int length, int restart)
-{
-	int i, result;
-	unsigned timeout = i2c->adap.timeout;
-	u32 flags = restart ? CCR_RSTA : 0;
+	spin_lock_irqsave(&i2c->lock, flags);
+	idle = i2c->action == MPC_I2C_ACTION_IDLE;
+	spin_unlock_irqrestore(&i2c->lock, flags);
 
-	/* Start with MEN */
-	if (!restart)
-		writeccr(i2c, CCR_MEN);
-	/* Start as master */
-	writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA | CCR_MTX | flags);
-	/* Write target byte */
-	writeb((target << 1), i2c->base + MPC_I2C_DR);
-
-	result = i2c_wait(i2c, timeout, 1);
-	if (result < 0)
-		return result;
-
-	for (i = 0; i < length; i++) {
-		/* Write data byte */
-		writeb(data[i], i2c->base + MPC_I2C_DR);
-
-		result = i2c_wait(i2c, timeout, 1);
-		if (result < 0)
-			return result;
-	}
-
-	return 0;
+	return idle;
 }
 
-static int mpc_read(struct mpc_i2c *i2c, int target,
-		    u8 *data, int length, int restart)
+/*
+ * Without an interrupt, poll for each byte: spin for about two byte times,
+ * which covers a device that doesn't stretch the clock, then back off to
+ * sleeping a tick at a time.
+ */
+static void mpc_i2c_poll(struct mpc_i2c *i2c, unsigned long deadline)
 {
-	unsigned timeout = i2c->adap.timeout;
-	int i, result;
-	u32 flags = restart ? CCR_RSTA : 0;
+	unsigned int spin = 2 * mpc_i2c_byte_time(i2c);
+	unsigned long flags;
+	unsigned int t;
+	u8 sr;
+
+	while (!mpc_i2c_idle(i2c) && time_before(jiffies, deadline)) {
+		for (t = 0; t < spin; t++) {
+			if (readb(i2c->base + MPC_I2C_SR) & CSR_MIF)
+				break;
+			udelay(1);
+		}
+		if (!(readb(i2c->base + MPC_I2C_SR) & CSR_MIF)) {
+			schedule_timeout_uninterruptible(1);
+			continue;
+		}
 
-	/* Start with MEN */
-	if (!restart)
-		writeccr(i2c, CCR_MEN);
-	/* Switch to read - restart */
-	writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA | CCR_MTX | flags);
-	/* Write target address byte - this time with the read flag set */
-	writeb((target << 1) | 1, i2c->base + MPC_I2C_DR);
-
-	result = i2c_wait(i2c, timeout, 1);
-	if (result < 0)
-		return result;
-
-	if (length) {
-		if (length == 1)
-			writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA | CCR_TXAK);
-		else
-			writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA);
-		/* Dummy read */
-		readb(i2c->base + MPC_I2C_DR);
-	}
+		sr = readb(i2c->base + MPC_I2C_SR);
+		writeb(0, i2c->base + MPC_I2C_SR);
 
-	for (i = 0; i < length; i++) {
-		result = i2c_wait(i2c, timeout, 0);
-		if (result < 0)
-			return result;
-
-		/* Generate txack on next to last byte */
-		if (i == length - 2)
-			writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_MSTA | CCR_TXAK);
-		/* Generate stop on last byte */
-		if (i == length - 1)
-			writeccr(i2c, CCR_MIEN | CCR_MEN | CCR_TXAK);
-		data[i] = readb(i2c->base + MPC_I2C_DR);
+		spin_lock_irqsave(&i2c->lock, flags);
+		mpc_i2c_do_intr(i2c, sr);
+		spin_unlock_irqrestore(&i2c->lock, flags);
 	}
-
-	return length;
 }
 
 static int mpc_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 {
-	struct i2c_msg *pmsg;
-	int i;
-	int ret = 0;
-	unsigned long orig_jiffies = jiffies;
 	struct mpc_i2c *i2c = i2c_get_adapdata(adap);
+	unsigned long orig_jiffies = jiffies;
+	unsigned long flags, timeout;
+	int ret;
 
-	mpc_i2c_start(i2c);
+	/* Clear arbitration */
+	writeb(0, i2c->base + MPC_I2C_SR);
+	/* Start with MEN */
+	writeccr(i2c, CCR_MEN);
 
 	/* Allow bus up to 1s to become not busy */
 	while (readb(i2c->base + MPC_I2C_SR) & CSR_MBB) {
@@ -458,24 +528,37 @@ static int mpc_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 				mpc_i2c_fixup(i2c);
 			return -EIO;
 		}
-		schedule();
+		schedule_timeout_interruptible(1);
 	}
 
-	for (i = 0; ret >= 0 && i < num; i++) {
-		pmsg = &msgs[i];
-		dev_dbg(i2c->dev,
-			"Doing %s %d bytes to 0x%02x - %d of %d messages\n",
-			pmsg->flags & I2C_M_RD ? "read" : "write",
-			pmsg->len, pmsg->addr, i + 1, num);
-		if (pmsg->flags & I2C_M_RD)
-			ret =
-			    mpc_read(i2c, pmsg->addr, pmsg->buf, pmsg->len, i);
-		else
-			ret =
-			    mpc_write(i2c, pmsg->addr, pmsg->buf, pmsg->len, i);
+	dev_dbg(i2c->dev, "Doing %d messages to 0x%02x\n", num, msgs->addr);
+
+	/* Each message gets the time a single byte used to get */
+	timeout = adap->timeout * num;
+
+	spin_lock_irqsave(&i2c->lock, flags);
+	i2c->msg = msgs;
+	i2c->msgs_end = msgs + num;
+	i2c->result = 0;
+	mpc_i2c_start_msg(i2c, 0);
+	spin_unlock_irqrestore(&i2c->lock, flags);
+
+	if (i2c->irq == NO_IRQ)
+		mpc_i2c_poll(i2c, jiffies + timeout);
+	else
+		wait_event_timeout(i2c->queue, mpc_i2c_idle(i2c), timeout);
+
+	spin_lock_irqsave(&i2c->lock, flags);
+	if (i2c->action != MPC_I2C_ACTION_IDLE) {
+		dev_dbg(i2c->dev, "wait timeout\n");
+		i2c->action = MPC_I2C_ACTION_IDLE;
+		writeccr(i2c, 0);
+		i2c->result = -ETIMEDOUT;
 	}
-	mpc_i2c_stop(i2c);
-	return (ret < 0) ? ret : num;
+	ret = i2c->result;
+	spin_unlock_irqrestore(&i2c->lock, flags);
+
+	return ret < 0 ? ret : num;
 }
 
 static u32 mpc_functionality(struct i2c_adapter *adap)
@@ -511,6 +594,7 @@ static int __devinit fsl_i2c_probe(struct of_device *op,
 	i2c->dev = &op->dev; /* for debug and error output */
 
 	init_waitqueue_head(&i2c->queue);
+	spin_lock_init(&i2c->lock);
 
 	i2c->base = of_iomap(op->node, 0);
 	if (!i2c->base) {
@@ -21,30 +21,70 @@
 #include <linux/kernel.h>
 #include <linux/device.h>
 #include <linux/input.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
 
 #include "ir.h"
 
+struct remote {
+	struct config_group group;
+	struct input_dev *input;
+};
+
+static inline struct remote *to_remote(struct config_group *group)
+{
+	return group ? container_of(group, struct remote, group) : NULL;
+}
+
 struct keymap {
 	struct config_item item;
+	struct hlist_node hash;
+	struct rcu_head rcu;
+	struct remote *remote;
+	unsigned int key_set;	/* KEY_SET_* bits written so far */
 	int protocol;
 	int device;
 	int command;
 	int keycode;
 };
 
+#define KEY_SET_PROTOCOL	0x1
+#define KEY_SET_DEVICE		0x2
+#define KEY_SET_COMMAND		0x4
+#define KEY_SET_ALL		(KEY_SET_PROTOCOL | KEY_SET_DEVICE | \
+				 KEY_SET_COMMAND)
+
 static inline struct keymap *to_keymap(struct config_item *item)
 {
 	return item ? container_of(item, struct keymap, item) : NULL;
 }
 
-struct remote {
-	struct config_group group;
-	struct input_dev *input;
-};
+/*
+ * All keymaps of all remotes are indexed by (protocol, device, command)
+ * so that input_ir_translate() doesn't have to walk the configfs tree.
+ * Lookups run under RCU; changes to the index are serialised by
+ * keymap_hash_mutex.  A keymap is only hashed once protocol, device and
+ * command have all been written, so filling in a new keymap never has
+ * to wait for a grace period.
+ */
+#define KEYMAP_HASH_BITS	10
+#define KEYMAP_HASH_SIZE	(1 << KEYMAP_HASH_BITS)
 
-static inline struct remote *to_remote(struct config_group *group)
+static struct hlist_head keymap_hash[KEYMAP_HASH_SIZE];
+static DEFINE_MUTEX(keymap_hash_mutex);
+
+static struct hlist_head *keymap_bucket(int protocol, int device, int command)
 {
-	return group ? container_of(group, struct remote, group) : NULL;
+	u32 hash = jhash_3words(protocol, device, command, 0);
+
+	return &keymap_hash[hash & (KEYMAP_HASH_SIZE - 1)];
+}
+
+static void keymap_hash_add(struct keymap *keymap)
+{
+	hlist_add_head_rcu(&keymap->hash, keymap_bucket(keymap->protocol,
+							keymap->device,
+							keymap->command));
 }
 
 
@@ -103,13 +143,29 @@ static ssize_t item_store(struct config_item *item,
 	if (tmp > INT_MAX)
 		return -ERANGE;
 
-	if (attr == &item_protocol)
-		keymap->protocol = tmp;
-	else if (attr == &item_device)
-		keymap->device = tmp;
-	else if (attr == &item_command)
-		keymap->command = tmp;
-	else {
+	if (attr != &item_keycode) {
+		mutex_lock(&keymap_hash_mutex);
+		if (!hlist_unhashed(&keymap->hash)) {
+			/* The keymap moves to another bucket.  Wait for the
+			 * lookups that may still be walking the old one
+			 * before relinking */
+			hlist_del_rcu(&keymap->hash);
+			synchronize_rcu();
+		}
+		if (attr == &item_protocol) {
+			keymap->protocol = tmp;
+			keymap->key_set |= KEY_SET_PROTOCOL;
+		} else if (attr == &item_device) {
+			keymap->device = tmp;
+			keymap->key_set |= KEY_SET_DEVICE;
+		} else {
+			keymap->command = tmp;
+			keymap->key_set |= KEY_SET_COMMAND;
+		}
+		if (keymap->key_set == KEY_SET_ALL)
+			keymap_hash_add(keymap);
+		mutex_unlock(&keymap_hash_mutex);
+	} else {
 		if (tmp < KEY_MAX) {
 			remote = to_remote(to_config_group(item->ci_parent));
 			set_bit(tmp, remote->input->keybit);
@@ -119,6 +175,11 @@ static ssize_t item_store(struct config_item *item,
 	return count;
 }
 
+static void keymap_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct keymap, rcu));
+}
+
 static void keymap_release(struct config_item *item)
 {
 	struct keymap *keymap = to_keymap(item);
@@ -126,7 +187,12 @@ static void keymap_release(struct config_item *item)
 
 	printk("keymap release\n");
 	clear_bit(keymap->keycode, remote->input->keybit);
-	kfree(keymap);
+
+	mutex_lock(&keymap_hash_mutex);
+	if (!hlist_unhashed(&keymap->hash))
+		hlist_del_rcu(&keymap->hash);
+	mutex_unlock(&keymap_hash_mutex);
+	call_rcu(&keymap->rcu, keymap_free_rcu);
 }
 
 static struct configfs_item_operations keymap_ops = {
@@ -161,6 +227,9 @@ static struct config_item *make_keymap(struct config_group *group, const char *n
 		return ERR_PTR(-ENOMEM);
 
 	config_item_init_type_name(&keymap->item, name, &keymap_type);
+	keymap->remote = to_remote(group);
+	INIT_HLIST_NODE(&keymap->hash);
+
 	return &keymap->item;
 }
 
@@ -197,6 +266,8 @@ static void remote_release(struct config_item *item)
 	struct remote *remote  = to_remote(group);
 
 	printk("remote_release\n");
+	/* Lookups that found one of our keymaps may still use the device */
+	synchronize_rcu();
 	input_free_device(remote->input);
 	kfree(remote);
 }
@@ -318,9 +389,7 @@ struct configfs_subsystem input_ir_remotes = {
 
 void input_ir_translate(struct input_dev *dev, int protocol, int device, int command)
 {
-	struct config_item *i, *j;
-	struct config_group *g;
-	struct remote *remote;
+	struct hlist_node *node;
 	struct keymap *keymap;
 
 	/* generate the IR format event */
@@ -329,20 +398,18 @@ void input_ir_translate(struct input_dev *dev, int protocol, int device, int com
 	input_report_ir(dev, IR_COMMAND, command);
 	input_sync(dev);
 
-    mutex_lock(&input_ir_remotes.su_mutex);
-
-    /* search the translation maps to translate into key stroke */
-    list_for_each_entry(i, &input_ir_remotes.su_group.cg_children, ci_entry) {
-    	g = to_config_group(i);
-        list_for_each_entry(j, &g->cg_children, ci_entry) {
-        	keymap = to_keymap(j);
-        	if ((keymap->protocol == protocol) && (keymap->device == device)
-        			&& (keymap->command == command)) {
-				remote = to_remote(g);
-				input_report_key(remote->input, keymap->keycode, 1);
-				input_sync(remote->input);
-        	}
-        }
-    }
-    mutex_unlock(&input_ir_remotes.su_mutex);
+	/* search the translation maps to translate into key stroke */
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(keymap, node,
+				 keymap_bucket(protocol, device, command),
+				 hash) {
+		if ((keymap->protocol == protocol) &&
+		    (keymap->device == device) &&
+		    (keymap->command == command)) {
+			input_report_key(keymap->remote->input,
+					 keymap->keycode, 1);
+			input_sync(keymap->remote->input);
+		}
+	}
+	rcu_read_unlock();
 }
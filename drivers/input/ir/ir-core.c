@@ -7,6 +7,8 @@
 #include <linux/kernel.h>
 #include <linux/device.h>
 #include <linux/input.h>
+#include <linux/kfifo.h>
+#include <linux/rcupdate.h>
 
 #include "ir.h"
 
@@ -54,68 +56,6 @@ static int encode_sony(struct ir_device *ir, struct ir_command *command)
 	return 0;
 }
 
-static int decode_sony(struct input_dev *dev, struct ir_protocol *sony, unsigned int d, unsigned int bit)
-{
-	/* Sony SIRC IR code */
-	/* http://www.sbprojects.com/knowledge/ir/sirc.htm */
-	/* based on a 600us cadence */
-	int ret = 0, delta = d;
-	int protocol, device, command;
-
-	delta = (delta + 300) / 600;
-
-	if ((bit == 0) && (delta > 22)) {
-		PDEBUG("SIRC state 1\n");
-		if ((sony->state == 26) || (sony->state == 32) || (sony->state == 42)) {
-			if (sony->good && (sony->good == sony->code)) {
-
-				protocol = (sony->state == 26) ? IR_PROTOCOL_SONY_12 :
-					(sony->state == 32) ? IR_PROTOCOL_SONY_15 : IR_PROTOCOL_SONY_20;
-
-				if (sony->state == 26) {
-					device = sony->code & 0x1F;
-					command = sony->code >> 5;
-				} else {
-					device = sony->code & 0xFF;
-					command = sony->code >> 8;
-				}
-				input_ir_translate(dev, protocol, device, command);
-				sony->good = 0;
-				ret = 1;
-			} else {
-				PDEBUG("SIRC - Saving %d bit %05x\n", (sony->state - 2) / 2, sony->code);
-				sony->good = sony->code;
-			}
-		}
-		sony->state = 1;
-		sony->code = 0;
-		return ret;
-	}
-	if ((sony->state == 1) && (bit == 1) && (delta == 4)) {
-		sony->state = 2;
-		PDEBUG("SIRC state 2\n");
-		return 0;
-	}
-	if ((sony->state == 2) && (bit == 0) && (delta == 1)) {
-		sony->state = 3;
-		PDEBUG("SIRC state 3\n");
-		return 0;
-	}
-	if ((sony->state >= 3) && (sony->state & 1) && (bit == 1) && ((delta == 1) || (delta == 2))) {
-		sony->state++;
-		sony->code |= ((delta - 1) << ((sony->state - 4) / 2));
-		PDEBUG("SIRC state %d bit %d\n", sony->state, delta - 1);
-		return 0;
-	}
-	if ((sony->state >= 3) && !(sony->state & 1) && (bit == 0) && (delta == 1)) {
-		sony->state++;
-		PDEBUG("SIRC state %d\n", sony-> state);
-		return 0;
-	}
-	sony->state = 0;
-	return 0;
-}
-
 
 static int encode_jvc(struct ir_device *ir, struct ir_command *command)
 {
@@ -150,59 +90,6 @@ static int encode_jvc(struct ir_device *ir, struct ir_command *command)
 	return 0;
 }
 
-static int decode_jvc(struct input_dev *dev, struct ir_protocol *jvc, unsigned int d, unsigned int bit)
-{
-	/* JVC IR code */
-	/* http://www.sbprojects.com/knowledge/ir/jvc.htm */
-	/* based on a 525us cadence */
-	int ret = 0, delta = d;
-
-	delta = (delta + 263) / 525;
-
-	if ((bit == 0) && (delta > 22)) {
-		PDEBUG("JVC state 1\n");
-		jvc->state = 1;
-		jvc->code = 0;
-		return ret;
-	}
-	if ((jvc->state == 1) && (bit == 1) && (delta == 16)) {
-		jvc->state = 2;
-		PDEBUG("JVC state 2\n");
-		return 0;
-	}
-	if ((jvc->state == 2) && (bit == 0) && (delta == 8)) {
-		jvc->state = 3;
-		PDEBUG("JVC state 3\n");
-		return 0;
-	}
-	if ((jvc->state >= 3) && (jvc->state & 1) && (bit == 1) && (delta == 1)) {
-		jvc->state++;
-		PDEBUG("JVC state %d\n", jvc-> state);
-		return 0;
-	}
-	if ((jvc->state >= 3) && !(jvc->state & 1) && (bit == 0) && ((delta == 1) || (delta == 3))) {
-		if (delta == 3)
-			jvc->code |= 1 << ((jvc->state - 4) / 2);
-		jvc->state++;
-		PDEBUG("JVC state %d bit %d\n", jvc->state, delta - 1);
-		if (jvc->state == 34) {
-			jvc->state = 3;
-			if (jvc->good && (jvc->good == jvc->code)) {
-				input_ir_translate(dev, IR_PROTOCOL_JVC, jvc->code >> 8, jvc->code & 0xFF);
-				jvc->good = 0;
-				ret = 1;
-			} else {
-				PDEBUG("JVC - Saving 16 bit %05x\n", jvc->code);
-				jvc->good = jvc->code;
-			}
-			jvc->code = 0;
-		}
-		return 0;
-	}
-	jvc->state = 0;
-	return 0;
-}
-
 
 static int encode_nec(struct ir_device *ir, struct ir_command *command)
 {
@@ -237,52 +124,6 @@ static int encode_nec(struct ir_device *ir, struct ir_command *command)
 	return 0;
 }
 
-static int decode_nec(struct input_dev *dev, struct ir_protocol *nec, unsigned int d, unsigned int bit)
-{
-	/* NEC IR code */
-	/* http://www.sbprojects.com/knowledge/ir/nec.htm */
-	/* based on a 560us cadence */
-	int delta = d;
-
-	delta = (delta + 280) / 560;
-
-	if ((bit == 0) && (delta > 22)) {
-		PDEBUG("nec state 1\n");
-		nec->state = 1;
-		nec->code = 0;
-		return 0;
-	}
-	if ((nec->state == 1) && (bit == 1) && (delta == 16)) {
-		nec->state = 2;
-		PDEBUG("nec state 2\n");
-		return 0;
-	}
-	if ((nec->state == 2) && (bit == 0) && (delta == 8)) {
-		nec->state = 3;
-		PDEBUG("nec state 3\n");
-		return 0;
-	}
-	if ((nec->state >= 3) && (nec->state & 1) && (bit == 1) && (delta == 1)) {
-		nec->state++;
-		PDEBUG("nec state %d\n", nec-> state);
-		if (nec->state == 68) {
-			input_ir_translate(dev, IR_PROTOCOL_NEC, nec->code >> 16, nec->code & 0xFFFF);
-			return 1;
-		}
-		return 0;
-	}
-	if ((nec->state >= 3) && !(nec->state & 1) && (bit == 0) && ((delta == 1) || (delta == 3))) {
-		if (delta == 3)
-			nec->code |= 1 << ((nec->state - 4) / 2);
-		nec->state++;
-		PDEBUG("nec state %d bit %d\n", nec->state, delta - 1);
-		return 0;
-	}
-	nec->state = 0;
-	nec->code = 0;
-	return 0;
-}
-
 
 static int encode_rc5(struct ir_device *ir, struct ir_command *command)
 {
@@ -291,18 +132,6 @@ static int encode_rc5(struct ir_device *ir, struct ir_command *command)
 	return 0;
 }
 
-static int decode_rc5(struct input_dev *dev, struct ir_protocol *rc5, unsigned int d, unsigned int bit)
-{
-	/* Philips RC-5 IR code */
-	/* http://www.sbprojects.com/knowledge/ir/rc5.htm */
-	/* based on a 889us cadence */
-	int delta = d;
-
-	delta = (delta + 444) / 889;
-
-	return 0;
-}
-
 
 static int encode_rc6(struct ir_device *ir, struct ir_command *command)
 {
@@ -415,6 +244,143 @@ static int decode_rc6(struct input_dev *dev, struct ir_protocol *rc6, unsigned i
 	return 0;
 }
 
+/*
+ * Pulse coded protocols are described by a table and run through a single
+ * state machine:
+ *   state 0	waiting for the gap preceding a frame
+ *   state 1	gap seen, expecting the header mark
+ *   state 2	expecting the header space
+ *   state >= 3	data; odd states expect a mark, even states a space
+ * A protocol not inside a frame ignores everything but a gap, so the
+ * remotes of other protocols cost a single comparison per edge.
+ */
+static const struct ir_pulse_protocol ir_pulse_protocols[] = {
+	{	/* Sony SIRC, http://www.sbprojects.com/knowledge/ir/sirc.htm */
+		.unit = 600, .gap = 22, .header_mark = 4, .header_space = 1,
+		.coding = IR_PULSE_WIDTH, .zero = 1, .one = 2, .other = 1,
+		.flags = IR_PULSE_END_ON_GAP | IR_PULSE_REPEAT_MATCH,
+		.formats = {
+			{ 12, IR_PROTOCOL_SONY_12, 0, 5, 5, 7 },
+			{ 15, IR_PROTOCOL_SONY_15, 0, 8, 8, 7 },
+			{ 20, IR_PROTOCOL_SONY_20, 0, 8, 8, 12 },
+		},
+	},
+	{	/* JVC, http://www.sbprojects.com/knowledge/ir/jvc.htm */
+		.unit = 525, .gap = 22, .header_mark = 16, .header_space = 8,
+		.coding = IR_PULSE_DISTANCE, .zero = 1, .one = 3, .other = 1,
+		.flags = IR_PULSE_REPEAT_MATCH | IR_PULSE_HEADERLESS_REPEAT,
+		.formats = {
+			{ 16, IR_PROTOCOL_JVC, 8, 8, 0, 8 },
+		},
+	},
+	{	/* NEC, http://www.sbprojects.com/knowledge/ir/nec.htm */
+		.unit = 560, .gap = 22, .header_mark = 16, .header_space = 8,
+		.coding = IR_PULSE_DISTANCE, .zero = 1, .one = 3, .other = 1,
+		.formats = {
+			{ 32, IR_PROTOCOL_NEC, 16, 16, 0, 16 },
+		},
+	},
+};
+
+static void ir_pulse_frame(struct input_dev *dev,
+			   const struct ir_pulse_protocol *proto,
+			   struct ir_protocol *p, unsigned int bits)
+{
+	const struct ir_pulse_format *fmt;
+
+	for (fmt = proto->formats;
+	     fmt < proto->formats + IR_PULSE_MAX_FORMATS && fmt->bits; fmt++) {
+		if (fmt->bits != bits)
+			continue;
+
+		if ((proto->flags & IR_PULSE_REPEAT_MATCH) &&
+		    !(p->good && p->good == p->code)) {
+			PDEBUG("IR - Saving %d bit %05x\n", bits, p->code);
+			p->good = p->code;
+			return;
+		}
+		p->good = 0;
+		input_ir_translate(dev, fmt->protocol,
+			(p->code >> fmt->device_shift) &
+				((1 << fmt->device_bits) - 1),
+			(p->code >> fmt->command_shift) &
+				((1 << fmt->command_bits) - 1));
+		return;
+	}
+}
+
+static void ir_pulse_decode(struct input_dev *dev,
+			    const struct ir_pulse_protocol *proto,
+			    struct ir_protocol *p, unsigned int d,
+			    unsigned int bit)
+{
+	unsigned int units, value;
+
+	/* A long space ends any frame and may start a new one */
+	if (bit == 0 && d + proto->unit / 2 >= (proto->gap + 1) * proto->unit) {
+		if ((proto->flags & IR_PULSE_END_ON_GAP) &&
+		    p->state >= 4 && !(p->state & 1))
+			ir_pulse_frame(dev, proto, p, (p->state - 2) / 2);
+		p->state = 1;
+		p->code = 0;
+		return;
+	}
+	if (p->state == 0)
+		return;
+
+	units = (d + proto->unit / 2) / proto->unit;
+
+	if (p->state == 1) {
+		if (bit == 1 && units == proto->header_mark) {
+			p->state = 2;
+			return;
+		}
+		/* Protocols repeating frames without a header go straight
+		 * to the data once a first frame has been seen */
+		if (!(proto->flags & IR_PULSE_HEADERLESS_REPEAT) || !p->good)
+			goto reject;
+		p->state = 3;
+	} else if (p->state == 2) {
+		if (bit == 0 && units == proto->header_space) {
+			p->state = 3;
+			return;
+		}
+		goto reject;
+	}
+
+	/* Odd states expect a mark, even ones a space */
+	if (bit != (p->state & 1))
+		goto reject;
+
+	if ((proto->coding == IR_PULSE_WIDTH) == (bit == 1)) {
+		if (units == proto->zero)
+			value = 0;
+		else if (units == proto->one)
+			value = 1;
+		else
+			goto reject;
+		if ((p->state - 3) / 2 >= 32)
+			goto reject;
+		p->code |= value << ((p->state - 3) / 2);
+	} else if (units != proto->other)
+		goto reject;
+
+	p->state++;
+
+	/* Fixed length frames end with the mark following the last bit */
+	if (!(proto->flags & IR_PULSE_END_ON_GAP) &&
+	    p->state == 4 + 2 * proto->formats[0].bits) {
+		ir_pulse_frame(dev, proto, p, proto->formats[0].bits);
+		p->state = 0;
+		p->code = 0;
+	}
+	return;
+
+reject:
+	p->state = 0;
+	p->code = 0;
+}
+
 static void record_raw(struct input_dev *dev, int sample)
 {
 	int head = dev->ir->raw.head;
@@ -431,7 +397,8 @@ static void record_raw(struct input_dev *dev, int sample)
 
 void input_ir_decode(struct input_dev *dev, int sample)
 {
-	int delta, bit;
+	struct ir_device *ir = dev->ir;
+	int i, delta, bit;
 
 	record_raw(dev, sample);
 
@@ -444,48 +411,38 @@ void input_ir_decode(struct input_dev *dev, int sample)
 	}
 	PDEBUG("IR bit %d %d\n", delta, bit);
 
-	decode_sony(dev, &dev->ir->sony, delta, bit);
-	decode_jvc(dev, &dev->ir->jvc, delta, bit);
-	decode_nec(dev, &dev->ir->nec, delta, bit);
-	decode_rc5(dev, &dev->ir->rc5, delta, bit);
-	decode_rc6(dev, &dev->ir->rc6, delta, bit);
+	for (i = 0; i < ARRAY_SIZE(ir_pulse_protocols); i++)
+		ir_pulse_decode(dev, &ir_pulse_protocols[i], &ir->pulse[i],
+				delta, bit);
+
+	/* RC-6 is bi-phase coded and doesn't fit the table */
+	if (ir->rc6.state || (bit == 0 && delta > 19 * 444))
+		decode_rc6(dev, &ir->rc6, delta, bit);
 }
 EXPORT_SYMBOL_GPL(input_ir_decode);
 
+#define IR_EVENT_BATCH	16
+
 static void ir_event(struct work_struct *work)
 {
-	unsigned long flags;
-	unsigned int sample;
 	struct ir_device *ir_dev = container_of(work, struct ir_device, work);
-	struct input_dev *dev = ir_dev->input;
-
-	while (1) {
-		spin_lock_irqsave(dev->ir->queue.lock, flags);
-		if (dev->ir->queue.tail == dev->ir->queue.head) {
-			spin_unlock_irqrestore(dev->ir->queue.lock, flags);
-			break;
-		}
-		sample = dev->ir->queue.samples[dev->ir->queue.tail];
+	int samples[IR_EVENT_BATCH];
+	unsigned int i, len;
 
-		dev->ir->queue.tail++;
-		if (dev->ir->queue.tail >= MAX_SAMPLES)
-			dev->ir->queue.tail = 0;
-
-		spin_unlock_irqrestore(dev->ir->queue.lock, flags);
-
-		input_ir_decode(dev->ir->input, sample);
+	/* Single consumer; the driver feeding input_ir_queue() is the only
+	 * producer, so the fifo needs no lock */
+	while ((len = __kfifo_get(ir_dev->queue, (unsigned char *)samples,
+				  sizeof(samples))) != 0) {
+		for (i = 0; i < len / sizeof(samples[0]); i++)
+			input_ir_decode(ir_dev->input, samples[i]);
 	}
 }
 
 void input_ir_queue(struct input_dev *dev, int sample)
 {
-	unsigned int next;
-
-	spin_lock(dev->ir->queue.lock);
-	dev->ir->queue.samples[dev->ir->queue.head] = sample;
-	next = dev->ir->queue.head + 1;
-	dev->ir->queue.head = (next >= MAX_SAMPLES ? 0 : next);
-	spin_unlock(dev->ir->queue.lock);
+	/* Samples are dropped when the decoder falls too far behind; the
+	 * protocols resynchronise on the next gap */
+	__kfifo_put(dev->ir->queue, (unsigned char *)&sample, sizeof(sample));
 
 	schedule_work(&dev->ir->work);
 }
@@ -686,9 +643,20 @@ int input_ir_register(struct input_dev *dev)
 
 	return sysfs_create_group(&dev->dev.kobj, &input_ir_group);
 }
+EXPORT_SYMBOL_GPL(input_ir_register);
+
+/* Undoes input_ir_register(), before input_unregister_device() */
+void input_ir_unregister(struct input_dev *dev)
+{
+	if (dev->ir)
+		sysfs_remove_group(&dev->dev.kobj, &input_ir_group);
+}
+EXPORT_SYMBOL_GPL(input_ir_unregister);
 
 int input_ir_create(struct input_dev *dev, void *private, send_func xmit)
 {
+	BUILD_BUG_ON(ARRAY_SIZE(ir_pulse_protocols) != IR_PULSE_PROTOCOLS);
+
 	dev->ir = kzalloc(sizeof(struct ir_device), GFP_KERNEL);
 	if (!dev->ir)
 		return -ENOMEM;
@@ -698,7 +666,13 @@ int input_ir_create(struct input_dev *dev, void *private, send_func xmit)
 	dev->ir->xmit = xmit;
 	dev->ir->input = dev;
 
-	spin_lock_init(&dev->ir->queue.lock);
+	dev->ir->queue = kfifo_alloc(MAX_SAMPLES * sizeof(int), GFP_KERNEL,
+				     NULL);
+	if (IS_ERR(dev->ir->queue)) {
+		kfree(dev->ir);
+		dev->ir = NULL;
+		return -ENOMEM;
+	}
 	INIT_WORK(&dev->ir->work, ir_event);
 
 	return 0;
@@ -708,6 +682,8 @@ EXPORT_SYMBOL_GPL(input_ir_create);
 void input_ir_destroy(struct input_dev *dev)
 {
 	if (dev->ir) {
+		cancel_work_sync(&dev->ir->work);
+		kfifo_free(dev->ir->queue);
 		kfree(dev->ir);
 		dev->ir = NULL;
 		sysfs_remove_group(&dev->dev.kobj, &input_ir_group);
@@ -726,5 +702,7 @@ module_init(input_ir_init);
 static void __exit input_ir_exit(void)
 {
 	configfs_unregister_subsystem(&input_ir_remotes);
+	/* Let the keymap_free_rcu() callbacks run before the module goes */
+	rcu_barrier();
 }
 module_exit(input_ir_exit);
@@ -13,41 +13,44 @@
 #include <linux/of_device.h>
 #include <linux/of_platform.h>
 #include <linux/input.h>
-#include <asm/io.h>
+#include <asm/div64.h>
 #include <asm/mpc52xx.h>
 
+/* Pulse widths are reported to the decoders in microseconds */
+#define IR_GPT_RATE		1000000
+#define IR_GPT_DEPTH		64
+
 struct ir_gpt {
 	struct input_dev *input;
-	int irq, previous;
-	struct mpc52xx_gpt __iomem *regs;
+	struct mpc52xx_gpt_priv *gpt;
 };
 
 /*
- * Interrupt handlers
+ * Called from the GPT interrupt once the edge is buffered; the pulse
+ * width was latched by the timer hardware, so interrupt latency only
+ * delays the samples, it doesn't distort them.
  */
-static irqreturn_t dpeak_ir_irq(int irq, void *_ir)
+static void ir_gpt_capture(void *_ir)
 {
 	struct ir_gpt *ir_gpt = _ir;
-	int sample, count, delta, bit, wrap;
-
-	sample = in_be32(&ir_gpt->regs->status);
-	out_be32(&ir_gpt->regs->status, 0xF);
-
-	count = sample >> 16;
-	wrap = (sample >> 12) & 7;
-	bit = (sample >> 8) & 1;
-
-	delta = count - ir_gpt->previous;
-	delta += wrap * 0x10000;
-
-	ir_gpt->previous = count;
-
-	if (bit)
-		delta = -delta;
-
-	input_ir_queue(ir_gpt->input, delta);
-
-	return IRQ_HANDLED;
+	struct mpc52xx_gpt_capture cap;
+	u32 rate = mpc52xx_gpt_capture_rate(ir_gpt->gpt);
+	u64 width;
+	int delta;
+
+	while (!mpc52xx_gpt_read_capture(ir_gpt->gpt, &cap)) {
+		width = cap.ticks;
+		if (rate != IR_GPT_RATE) {
+			width *= IR_GPT_RATE;
+			do_div(width, rate);
+		}
+		delta = min_t(u64, width, INT_MAX);
+
+		if (cap.flags & MPC52xx_GPT_CAPTURE_LEVEL)
+			delta = -delta;
+
+		input_ir_queue(ir_gpt->input, delta);
+	}
 }
 
 
@@ -60,8 +63,8 @@ static int __devinit ir_gpt_of_probe(struct of_device *op,
 				      const struct of_device_id *match)
 {
 	struct ir_gpt *ir_gpt;
-	struct resource res;
-	int ret, rc;
+	struct device_node *np;
+	int ret;
 
 	dev_dbg(&op->dev, "ir_gpt_of_probe\n");
 
@@ -92,37 +95,37 @@ static int __devinit ir_gpt_of_probe(struct of_device *op,
 		goto free_input;
 	ret = input_ir_register(ir_gpt->input);
 	if (ret)
-		goto free_input;
-
-	/* Fetch the registers and IRQ of the GPT */
-	if (of_address_to_resource(op->node, 0, &res)) {
-		dev_err(&op->dev, "Missing reg property\n");
+		goto unregister_input;
+
+	/*
+	 * Claim the GPT the receiver is wired to.  It is only found once the
+	 * mpc52xx-gpt driver has bound to it, which happens first as long as
+	 * that driver is built in and the GPT node comes before ours.
+	 */
+	np = of_parse_phandle(op->node, "fsl,gpt", 0);
+	if (!np) {
+		dev_err(&op->dev, "Missing fsl,gpt property\n");
 		ret = -ENODEV;
-		goto free_input;
-	}
-	ir_gpt->regs = ioremap(res.start, 1 + res.end - res.start);
-	if (!ir_gpt->regs) {
-		dev_err(&op->dev, "Could not map registers\n");
-		ret = -ENODEV;
-		goto free_input;
+		goto unregister;
 	}
-	ir_gpt->irq = irq_of_parse_and_map(op->node, 0);
-	if (ir_gpt->irq == NO_IRQ) {
+	ir_gpt->gpt = mpc52xx_gpt_from_node(np);
+	if (!ir_gpt->gpt) {
+		dev_err(&op->dev, "GPT %s has not been probed by the "
+			"mpc52xx-gpt driver yet\n", np->full_name);
+		of_node_put(np);
 		ret = -ENODEV;
-		goto free_input;
+		goto unregister;
 	}
-	dev_dbg(&op->dev, "ir_gpt_of_probe irq=%d\n", ir_gpt->irq);
-
-	rc = request_irq(ir_gpt->irq, &dpeak_ir_irq, IRQF_SHARED,
-			 "gpt-ir", ir_gpt);
-	dev_dbg(&op->dev, "ir_gpt_of_probe request irq rc=%d\n", rc);
+	of_node_put(np);
 
-	/* set prescale to ? */
-	out_be32(&ir_gpt->regs->count, 0x00870000);
-
-	/* Select input capture, enable the counter, and interrupt */
-	out_be32(&ir_gpt->regs->mode, 0x0);
-	out_be32(&ir_gpt->regs->mode, 0x00000501);
+	ret = mpc52xx_gpt_request_capture(ir_gpt->gpt, IR_GPT_RATE,
+					  IR_GPT_DEPTH, ir_gpt_capture, ir_gpt);
+	if (ret) {
+		dev_err(&op->dev, "Could not claim the GPT\n");
+		goto unregister;
+	}
+	dev_dbg(&op->dev, "ir_gpt_of_probe rate=%u\n",
+		mpc52xx_gpt_capture_rate(ir_gpt->gpt));
 
 	/* Save what we've done so it can be found again later */
 	dev_set_drvdata(&op->dev, ir_gpt);
@@ -131,6 +134,12 @@ static int __devinit ir_gpt_of_probe(struct of_device *op,
 
 	return 0;
 
+unregister:
+	input_ir_unregister(ir_gpt->input);
+unregister_input:
+	input_unregister_device(ir_gpt->input);
+	kfree(ir_gpt);
+	return ret;
 free_input:
 	input_free_device(ir_gpt->input);
 free_mem:
@@ -144,6 +153,8 @@ static int __devexit ir_gpt_of_remove(struct of_device *op)
 
 	dev_dbg(&op->dev, "ir_gpt_remove()\n");
 
+	mpc52xx_gpt_free_capture(ir_gpt->gpt);
+	input_ir_unregister(ir_gpt->input);
 	input_unregister_device(ir_gpt->input);
 	kfree(ir_gpt);
 	dev_set_drvdata(&op->dev, NULL);
@@ -5,6 +5,7 @@
  */
 
 #include <linux/configfs.h>
+#include <linux/kfifo.h>
 
 #undef IR_PROTOCOL_DEBUG
 #ifdef IR_PROTOCOL_DEBUG
@@ -19,13 +20,41 @@ struct ir_protocol {
 	unsigned int state, code, good, count, bits, mode;
 };
 
-#define MAX_SAMPLES 200
+/* Description of a pulse width or pulse distance coded protocol; all
+ * timings are in multiples of @unit microseconds */
+enum ir_pulse_coding {
+	IR_PULSE_WIDTH,		/* the mark carries the bit */
+	IR_PULSE_DISTANCE,	/* the space carries the bit */
+};
+
+#define IR_PULSE_END_ON_GAP		0x1	/* length known at the gap */
+#define IR_PULSE_REPEAT_MATCH		0x2	/* report two equal frames */
+#define IR_PULSE_HEADERLESS_REPEAT	0x4	/* repeats have no header */
+
+struct ir_pulse_format {
+	unsigned int bits;
+	int protocol;
+	unsigned int device_shift, device_bits;
+	unsigned int command_shift, command_bits;
+};
+
+#define IR_PULSE_MAX_FORMATS	3
+#define IR_PULSE_PROTOCOLS	3
+
+struct ir_pulse_protocol {
+	unsigned int unit;
+	unsigned int gap;
+	unsigned int header_mark, header_space;
+	enum ir_pulse_coding coding;
+	unsigned int zero, one, other;
+	unsigned int flags;
+	struct ir_pulse_format formats[IR_PULSE_MAX_FORMATS];
+};
+
+#define MAX_SAMPLES 256
 
 struct ir_device {
-	struct ir_protocol sony;
-	struct ir_protocol jvc;
-	struct ir_protocol nec;
-	struct ir_protocol rc5;
+	struct ir_protocol pulse[IR_PULSE_PROTOCOLS];
 	struct ir_protocol rc6;
 	struct mutex lock;
 	void *private;
@@ -42,11 +71,7 @@ struct ir_device {
 		unsigned int carrier;
 		unsigned int xmitter;
 	} raw;
-	struct {
-		spinlock_t lock;
-		int head, tail;
-		unsigned int samples[MAX_SAMPLES];
-	} queue;
+	struct kfifo *queue;
 	struct work_struct work;
 };
 
@@ -0,0 +1,331 @@
+/*
+ * Passive parallel FPGA configuration over GPIO lines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Loads a bitstream into an FPGA wired for passive parallel synchronous
+ * configuration (Altera PPS, or the equivalent slave parallel modes of
+ * other vendors): eight data lines sampled on the rising edge of DCLK,
+ * plus the nCONFIG, nSTATUS and CONF_DONE handshake lines.
+ *
+ * The data lines must be consecutive GPIOs of one controller, so that a
+ * whole byte goes out with a single gpio_set_port() call.  On the MPC5200
+ * that is one register write instead of eight read-modify-write cycles.
+ *
+ * Writing a firmware file name to the "load" attribute configures the
+ * FPGA, e.g.  echo design.rbf > /sys/devices/.../load
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/firmware.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/gpio.h>
+#include <linux/of_gpio.h>
+#include <linux/of_platform.h>
+
+#define DRV_NAME "gpio-fpga"
+
+/* Order of the lines in the "gpios" property */
+enum {
+	GPIO_FPGA_NCONFIG,
+	GPIO_FPGA_NSTATUS,
+	GPIO_FPGA_CONF_DONE,
+	GPIO_FPGA_DCLK,
+	GPIO_FPGA_DATA0,
+	GPIO_FPGA_NUM_LINES,
+};
+
+#define GPIO_FPGA_DATA_LINES	8
+
+/* How often the FPGA's nSTATUS is checked while sending data */
+#define GPIO_FPGA_CHECK_BYTES	4096
+
+struct gpio_fpga {
+	struct device *dev;
+	struct mutex lock;	/* serialises configuration cycles */
+	int gpio[GPIO_FPGA_NUM_LINES];
+	unsigned int init_clocks;
+};
+
+static int gpio_fpga_wait(struct gpio_fpga *fpga, int line, int value)
+{
+	int i;
+
+	/* Data sheets give worst cases of a few hundred microseconds */
+	for (i = 0; i < 1000; i++) {
+		if (!gpio_get_value_cansleep(fpga->gpio[line]) == !value)
+			return 0;
+		udelay(1);
+	}
+	return -ETIMEDOUT;
+}
+
+static void gpio_fpga_clock(struct gpio_fpga *fpga)
+{
+	gpio_set_value_cansleep(fpga->gpio[GPIO_FPGA_DCLK], 1);
+	gpio_set_value_cansleep(fpga->gpio[GPIO_FPGA_DCLK], 0);
+}
+
+static int gpio_fpga_program(struct gpio_fpga *fpga, const u8 *data,
+			     size_t size)
+{
+	int data0 = fpga->gpio[GPIO_FPGA_DATA0];
+	int nstatus = fpga->gpio[GPIO_FPGA_NSTATUS];
+	unsigned int i;
+	size_t pos;
+	int err;
+
+	/* Pulse nCONFIG to clear the device and wait for it to be ready */
+	gpio_set_value_cansleep(fpga->gpio[GPIO_FPGA_DCLK], 0);
+	gpio_set_value_cansleep(fpga->gpio[GPIO_FPGA_NCONFIG], 0);
+	err = gpio_fpga_wait(fpga, GPIO_FPGA_NSTATUS, 0);
+	if (err) {
+		dev_err(fpga->dev, "FPGA does not enter reset\n");
+		goto out;
+	}
+	udelay(2);
+	gpio_set_value_cansleep(fpga->gpio[GPIO_FPGA_NCONFIG], 1);
+	err = gpio_fpga_wait(fpga, GPIO_FPGA_NSTATUS, 1);
+	if (err) {
+		dev_err(fpga->dev, "FPGA does not leave reset\n");
+		goto out;
+	}
+	udelay(2);
+
+	for (pos = 0; pos < size; pos++) {
+		gpio_set_port(data0, 0xff, data[pos]);
+		gpio_fpga_clock(fpga);
+
+		if ((pos + 1) % GPIO_FPGA_CHECK_BYTES)
+			continue;
+		if (!gpio_get_value_cansleep(nstatus)) {
+			dev_err(fpga->dev, "configuration error at byte %zu\n",
+				pos);
+			err = -EIO;
+			goto out;
+		}
+		cond_resched();
+	}
+
+	if (!gpio_get_value_cansleep(fpga->gpio[GPIO_FPGA_CONF_DONE])) {
+		dev_err(fpga->dev, "CONF_DONE not set after %zu bytes\n",
+			size);
+		err = -EIO;
+		goto out;
+	}
+
+	/* Clock the FPGA through its initialisation */
+	for (i = 0; i < fpga->init_clocks; i++)
+		gpio_fpga_clock(fpga);
+
+	dev_info(fpga->dev, "configured with %zu bytes\n", size);
+
+ out:
+	gpio_set_port(data0, 0xff, 0);
+	return err;
+}
+
+static ssize_t gpio_fpga_load_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct gpio_fpga *fpga = dev_get_drvdata(dev);
+	const struct firmware *fw;
+	char name[64];
+	int err;
+
+	if (!count || count >= sizeof(name))
+		return -EINVAL;
+	strlcpy(name, buf, sizeof(name));
+
+	err = request_firmware(&fw, strstrip(name), dev);
+	if (err)
+		return err;
+
+	mutex_lock(&fpga->lock);
+	err = gpio_fpga_program(fpga, fw->data, fw->size);
+	mutex_unlock(&fpga->lock);
+
+	release_firmware(fw);
+
+	return err ? err : count;
+}
+
+static ssize_t gpio_fpga_done_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct gpio_fpga *fpga = dev_get_drvdata(dev);
+	int done = gpio_get_value_cansleep(fpga->gpio[GPIO_FPGA_CONF_DONE]);
+
+	return sprintf(buf, "%d\n", !!done);
+}
+
+static DEVICE_ATTR(load, S_IWUSR, NULL, gpio_fpga_load_store);
+static DEVICE_ATTR(done, S_IRUGO, gpio_fpga_done_show, NULL);
+
+static struct attribute *gpio_fpga_attrs[] = {
+	&dev_attr_load.attr,
+	&dev_attr_done.attr,
+	NULL
+};
+
+static const struct attribute_group gpio_fpga_attr_group = {
+	.attrs = gpio_fpga_attrs,
+};
+
+static void gpio_fpga_free_gpios(struct gpio_fpga *fpga, int n)
+{
+	int i;
+
+	for (i = n - 1; i >= 0; i--)
+		gpio_free(fpga->gpio[i]);
+}
+
+static void gpio_fpga_free_all_gpios(struct gpio_fpga *fpga)
+{
+	int i;
+
+	for (i = 1; i < GPIO_FPGA_DATA_LINES; i++)
+		gpio_free(fpga->gpio[GPIO_FPGA_DATA0] + i);
+	gpio_fpga_free_gpios(fpga, GPIO_FPGA_NUM_LINES);
+}
+
+static int __devinit gpio_fpga_request_gpios(struct gpio_fpga *fpga,
+					     struct device_node *np)
+{
+	static const char *labels[GPIO_FPGA_NUM_LINES] = {
+		"fpga-nconfig", "fpga-nstatus", "fpga-conf-done",
+		"fpga-dclk", "fpga-data",
+	};
+	int i, n = 0, err;
+
+	for (i = 0; i < GPIO_FPGA_NUM_LINES; i++) {
+		fpga->gpio[i] = of_get_gpio(np, i);
+		if (!gpio_is_valid(fpga->gpio[i])) {
+			dev_err(fpga->dev, "invalid gpio #%d\n", i);
+			err = -EINVAL;
+			goto err;
+		}
+		err = gpio_request(fpga->gpio[i], labels[i]);
+		if (err)
+			goto err;
+		n++;
+	}
+
+	/* The remaining data lines follow DATA0, on the same chip */
+	if (!gpio_port_valid(fpga->gpio[GPIO_FPGA_DATA0], 0xff)) {
+		dev_err(fpga->dev, "data lines are not on one gpio chip\n");
+		err = -EINVAL;
+		goto err;
+	}
+	for (i = 1; i < GPIO_FPGA_DATA_LINES; i++) {
+		err = gpio_request(fpga->gpio[GPIO_FPGA_DATA0] + i,
+				   labels[GPIO_FPGA_DATA0]);
+		if (err)
+			goto err_data;
+		gpio_direction_output(fpga->gpio[GPIO_FPGA_DATA0] + i, 0);
+	}
+
+	gpio_direction_output(fpga->gpio[GPIO_FPGA_NCONFIG], 1);
+	gpio_direction_input(fpga->gpio[GPIO_FPGA_NSTATUS]);
+	gpio_direction_input(fpga->gpio[GPIO_FPGA_CONF_DONE]);
+	gpio_direction_output(fpga->gpio[GPIO_FPGA_DCLK], 0);
+	gpio_direction_output(fpga->gpio[GPIO_FPGA_DATA0], 0);
+
+	return 0;
+
+ err_data:
+	while (--i > 0)
+		gpio_free(fpga->gpio[GPIO_FPGA_DATA0] + i);
+ err:
+	gpio_fpga_free_gpios(fpga, n);
+	return err;
+}
+
+static int __devinit gpio_fpga_probe(struct of_device *op,
+				     const struct of_device_id *match)
+{
+	struct gpio_fpga *fpga;
+	const u32 *prop;
+	int err;
+
+	fpga = kzalloc(sizeof(*fpga), GFP_KERNEL);
+	if (!fpga)
+		return -ENOMEM;
+
+	fpga->dev = &op->dev;
+	mutex_init(&fpga->lock);
+
+	prop = of_get_property(op->node, "init-clocks", NULL);
+	fpga->init_clocks = prop ? *prop : 2;
+
+	err = gpio_fpga_request_gpios(fpga, op->node);
+	if (err)
+		goto err_gpios;
+
+	dev_set_drvdata(&op->dev, fpga);
+
+	err = sysfs_create_group(&op->dev.kobj, &gpio_fpga_attr_group);
+	if (err)
+		goto err_sysfs;
+
+	return 0;
+
+ err_sysfs:
+	dev_set_drvdata(&op->dev, NULL);
+	gpio_fpga_free_all_gpios(fpga);
+ err_gpios:
+	kfree(fpga);
+	return err;
+}
+
+static int __devexit gpio_fpga_remove(struct of_device *op)
+{
+	struct gpio_fpga *fpga = dev_get_drvdata(&op->dev);
+
+	sysfs_remove_group(&op->dev.kobj, &gpio_fpga_attr_group);
+	dev_set_drvdata(&op->dev, NULL);
+
+	gpio_fpga_free_all_gpios(fpga);
+	kfree(fpga);
+
+	return 0;
+}
+
+static const struct of_device_id gpio_fpga_match[] = {
+	{ .compatible = "gpio-fpga-pp", },
+	{},
+};
+MODULE_DEVICE_TABLE(of, gpio_fpga_match);
+
+static struct of_platform_driver gpio_fpga_driver = {
+	.match_table	= gpio_fpga_match,
+	.probe		= gpio_fpga_probe,
+	.remove		= __devexit_p(gpio_fpga_remove),
+	.driver		= {
+		.owner	= THIS_MODULE,
+		.name	= DRV_NAME,
+	},
+};
+
+static int __init gpio_fpga_init(void)
+{
+	return of_register_platform_driver(&gpio_fpga_driver);
+}
+module_init(gpio_fpga_init);
+
+static void __exit gpio_fpga_exit(void)
+{
+	of_unregister_platform_driver(&gpio_fpga_driver);
+}
+module_exit(gpio_fpga_exit);
+
+MODULE_DESCRIPTION("Passive parallel FPGA configuration over GPIOs");
+MODULE_LICENSE("GPL v2");
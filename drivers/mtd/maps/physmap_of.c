@@ -23,11 +23,19 @@
 #include <linux/mtd/concat.h>
 #include <linux/of.h>
 #include <linux/of_platform.h>
+#include <linux/jiffies.h>
+#ifdef CONFIG_MTD_PHYSMAP_OF_LPBFIFO
+#include <asm/mpc52xx.h>
+#endif
 
 struct of_flash_list {
 	struct mtd_info *mtd;
 	struct map_info map;
 	struct resource *res;
+#ifdef CONFIG_MTD_PHYSMAP_OF_LPBFIFO
+	unsigned int lpb_cs;
+	unsigned long lpb_offset;
+#endif
 };
 
 struct of_flash {
@@ -172,6 +180,95 @@ static struct mtd_info * __devinit obsolete_probe(struct of_device *dev,
 	}
 }
 
+#ifdef CONFIG_MTD_PHYSMAP_OF_LPBFIFO
+/* Shorter reads are not worth setting up a FIFO transfer for */
+#define OF_FLASH_LPBFIFO_MIN	512
+
+/*
+ * Bulk reads go through the MPC5200 LocalPlus bus FIFO, which bursts on
+ * the bus instead of stalling the core on every uncached load.  The CFI
+ * chip drivers call this with their chip spinlock held, so we can't sleep
+ * and the transfer is waited for by polling, bounded by a timeout based on
+ * a very conservative 1MB/s.  A transfer that times out is aborted.  It
+ * and anything else the FIFO can't do (unaligned head and tail, buffers
+ * outside lowmem, FIFO errors) is copied by the CPU.
+ */
+static void of_flash_lpbfifo_copy_from(struct map_info *map, void *to,
+				       unsigned long from, ssize_t len)
+{
+	struct of_flash_list *list = container_of(map, struct of_flash_list,
+						  map);
+	struct mpc52xx_lpbfifo_request req;
+	size_t head = 0, body = 0;
+	unsigned long timeout;
+
+	if (len >= OF_FLASH_LPBFIFO_MIN &&
+	    !(((unsigned long)to ^ from) & 3) && !irqs_disabled()) {
+		head = -from & 3;
+		body = (len - head) & ~3;
+		if (!virt_addr_valid(to + head) ||
+		    !virt_addr_valid(to + head + body - 1))
+			head = body = 0;
+	}
+
+	if (body) {
+		memset(&req, 0, sizeof(req));
+		req.cs = list->lpb_cs;
+		req.offset = list->lpb_offset + from + head;
+		req.data = to + head;
+		req.size = body;
+		req.flags = MPC52xx_LPBFIFO_FLAG_READ;
+
+		timeout = jiffies + msecs_to_jiffies(10 + body / 1024);
+		if (mpc52xx_lpbfifo_submit(&req) == 0) {
+			while (req.status == -EINPROGRESS &&
+			       time_before(jiffies, timeout))
+				cpu_relax();
+			if (req.status == -EINPROGRESS &&
+			    mpc52xx_lpbfifo_abort(&req) == 0)
+				printk(KERN_WARNING "%s: LPB FIFO read timed "
+				       "out, reading by CPU\n", map->name);
+			if (req.status == 0) {
+				memcpy_fromio(to, map->virt + from, head);
+				from += head + body;
+				to += head + body;
+				len -= head + body;
+			}
+		}
+	}
+
+	memcpy_fromio(to, map->virt + from, len);
+}
+
+/*
+ * Flash nodes with the 'fsl,lpbfifo' property get their bulk reads done by
+ * the FIFO.  The FIFO addresses the bus by chip select and offset, which
+ * is what the first two cells of a LocalPlus bus 'reg' entry hold.
+ */
+static void __devinit of_flash_lpbfifo_setup(struct device_node *dp,
+					     struct of_flash_list *list,
+					     int index)
+{
+	const u32 *reg;
+
+	if (!of_get_property(dp, "fsl,lpbfifo", NULL))
+		return;
+
+	reg = of_get_property(dp, "reg", NULL);
+	if (!reg || of_n_addr_cells(dp) != 2)
+		return;
+
+	reg += index * (2 + of_n_size_cells(dp));
+	list->lpb_cs = reg[0];
+	list->lpb_offset = reg[1];
+	list->map.copy_from = of_flash_lpbfifo_copy_from;
+}
+#else
+static inline void of_flash_lpbfifo_setup(struct device_node *dp,
+					  struct of_flash_list *list,
+					  int index) { }
+#endif /* CONFIG_MTD_PHYSMAP_OF_LPBFIFO */
+
 static int __devinit of_flash_probe(struct of_device *dev,
 				    const struct of_device_id *match)
 {
@@ -262,6 +359,7 @@ static int __devinit of_flash_probe(struct of_device *dev,
 		}
 
 		simple_map_init(&info->list[i].map);
+		of_flash_lpbfifo_setup(dp, &info->list[i], i);
 
 		if (probe_type) {
 			info->list[i].mtd = do_map_probe(probe_type,
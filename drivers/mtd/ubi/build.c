@@ -121,6 +121,14 @@ static struct device_attribute dev_bgt_enabled =
 	__ATTR(bgt_enabled, S_IRUGO, dev_attribute_show, NULL);
 static struct device_attribute dev_mtd_num =
 	__ATTR(mtd_num, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_free_peb_count =
+	__ATTR(free_peb_count, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_erase_queue_len =
+	__ATTR(erase_queue_len, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_erase_queue_max =
+	__ATTR(erase_queue_max, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_erase_inflight =
+	__ATTR(erase_inflight, S_IRUGO, dev_attribute_show, NULL);
 
 /**
  * ubi_volume_notify - send a volume change notification.
@@ -345,6 +353,14 @@ static ssize_t dev_attribute_show(struct device *dev,
 		ret = sprintf(buf, "%d\n", ubi->thread_enabled);
 	else if (attr == &dev_mtd_num)
 		ret = sprintf(buf, "%d\n", ubi->mtd->index);
+	else if (attr == &dev_free_peb_count)
+		ret = sprintf(buf, "%d\n", ubi->free_count);
+	else if (attr == &dev_erase_queue_len)
+		ret = sprintf(buf, "%d\n", ubi->erase_pending);
+	else if (attr == &dev_erase_queue_max)
+		ret = sprintf(buf, "%d\n", ubi->erase_pending_max);
+	else if (attr == &dev_erase_inflight)
+		ret = sprintf(buf, "%d\n", ubi->erase_inflight);
 	else
 		ret = -EINVAL;
 
@@ -409,6 +425,18 @@ static int ubi_sysfs_init(struct ubi_device *ubi)
 	if (err)
 		return err;
 	err = device_create_file(&ubi->dev, &dev_mtd_num);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_free_peb_count);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_erase_queue_len);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_erase_queue_max);
+	if (err)
+		return err;
+	err = device_create_file(&ubi->dev, &dev_erase_inflight);
 	return err;
 }
 
@@ -418,6 +446,10 @@ static int ubi_sysfs_init(struct ubi_device *ubi)
  */
 static void ubi_sysfs_close(struct ubi_device *ubi)
 {
+	device_remove_file(&ubi->dev, &dev_erase_inflight);
+	device_remove_file(&ubi->dev, &dev_erase_queue_max);
+	device_remove_file(&ubi->dev, &dev_erase_queue_len);
+	device_remove_file(&ubi->dev, &dev_free_peb_count);
 	device_remove_file(&ubi->dev, &dev_mtd_num);
 	device_remove_file(&ubi->dev, &dev_bgt_enabled);
 	device_remove_file(&ubi->dev, &dev_min_io_size);
@@ -598,6 +630,7 @@ static int attach_by_scanning(struct ubi_device *ubi)
 	if (err)
 		goto out_wl;
 
+	ubi_ckpt_init(ubi);
 	ubi_scan_destroy_si(si);
 	return 0;
 
@@ -828,13 +861,40 @@ static int autoresize(struct ubi_device *ubi, int vol_id)
 	return 0;
 }
 
+/**
+ * stop_bg_threads - stop the background and erase threads.
+ * @ubi: UBI device description object
+ *
+ * The erase threads are removed from @ubi->ers_threads under @ubi->wl_lock
+ * before they are stopped, so that nobody wakes them up afterwards.
+ */
+static void stop_bg_threads(struct ubi_device *ubi)
+{
+	int i;
+
+	for (i = 0; i < UBI_ERASE_THREADS; i++) {
+		struct task_struct *thread;
+
+		spin_lock(&ubi->wl_lock);
+		thread = ubi->ers_threads[i];
+		ubi->ers_threads[i] = NULL;
+		spin_unlock(&ubi->wl_lock);
+
+		if (thread)
+			kthread_stop(thread);
+	}
+
+	if (ubi->bgt_thread)
+		kthread_stop(ubi->bgt_thread);
+}
+
 /**
  * ubi_reboot_notifier - halt UBI transactions immediately prior to a reboot.
  * @n: reboot notifier object
  * @state: SYS_RESTART, SYS_HALT, or SYS_POWER_OFF
  * @cmd: pointer to command string for RESTART2
  *
- * This function stops the UBI background thread so that the flash device
+ * This function stops the UBI background threads so that the flash device
  * remains quiescent when Linux restarts the system. Any queued work will be
  * discarded, but this function will block until do_work() finishes if an
  * operation is already in progress.
@@ -850,8 +910,8 @@ static int ubi_reboot_notifier(struct notifier_block *n, unsigned long state,
 	struct ubi_device *ubi;
 
 	ubi = container_of(n, struct ubi_device, reboot_notifier);
-	if (ubi->bgt_thread)
-		kthread_stop(ubi->bgt_thread);
+	stop_bg_threads(ubi);
+	ubi_ckpt_write(ubi);
 	ubi_sync(ubi->ubi_num);
 	return NOTIFY_DONE;
 }
@@ -986,6 +1046,20 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 		goto out_uif;
 	}
 
+	for (i = 0; i < UBI_ERASE_THREADS; i++) {
+		struct task_struct *thread;
+
+		thread = kthread_create(ubi_erase_thread, ubi,
+					UBI_ERS_NAME_PATTERN, ubi_num, i);
+		if (IS_ERR(thread)) {
+			/* Not fatal, the background thread erases as well */
+			ubi_warn("cannot spawn erase thread %d, error %d", i,
+				 (int)PTR_ERR(thread));
+			break;
+		}
+		ubi->ers_threads[i] = thread;
+	}
+
 	ubi_msg("attached mtd%d to ubi%d", mtd->index, ubi_num);
 	ubi_msg("MTD device name:            \"%s\"", mtd->name);
 	ubi_msg("MTD device size:            %llu MiB", ubi->flash_size >> 20);
@@ -993,6 +1067,7 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	ubi_msg("number of bad PEBs:         %d", ubi->bad_peb_count);
 	ubi_msg("max. allowed volumes:       %d", ubi->vtbl_slots);
 	ubi_msg("wear-leveling threshold:    %d", CONFIG_MTD_UBI_WL_THRESHOLD);
+	ubi_msg("number of erase threads:    %d", i);
 	ubi_msg("number of internal volumes: %d", UBI_INT_VOL_COUNT);
 	ubi_msg("number of user volumes:     %d",
 		ubi->vol_count - UBI_INT_VOL_COUNT);
@@ -1011,6 +1086,9 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	if (!DBG_DISABLE_BGT)
 		ubi->thread_enabled = 1;
 	wake_up_process(ubi->bgt_thread);
+	for (i = 0; i < UBI_ERASE_THREADS; i++)
+		if (ubi->ers_threads[i])
+			wake_up_process(ubi->ers_threads[i]);
 	spin_unlock(&ubi->wl_lock);
 
 	/* Flash device priority is 0 - UBI needs to shut down first */
@@ -1090,8 +1168,10 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 * prevent it from doing anything on this device while we are freeing.
 	 */
 	unregister_reboot_notifier(&ubi->reboot_notifier);
-	if (ubi->bgt_thread)
-		kthread_stop(ubi->bgt_thread);
+	stop_bg_threads(ubi);
+
+	/* Leave a checkpoint behind to speed up the next attach */
+	ubi_ckpt_write(ubi);
 
 	/*
 	 * Get a reference to the device in order to prevent 'dev_release()'
@@ -0,0 +1,501 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * This file contains the code which reads and writes UBI checkpoints.
+ *
+ * Attaching an MTD device normally requires reading the EC and VID headers of
+ * every physical eraseblock, which takes long on large flashes. A checkpoint
+ * is a snapshot of the state of all physical eraseblocks, stored in one
+ * physical eraseblock of the internal checkpoint volume. When it is found at
+ * attach time, only the physical eraseblocks which may have changed since the
+ * checkpoint was taken are scanned, the rest is taken from the checkpoint.
+ *
+ * This only works if nothing the checkpoint records changes behind its back.
+ * So while the checkpoint is valid, the WL sub-system hands out only the
+ * physical eraseblocks of a small pool, which the checkpoint records as
+ * "scan", and holds back erasures of physical eraseblocks. When the pool is
+ * used up or the held back erasures are needed, the checkpoint is erased and
+ * the background thread writes a new one. The checkpoint volume is erased at
+ * attach time as well, so there is never a stale checkpoint on the flash.
+ *
+ * To be found without scanning, the checkpoint has to be in one of the first
+ * %UBI_CKPT_MAX_START physical eraseblocks. If there is no checkpoint, or it
+ * is damaged, the whole flash is scanned.
+ *
+ * The checkpoint volume is "delete"-compatible, so older UBI implementations
+ * just erase it.
+ */
+
+#include <linux/slab.h>
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include "ubi.h"
+
+/* Volume record index of used PEBs whose volume is not known (yet) */
+#define CKPT_NO_VOL 0xFF
+
+/**
+ * ckpt_size - get maximum size of the checkpoint.
+ * @ubi: UBI device description object
+ */
+static int ckpt_size(const struct ubi_device *ubi)
+{
+	return sizeof(struct ubi_ckpt_hdr) +
+	       ubi->peb_count * sizeof(struct ubi_ckpt_peb) +
+	       (ubi->vtbl_slots + UBI_INT_VOL_COUNT) *
+	       sizeof(struct ubi_ckpt_vol);
+}
+
+/**
+ * ubi_ckpt_init - initialize checkpoints of an UBI device.
+ * @ubi: UBI device description object
+ *
+ * This function reserves a physical eraseblock for the checkpoint and asks the
+ * background thread to write one. Checkpoints are not used if they do not fit
+ * the device.
+ */
+void ubi_ckpt_init(struct ubi_device *ubi)
+{
+	int pool_size;
+
+	if (ALIGN(ckpt_size(ubi), ubi->min_io_size) > ubi->leb_size) {
+		ubi_warn("checkpoint does not fit one LEB, not using it");
+		return;
+	}
+
+	/* Checkpoint records store LEB numbers in 16 bits */
+	if (ubi->peb_count > 1 << 16) {
+		ubi_warn("too many PEBs for checkpoints");
+		return;
+	}
+
+	if (ubi->avail_pebs < 1) {
+		ubi_warn("no PEB for checkpoints");
+		return;
+	}
+	ubi->avail_pebs -= 1;
+	ubi->rsvd_pebs += 1;
+
+	pool_size = ubi->peb_count >> UBI_CKPT_POOL_SHIFT;
+	ubi->ckpt_pool_size = clamp(pool_size, UBI_CKPT_POOL_MIN,
+				    UBI_CKPT_POOL_MAX);
+	ubi->ckpt_enabled = 1;
+	ubi->ckpt_needed = 1;
+}
+
+/**
+ * validate_ckpt - check that checkpoint records make sense.
+ * @ubi: UBI device description object
+ * @ci: the checkpoint
+ *
+ * This function returns zero if the records are fine and %-EINVAL if not.
+ */
+static int validate_ckpt(const struct ubi_device *ubi,
+			 const struct ubi_ckpt_info *ci)
+{
+	int i;
+
+	for (i = 0; i < ci->vol_count; i++) {
+		const struct ubi_ckpt_vol *vr = &ci->vols[i];
+		int vol_id = be32_to_cpu(vr->vol_id);
+
+		if ((vol_id >= UBI_MAX_VOLUMES &&
+		     vol_id != UBI_LAYOUT_VOLUME_ID) ||
+		    (vr->vol_type != UBI_VID_DYNAMIC &&
+		     vr->vol_type != UBI_VID_STATIC) ||
+		    be32_to_cpu(vr->data_pad) >= ubi->leb_size) {
+			ubi_err("bad volume record %d", i);
+			return -EINVAL;
+		}
+	}
+
+	for (i = 0; i < ubi->peb_count; i++) {
+		const struct ubi_ckpt_peb *rec = &ci->pebs[i];
+
+		if (rec->state > UBI_CKPT_PEB_ERASE ||
+		    be32_to_cpu(rec->ec) > UBI_MAX_ERASECOUNTER ||
+		    (rec->state == UBI_CKPT_PEB_USED &&
+		     rec->vol_idx >= ci->vol_count) ||
+		    (i == ci->pnum && rec->state != UBI_CKPT_PEB_SCAN)) {
+			ubi_err("bad record of PEB %d", i);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * read_ckpt - read the checkpoint from a physical eraseblock.
+ * @ubi: UBI device description object
+ * @ci: checkpoint information to fill
+ *
+ * This function reads the checkpoint stored in @ci->pnum and checks it.
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+static int read_ckpt(struct ubi_device *ubi, struct ubi_ckpt_info *ci)
+{
+	int err, size, data_size, vol_count;
+	struct ubi_ckpt_hdr *hdr;
+	uint32_t crc;
+
+	hdr = kmalloc(sizeof(struct ubi_ckpt_hdr), GFP_KERNEL);
+	if (!hdr)
+		return -ENOMEM;
+
+	err = ubi_io_read_data(ubi, hdr, ci->pnum, 0, sizeof(*hdr));
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out;
+
+	err = -EINVAL;
+	if (be32_to_cpu(hdr->magic) != UBI_CKPT_HDR_MAGIC ||
+	    hdr->version != UBI_CKPT_VERSION) {
+		ubi_err("bad checkpoint header in PEB %d", ci->pnum);
+		goto out;
+	}
+
+	crc = crc32(UBI_CRC32_INIT, hdr, UBI_CKPT_HDR_SIZE_CRC);
+	if (crc != be32_to_cpu(hdr->hdr_crc)) {
+		ubi_err("bad checkpoint header CRC in PEB %d", ci->pnum);
+		goto out;
+	}
+
+	vol_count = be32_to_cpu(hdr->vol_count);
+	data_size = be32_to_cpu(hdr->data_size);
+	if (be32_to_cpu(hdr->peb_count) != ubi->peb_count ||
+	    vol_count < 0 || vol_count > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT ||
+	    data_size != ubi->peb_count * sizeof(struct ubi_ckpt_peb) +
+			 vol_count * sizeof(struct ubi_ckpt_vol)) {
+		ubi_err("checkpoint in PEB %d does not match the device",
+			ci->pnum);
+		goto out;
+	}
+
+	size = sizeof(struct ubi_ckpt_hdr) + data_size;
+	if (size > ubi->leb_size) {
+		ubi_err("too large checkpoint in PEB %d", ci->pnum);
+		goto out;
+	}
+
+	crc = be32_to_cpu(hdr->data_crc);
+	ci->image_seq = be32_to_cpu(hdr->image_seq);
+	ci->vol_count = vol_count;
+
+	err = -ENOMEM;
+	ci->buf = vmalloc(size);
+	if (!ci->buf)
+		goto out;
+
+	err = ubi_io_read_data(ubi, ci->buf, ci->pnum, 0, size);
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out;
+
+	ci->pebs = ci->buf + sizeof(struct ubi_ckpt_hdr);
+	ci->vols = (void *)(ci->pebs + ubi->peb_count);
+
+	if (crc != crc32(UBI_CRC32_INIT, ci->pebs, data_size)) {
+		ubi_err("bad checkpoint data CRC in PEB %d", ci->pnum);
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = validate_ckpt(ubi, ci);
+
+out:
+	kfree(hdr);
+	return err;
+}
+
+/**
+ * ubi_ckpt_read - find and read the checkpoint.
+ * @ubi: UBI device description object
+ *
+ * This function looks for the checkpoint in the first %UBI_CKPT_MAX_START
+ * physical eraseblocks. Returns the checkpoint if there is exactly one and it
+ * is fine, and %NULL in all other cases. The caller has to scan the whole
+ * flash then, which also deals with whatever went wrong here.
+ */
+struct ubi_ckpt_info *ubi_ckpt_read(struct ubi_device *ubi)
+{
+	int err, pnum, count = min(ubi->peb_count, UBI_CKPT_MAX_START);
+	unsigned long long *sqnums;
+	struct ubi_ckpt_info *ci;
+	struct ubi_ec_hdr *ec_hdr;
+	struct ubi_vid_hdr *vid_hdr;
+
+	ci = kzalloc(sizeof(struct ubi_ckpt_info), GFP_KERNEL);
+	sqnums = kcalloc(count, sizeof(unsigned long long), GFP_KERNEL);
+	ec_hdr = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!ci || !sqnums || !ec_hdr || !vid_hdr)
+		goto out_free;
+
+	ci->pnum = -1;
+	for (pnum = 0; pnum < count; pnum++) {
+		int ec_err;
+
+		cond_resched();
+
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			goto out_free;
+		else if (err)
+			continue;
+
+		ec_err = ubi_io_read_ec_hdr(ubi, pnum, ec_hdr, 0);
+		if (ec_err < 0)
+			goto out_free;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err < 0)
+			goto out_free;
+		else if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		sqnums[pnum] = be64_to_cpu(vid_hdr->sqnum);
+		if (be32_to_cpu(vid_hdr->vol_id) != UBI_CKPT_VOLUME_ID)
+			continue;
+
+		if (ci->pnum != -1) {
+			ubi_warn("checkpoints in PEBs %d and %d",
+				 ci->pnum, pnum);
+			goto out_free;
+		}
+		if (ec_err && ec_err != UBI_IO_BITFLIPS) {
+			ubi_warn("bad EC header in checkpoint PEB %d", pnum);
+			goto out_free;
+		}
+
+		ci->pnum = pnum;
+		ci->ec = be64_to_cpu(ec_hdr->ec);
+		ci->sqnum = sqnums[pnum];
+	}
+
+	if (ci->pnum == -1) {
+		dbg_gen("no checkpoint found");
+		goto out_free;
+	}
+
+	err = read_ckpt(ubi, ci);
+	if (err)
+		goto out_free;
+
+	/*
+	 * Nothing the checkpoint does not scan may have been written after it.
+	 * UBI never lets this happen, but the headers were read anyway.
+	 */
+	for (pnum = 0; pnum < count; pnum++)
+		if (pnum != ci->pnum && sqnums[pnum] > ci->sqnum &&
+		    ci->pebs[pnum].state != UBI_CKPT_PEB_SCAN) {
+			ubi_warn("stale checkpoint in PEB %d", ci->pnum);
+			goto out_free;
+		}
+
+	dbg_gen("checkpoint in PEB %d, sqnum %llu", ci->pnum, ci->sqnum);
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	kfree(ec_hdr);
+	kfree(sqnums);
+	return ci;
+
+out_free:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	kfree(ec_hdr);
+	kfree(sqnums);
+	ubi_ckpt_free(ci);
+	return NULL;
+}
+
+/**
+ * ubi_ckpt_free - free checkpoint information.
+ * @ci: the checkpoint information to free
+ */
+void ubi_ckpt_free(struct ubi_ckpt_info *ci)
+{
+	if (!ci)
+		return;
+	vfree(ci->buf);
+	kfree(ci);
+}
+
+/**
+ * record_volumes - record which logical eraseblocks used PEBs contain.
+ * @ubi: UBI device description object
+ * @pebs: per physical eraseblock records
+ * @vols: volume records to fill
+ *
+ * This function walks the EBA tables and records the volume and logical
+ * eraseblock of each physical eraseblock which 'ubi_wl_ckpt_prepare()'
+ * recorded as used. Whatever cannot be matched is scanned at attach time.
+ * Returns the number of volume records.
+ */
+static int record_volumes(struct ubi_device *ubi, struct ubi_ckpt_peb *pebs,
+			  struct ubi_ckpt_vol *vols)
+{
+	int i, lnum, pnum, vol_count = 0;
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++)
+		if (pebs[pnum].state == UBI_CKPT_PEB_USED)
+			pebs[pnum].vol_idx = CKPT_NO_VOL;
+
+	spin_lock(&ubi->volumes_lock);
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+		struct ubi_ckpt_vol *vr = &vols[vol_count];
+
+		/* The VID headers of volumes being updated vary, scan them */
+		if (!vol || vol->updating || vol->upd_marker)
+			continue;
+
+		vr->vol_id = cpu_to_be32(vol->vol_id);
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			vr->compat = UBI_LAYOUT_VOLUME_COMPAT;
+		vr->data_pad = cpu_to_be32(vol->data_pad);
+		if (vol->vol_type == UBI_DYNAMIC_VOLUME)
+			vr->vol_type = UBI_VID_DYNAMIC;
+		else {
+			vr->vol_type = UBI_VID_STATIC;
+			vr->used_ebs = cpu_to_be32(vol->used_ebs);
+			vr->last_data_size = cpu_to_be32(vol->last_eb_bytes);
+		}
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			pnum = vol->eba_tbl[lnum];
+			if (pnum < 0)
+				continue;
+
+			if (pebs[pnum].state == UBI_CKPT_PEB_USED &&
+			    pebs[pnum].vol_idx == CKPT_NO_VOL) {
+				pebs[pnum].vol_idx = vol_count;
+				pebs[pnum].lnum = cpu_to_be16(lnum);
+			} else
+				pebs[pnum].state = UBI_CKPT_PEB_SCAN;
+		}
+		vol_count += 1;
+	}
+	spin_unlock(&ubi->volumes_lock);
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++)
+		if (pebs[pnum].state == UBI_CKPT_PEB_USED &&
+		    pebs[pnum].vol_idx == CKPT_NO_VOL) {
+			pebs[pnum].state = UBI_CKPT_PEB_SCAN;
+			pebs[pnum].vol_idx = 0;
+		}
+
+	return vol_count;
+}
+
+/**
+ * ubi_ckpt_write - write a new checkpoint.
+ * @ubi: UBI device description object
+ *
+ * This function invalidates the old checkpoint and writes a new one, if a new
+ * one is needed. It is called by the background thread, and before the device
+ * is detached. Not having enough free physical eraseblocks for the checkpoint
+ * is not an error, the device is just scanned at the next attach then.
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+int ubi_ckpt_write(struct ubi_device *ubi)
+{
+	int err = 0, pnum, vol_count, data_size, size, len;
+	struct ubi_ckpt_hdr *hdr;
+	struct ubi_ckpt_peb *pebs;
+	struct ubi_ckpt_vol *vols;
+	struct ubi_vid_hdr *vid_hdr;
+	void *buf;
+
+	/* Volumes must not be created or removed while they are recorded */
+	mutex_lock(&ubi->device_mutex);
+	mutex_lock(&ubi->ckpt_mutex);
+	if (!ubi->ckpt_needed || !ubi->ckpt_enabled || ubi->ro_mode)
+		goto out_unlock;
+	ubi->ckpt_needed = 0;
+
+	size = ckpt_size(ubi);
+	err = -ENOMEM;
+	buf = vmalloc(ALIGN(size, ubi->min_io_size));
+	if (!buf)
+		goto out_unlock;
+	memset(buf, 0, size);
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		goto out_free;
+
+	hdr = buf;
+	pebs = buf + sizeof(struct ubi_ckpt_hdr);
+	vols = (void *)(pebs + ubi->peb_count);
+
+	pnum = ubi_wl_ckpt_prepare(ubi, pebs);
+	if (pnum < 0) {
+		err = pnum;
+		/*
+		 * 'ubi_wl_ckpt_prepare()' has already warned. Attaching then
+		 * falls back to scanning, which is no reason to count this as
+		 * a failure of the background thread.
+		 */
+		if (err == -ENOSPC)
+			err = 0;
+		goto out_free_vid;
+	}
+
+	vol_count = record_volumes(ubi, pebs, vols);
+	data_size = ubi->peb_count * sizeof(struct ubi_ckpt_peb) +
+		    vol_count * sizeof(struct ubi_ckpt_vol);
+	size = sizeof(struct ubi_ckpt_hdr) + data_size;
+	len = ALIGN(size, ubi->min_io_size);
+	memset(buf + size, 0xFF, len - size);
+
+	hdr->magic = cpu_to_be32(UBI_CKPT_HDR_MAGIC);
+	hdr->version = UBI_CKPT_VERSION;
+	hdr->peb_count = cpu_to_be32(ubi->peb_count);
+	hdr->vol_count = cpu_to_be32(vol_count);
+	hdr->image_seq = cpu_to_be32(ubi->image_seq);
+	hdr->data_size = cpu_to_be32(data_size);
+	hdr->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, pebs, data_size));
+	hdr->hdr_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, hdr,
+					 UBI_CKPT_HDR_SIZE_CRC));
+
+	vid_hdr->vol_type = UBI_CKPT_VOLUME_TYPE;
+	vid_hdr->compat = UBI_CKPT_VOLUME_COMPAT;
+	vid_hdr->vol_id = cpu_to_be32(UBI_CKPT_VOLUME_ID);
+	vid_hdr->lnum = 0;
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+
+	err = ubi_io_write_vid_hdr(ubi, pnum, vid_hdr);
+	if (!err)
+		err = ubi_io_write_data(ubi, buf, pnum, 0, len);
+	if (err) {
+		ubi_err("cannot write checkpoint to PEB %d, error %d, "
+			"checkpoints disabled", pnum, err);
+		ubi->ckpt_enabled = 0;
+		ubi_wl_ckpt_drop(ubi);
+		goto out_free_vid;
+	}
+
+	dbg_gen("checkpoint written to PEB %d, %d volumes", pnum, vol_count);
+
+out_free_vid:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_free:
+	vfree(buf);
+out_unlock:
+	mutex_unlock(&ubi->ckpt_mutex);
+	mutex_unlock(&ubi->device_mutex);
+	return err;
+}
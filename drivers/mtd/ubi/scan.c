@@ -817,6 +817,23 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 	}
 
 	vol_id = be32_to_cpu(vidh->vol_id);
+	if (vol_id == UBI_CKPT_VOLUME_ID && !ec_corr) {
+		/*
+		 * A checkpoint which is not used for this attach. It becomes
+		 * stale as soon as anything is written, so erase it right
+		 * away instead of leaving it to the background thread.
+		 */
+		ubi_msg("erase unused checkpoint in PEB %d", pnum);
+		ec += 1;
+		err = ubi_scan_erase_peb(ubi, si, pnum, ec);
+		if (err)
+			return err;
+		err = add_to_list(si, pnum, ec, &si->free);
+		if (err)
+			return err;
+		goto adjust_mean_ec;
+	}
+
 	if (vol_id > UBI_MAX_VOLUMES && vol_id != UBI_LAYOUT_VOLUME_ID) {
 		int lnum = be32_to_cpu(vidh->lnum);
 
@@ -872,23 +889,18 @@ adjust_mean_ec:
 }
 
 /**
- * ubi_scan - scan an MTD device.
- * @ubi: UBI device description object
+ * alloc_si - allocate and initialize scanning information.
  *
- * This function does full scanning of an MTD device and returns complete
- * information about it. In case of failure, an error code is returned.
+ * This function returns the new scanning information object or %NULL if
+ * there is not enough memory.
  */
-struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+static struct ubi_scan_info *alloc_si(void)
 {
-	int err, pnum;
-	struct rb_node *rb1, *rb2;
-	struct ubi_scan_volume *sv;
-	struct ubi_scan_leb *seb;
 	struct ubi_scan_info *si;
 
 	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
 	if (!si)
-		return ERR_PTR(-ENOMEM);
+		return NULL;
 
 	INIT_LIST_HEAD(&si->corr);
 	INIT_LIST_HEAD(&si->free);
@@ -896,26 +908,224 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	INIT_LIST_HEAD(&si->alien);
 	si->volumes = RB_ROOT;
 	si->is_empty = 1;
+	return si;
+}
+
+/**
+ * add_ckpt_leb - add a logical eraseblock recorded in the checkpoint.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @ci: the checkpoint
+ * @pnum: the physical eraseblock the checkpoint records as used
+ *
+ * The VID header of the physical eraseblock is not read, it is re-created
+ * from the volume record of the checkpoint, except when the logical
+ * eraseblock has also been found by scanning. Then it has been written after
+ * the checkpoint was taken, and the real headers have to decide which copy is
+ * newer. Returns zero in case of success and a negative error code in case
+ * of failure.
+ */
+static int add_ckpt_leb(struct ubi_device *ubi, struct ubi_scan_info *si,
+			const struct ubi_ckpt_info *ci, int pnum)
+{
+	const struct ubi_ckpt_peb *rec = &ci->pebs[pnum];
+	const struct ubi_ckpt_vol *vr = &ci->vols[rec->vol_idx];
+	int err, bitflips = 0, ec = be32_to_cpu(rec->ec);
+	int vol_id = be32_to_cpu(vr->vol_id), lnum = be16_to_cpu(rec->lnum);
+	struct ubi_scan_volume *sv;
+
+	sv = ubi_scan_find_sv(si, vol_id);
+	if (sv && ubi_scan_find_seb(sv, lnum)) {
+		err = ubi_io_read_vid_hdr(ubi, pnum, vidh, 0);
+		if (err < 0)
+			return err;
+		else if (err == UBI_IO_BITFLIPS)
+			bitflips = 1;
+		else if (err)
+			/* The old copy has already been erased */
+			return add_to_list(si, pnum, ec, &si->erase);
+
+		if (be32_to_cpu(vidh->vol_id) != vol_id ||
+		    be32_to_cpu(vidh->lnum) != lnum) {
+			ubi_err("PEB %d does not contain LEB %d:%d",
+				pnum, vol_id, lnum);
+			return -EINVAL;
+		}
+
+		return ubi_scan_add_used(ubi, si, pnum, ec, vidh, bitflips);
+	}
+
+	memset(vidh, 0, sizeof(struct ubi_vid_hdr));
+	vidh->vol_type = vr->vol_type;
+	vidh->compat = vr->compat;
+	vidh->vol_id = vr->vol_id;
+	vidh->lnum = cpu_to_be32(lnum);
+	vidh->used_ebs = vr->used_ebs;
+	vidh->data_pad = vr->data_pad;
+	if (vr->vol_type == UBI_VID_STATIC) {
+		if (lnum == be32_to_cpu(vr->used_ebs) - 1)
+			vidh->data_size = vr->last_data_size;
+		else
+			vidh->data_size = cpu_to_be32(ubi->leb_size -
+						be32_to_cpu(vr->data_pad));
+	}
+
+	return ubi_scan_add_used(ubi, si, pnum, ec, vidh, 0);
+}
+
+/**
+ * scan_ckpt - build scanning information from a checkpoint.
+ * @ubi: UBI device description object
+ * @ci: the checkpoint
+ *
+ * This function scans only the physical eraseblocks which the checkpoint
+ * records as %UBI_CKPT_PEB_SCAN and takes the state of all the others from
+ * the checkpoint. The checkpoint is erased afterwards, because it becomes
+ * stale as soon as anything is written. Returns the scanning information in
+ * case of success and %NULL if the checkpoint cannot be used, in which case
+ * the whole flash has to be scanned.
+ */
+static struct ubi_scan_info *scan_ckpt(struct ubi_device *ubi,
+				       const struct ubi_ckpt_info *ci)
+{
+	int err, pnum, ec, scanned = 0;
+	struct ubi_scan_info *si;
+
+	si = alloc_si();
+	if (!si)
+		return NULL;
+
+	ubi->image_seq = ci->image_seq;
+	si->image_seq_set = 1;
+	si->is_empty = 0;
+
+	/* First scan what may have been written after the checkpoint */
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		if (pnum == ci->pnum ||
+		    ci->pebs[pnum].state != UBI_CKPT_PEB_SCAN)
+			continue;
+
+		cond_resched();
+
+		dbg_gen("process PEB %d", pnum);
+		err = process_eb(ubi, si, pnum);
+		if (err < 0)
+			goto out_si;
+		scanned += 1;
+	}
+
+	/* And add everything else as the checkpoint describes it */
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		int state = ci->pebs[pnum].state;
+
+		ec = be32_to_cpu(ci->pebs[pnum].ec);
+		if (pnum == ci->pnum) {
+			/* The checkpoint is stale once anything is written */
+			ec = ci->ec + 1;
+			err = ubi_scan_erase_peb(ubi, si, pnum, ec);
+			if (!err)
+				err = add_to_list(si, pnum, ec, &si->free);
+		} else if (state == UBI_CKPT_PEB_FREE)
+			err = add_to_list(si, pnum, ec, &si->free);
+		else if (state == UBI_CKPT_PEB_USED) {
+			cond_resched();
+			err = add_ckpt_leb(ubi, si, ci, pnum);
+		} else if (state == UBI_CKPT_PEB_ERASE) {
+			/* It may have gone bad when UBI tried to erase it */
+			err = ubi_io_is_bad(ubi, pnum);
+			if (err > 0) {
+				si->bad_peb_count += 1;
+				continue;
+			} else if (err == 0)
+				err = add_to_list(si, pnum, ec, &si->erase);
+		} else
+			continue;
+
+		if (err)
+			goto out_si;
+
+		si->ec_sum += ec;
+		si->ec_count += 1;
+		if (ec > si->max_ec)
+			si->max_ec = ec;
+		if (ec < si->min_ec)
+			si->min_ec = ec;
+	}
+
+	/* All LEBs the checkpoint describes are older than the checkpoint */
+	if (si->max_sqnum < ci->sqnum)
+		si->max_sqnum = ci->sqnum;
+
+	ubi_msg("attached from checkpoint in PEB %d, scanned %d of %d PEBs",
+		ci->pnum, scanned, ubi->peb_count);
+	return si;
+
+out_si:
+	ubi_warn("cannot use checkpoint in PEB %d, error %d", ci->pnum, err);
+	ubi_scan_destroy_si(si);
+	return NULL;
+}
+
+/**
+ * ubi_scan - scan an MTD device.
+ * @ubi: UBI device description object
+ *
+ * This function does full scanning of an MTD device and returns complete
+ * information about it. In case of failure, an error code is returned. If
+ * there is a valid checkpoint on the device, only the physical eraseblocks
+ * which may have changed after it was taken are scanned.
+ */
+struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+{
+	int err, pnum;
+	struct rb_node *rb1, *rb2;
+	struct ubi_scan_volume *sv;
+	struct ubi_scan_leb *seb;
+	struct ubi_scan_info *si = NULL;
+	struct ubi_ckpt_info *ci;
 
 	err = -ENOMEM;
 	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
 	if (!ech)
-		goto out_si;
+		return ERR_PTR(err);
 
 	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
 	if (!vidh)
 		goto out_ech;
 
-	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
+	ci = ubi_ckpt_read(ubi);
+	if (ci) {
+		si = scan_ckpt(ubi, ci);
+		ubi_ckpt_free(ci);
+	}
 
-		dbg_gen("process PEB %d", pnum);
-		err = process_eb(ubi, si, pnum);
-		if (err < 0)
+	if (!si) {
+		si = alloc_si();
+		if (!si)
 			goto out_vidh;
-	}
 
-	dbg_msg("scanning is finished");
+		for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+			cond_resched();
+
+			dbg_gen("process PEB %d", pnum);
+			err = process_eb(ubi, si, pnum);
+			if (err < 0)
+				goto out_si;
+		}
+
+		dbg_msg("scanning is finished");
+
+		/*
+		 * The paranoid check compares sequence numbers with the VID
+		 * headers, which are not recorded in checkpoints.
+		 */
+		err = paranoid_check_si(ubi, si);
+		if (err) {
+			if (err > 0)
+				err = -EINVAL;
+			goto out_si;
+		}
+	}
 
 	/* Calculate mean erase counter */
 	if (si->ec_count)
@@ -947,24 +1157,17 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 		if (seb->ec == UBI_SCAN_UNKNOWN_EC)
 			seb->ec = si->mean_ec;
 
-	err = paranoid_check_si(ubi, si);
-	if (err) {
-		if (err > 0)
-			err = -EINVAL;
-		goto out_vidh;
-	}
-
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
 
 	return si;
 
+out_si:
+	ubi_scan_destroy_si(si);
 out_vidh:
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
-out_si:
-	ubi_scan_destroy_si(si);
 	return ERR_PTR(err);
 }
 
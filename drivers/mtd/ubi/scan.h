@@ -128,6 +128,31 @@ struct ubi_scan_info {
 	int image_seq_set;
 };
 
+/**
+ * struct ubi_ckpt_info - a checkpoint found on the flash.
+ * @pnum: physical eraseblock holding the checkpoint
+ * @ec: erase counter of @pnum
+ * @sqnum: sequence number of the checkpoint VID header
+ * @image_seq: image sequence number the checkpoint was taken with
+ * @vol_count: number of volume records
+ * @pebs: per physical eraseblock records, indexed by PEB number
+ * @vols: volume records
+ * @buf: buffer the checkpoint was read to, holds @pebs and @vols
+ *
+ * All the logical eraseblocks the checkpoint records were written before the
+ * checkpoint, so their sequence numbers are lower than @sqnum.
+ */
+struct ubi_ckpt_info {
+	int pnum;
+	int ec;
+	unsigned long long sqnum;
+	int image_seq;
+	int vol_count;
+	const struct ubi_ckpt_peb *pebs;
+	const struct ubi_ckpt_vol *vols;
+	void *buf;
+};
+
 struct ubi_device;
 struct ubi_vid_hdr;
 
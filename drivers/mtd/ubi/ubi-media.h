@@ -312,6 +312,19 @@ struct ubi_vid_hdr {
 #define UBI_LAYOUT_VOLUME_NAME   "layout volume"
 #define UBI_LAYOUT_VOLUME_COMPAT UBI_COMPAT_REJECT
 
+/*
+ * The checkpoint volume stores a snapshot of the state of all physical
+ * eraseblocks, which allows attaching without scanning the whole flash. It
+ * consists of a single physical eraseblock which has to be one of the first
+ * %UBI_CKPT_MAX_START physical eraseblocks of the device, so that it can be
+ * found quickly. Implementations which do not know about checkpoints simply
+ * delete it.
+ */
+#define UBI_CKPT_VOLUME_ID     (UBI_LAYOUT_VOLUME_ID + 1)
+#define UBI_CKPT_VOLUME_TYPE   UBI_VID_DYNAMIC
+#define UBI_CKPT_VOLUME_COMPAT UBI_COMPAT_DELETE
+#define UBI_CKPT_MAX_START     64
+
 /* The maximum number of volumes per one UBI device */
 #define UBI_MAX_VOLUMES 128
 
@@ -375,4 +388,106 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/* Checkpoint header magic number (ASCII "UBIC") */
+#define UBI_CKPT_HDR_MAGIC 0x55424943
+
+/* The version of the checkpoint format */
+#define UBI_CKPT_VERSION 1
+
+/* Size of the checkpoint header without the ending CRC */
+#define UBI_CKPT_HDR_SIZE_CRC \
+	(sizeof(struct ubi_ckpt_hdr) - sizeof(__be32))
+
+/*
+ * Physical eraseblock states recorded in the checkpoint.
+ *
+ * @UBI_CKPT_PEB_SCAN: the state is unknown, the PEB has to be scanned
+ * @UBI_CKPT_PEB_FREE: the PEB is free
+ * @UBI_CKPT_PEB_USED: the PEB contains a logical eraseblock
+ * @UBI_CKPT_PEB_ERASE: the PEB has to be erased
+ */
+enum {
+	UBI_CKPT_PEB_SCAN  = 0,
+	UBI_CKPT_PEB_FREE  = 1,
+	UBI_CKPT_PEB_USED  = 2,
+	UBI_CKPT_PEB_ERASE = 3
+};
+
+/**
+ * struct ubi_ckpt_hdr - checkpoint header.
+ * @magic: checkpoint header magic number (%UBI_CKPT_HDR_MAGIC)
+ * @version: version of the checkpoint format (%UBI_CKPT_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @peb_count: count of physical eraseblocks described by the checkpoint
+ * @vol_count: count of volume records in the checkpoint
+ * @image_seq: image sequence number
+ * @data_size: how many bytes of records follow the header
+ * @data_crc: CRC checksum of the records
+ * @padding2: reserved for future, zeroes
+ * @hdr_crc: checkpoint header CRC checksum
+ *
+ * The checkpoint is stored in the logical eraseblock 0 of the checkpoint
+ * volume. It starts with this header, which is followed by @peb_count
+ * &struct ubi_ckpt_peb records, indexed by the physical eraseblock number,
+ * and then by @vol_count &struct ubi_ckpt_vol records.
+ *
+ * The checkpoint is valid only as long as all the physical eraseblocks it
+ * does not record as %UBI_CKPT_PEB_SCAN keep the recorded state. UBI erases
+ * the checkpoint before this may be broken, so a checkpoint found on the
+ * flash can be trusted, except for the sequence numbers of the logical
+ * eraseblocks: the checkpoint does not record them, but all of them are
+ * lower than the sequence number of the checkpoint's VID header.
+ */
+struct ubi_ckpt_hdr {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  peb_count;
+	__be32  vol_count;
+	__be32  image_seq;
+	__be32  data_size;
+	__be32  data_crc;
+	__u8    padding2[32];
+	__be32  hdr_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_ckpt_peb - checkpoint record of a physical eraseblock.
+ * @ec: erase counter
+ * @state: physical eraseblock state (%UBI_CKPT_PEB_FREE, etc)
+ * @vol_idx: index of the volume record (%UBI_CKPT_PEB_USED only)
+ * @lnum: logical eraseblock number (%UBI_CKPT_PEB_USED only)
+ */
+struct ubi_ckpt_peb {
+	__be32  ec;
+	__u8    state;
+	__u8    vol_idx;
+	__be16  lnum;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_ckpt_vol - checkpoint record of a volume.
+ * @vol_id: volume ID
+ * @vol_type: volume type as stored in VID headers (%UBI_VID_DYNAMIC or
+ *            %UBI_VID_STATIC)
+ * @compat: compatibility flags of the volume
+ * @padding1: reserved for future, zeroes
+ * @used_ebs: @used_ebs as stored in the VID headers of this volume
+ * @data_pad: how many bytes at the end of logical eraseblocks are not used
+ * @last_data_size: data size of logical eraseblock @used_ebs - 1 (static
+ *                  volumes only)
+ *
+ * These are the fields UBI needs from the VID headers of the logical
+ * eraseblocks which are not scanned.
+ */
+struct ubi_ckpt_vol {
+	__be32  vol_id;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding1[2];
+	__be32  used_ebs;
+	__be32  data_pad;
+	__be32  last_data_size;
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
@@ -65,6 +65,12 @@
 /* Background thread name pattern */
 #define UBI_BGT_NAME_PATTERN "ubi_bgt%dd"
 
+/* Erase thread name pattern */
+#define UBI_ERS_NAME_PATTERN "ubi_ers%dd_%d"
+
+/* Number of threads doing erasures in addition to the background thread */
+#define UBI_ERASE_THREADS CONFIG_MTD_UBI_ERASE_THREADS
+
 /* This marker in the EBA table means that the LEB is um-mapped */
 #define UBI_LEB_UNMAPPED -1
 
@@ -81,6 +87,16 @@
  */
 #define UBI_PROT_QUEUE_LEN 10
 
+/*
+ * While a checkpoint is valid, physical eraseblocks are only taken from the
+ * checkpoint pool, because only those are scanned when attaching from the
+ * checkpoint. The pool gets 1/64 of the PEBs, within the below limits. A new
+ * checkpoint is written when the pool runs out.
+ */
+#define UBI_CKPT_POOL_SHIFT 6
+#define UBI_CKPT_POOL_MIN 8
+#define UBI_CKPT_POOL_MAX 256
+
 /*
  * Error codes returned by the I/O sub-system.
  *
@@ -335,7 +351,9 @@ struct ubi_wl_entry;
  * @pq_head: protection queue head
  * @wl_lock: protects the @used, @free, @pq, @pq_head, @lookuptbl, @move_from,
  * 	     @move_to, @move_to_put @erase_pending, @wl_scheduled, @works,
- * 	     @erroneous, and @erroneous_peb_count fields
+ * 	     @erroneous, @erroneous_peb_count, @free_count, @erase_inflight,
+ * 	     @erase_pending_max, @ers_threads, @ckpt_valid, @ckpt_pool,
+ * 	     @ckpt_works and @ckpt_anchor fields
  * @move_mutex: serializes eraseblock moves
  * @work_sem: synchronizes the WL worker with use tasks
  * @wl_scheduled: non-zero if the wear-leveling was scheduled
@@ -350,6 +368,22 @@ struct ubi_wl_entry;
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
  * @reboot_notifier: notifier to terminate background thread before rebooting
+ * @free_count: count of free physical eraseblocks (in @free and @ckpt_pool)
+ * @erase_pending: count of erase works in @works
+ * @erase_inflight: count of erasures being done right now
+ * @erase_pending_max: the largest @erase_pending seen so far
+ * @erase_wait: wait queue for erasures to finish
+ * @ers_threads: threads doing erasures in parallel with the background thread
+ *
+ * @ckpt_enabled: if checkpoints are written on this UBI device
+ * @ckpt_valid: if the checkpoint on the flash describes the current state
+ * @ckpt_needed: if the background thread has to write a new checkpoint
+ * @ckpt_pool: RB-tree of free physical eraseblocks which may be used while the
+ *             checkpoint is valid
+ * @ckpt_pool_size: how many physical eraseblocks to put to @ckpt_pool
+ * @ckpt_works: erase works held back while the checkpoint is valid
+ * @ckpt_anchor: the physical eraseblock reserved for the checkpoint
+ * @ckpt_mutex: serializes writing and dropping the checkpoint
  *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
@@ -436,6 +470,22 @@ struct ubi_device {
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
 	struct notifier_block reboot_notifier;
+	int free_count;
+	int erase_pending;
+	int erase_inflight;
+	int erase_pending_max;
+	wait_queue_head_t erase_wait;
+	struct task_struct *ers_threads[UBI_ERASE_THREADS];
+
+	/* Checkpoint stuff */
+	int ckpt_enabled;
+	int ckpt_valid;
+	int ckpt_needed;
+	struct rb_root ckpt_pool;
+	int ckpt_pool_size;
+	struct list_head ckpt_works;
+	struct ubi_wl_entry *ckpt_anchor;
+	struct mutex ckpt_mutex;
 
 	/* I/O sub-system's stuff */
 	long long flash_size;
@@ -523,6 +573,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -532,6 +583,25 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+int ubi_erase_thread(void *u);
+int ubi_wl_ckpt_prepare(struct ubi_device *ubi, struct ubi_ckpt_peb *pebs);
+int ubi_wl_ckpt_drop(struct ubi_device *ubi);
+
+/* ckpt.c */
+#ifdef CONFIG_MTD_UBI_CHECKPOINT
+void ubi_ckpt_init(struct ubi_device *ubi);
+int ubi_ckpt_write(struct ubi_device *ubi);
+struct ubi_ckpt_info *ubi_ckpt_read(struct ubi_device *ubi);
+void ubi_ckpt_free(struct ubi_ckpt_info *ci);
+#else
+static inline void ubi_ckpt_init(struct ubi_device *ubi) {}
+static inline int ubi_ckpt_write(struct ubi_device *ubi) { return 0; }
+static inline struct ubi_ckpt_info *ubi_ckpt_read(struct ubi_device *ubi)
+{
+	return NULL;
+}
+static inline void ubi_ckpt_free(struct ubi_ckpt_info *ci) {}
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -141,6 +141,13 @@
  */
 #define WL_MAX_FAILURES 32
 
+/*
+ * When there are fewer free physical eraseblocks than this, pending erasures
+ * are done before any other works, so that writers find a free physical
+ * eraseblock instead of waiting for an erasure.
+ */
+#define WL_FREE_LOW_WATERMARK 16
+
 /**
  * struct ubi_work - UBI work description data structure.
  * @list: a link in the list of pending works
@@ -172,6 +179,9 @@ static int paranoid_check_in_pq(struct ubi_device *ubi, struct ubi_wl_entry *e);
 #define paranoid_check_in_pq(ubi, e) 0
 #endif
 
+static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
+			int cancel);
+
 /**
  * wl_tree_add - add a wear-leveling entry to a WL RB-tree.
  * @e: the wear-leveling entry to add
@@ -208,16 +218,62 @@ static void wl_tree_add(struct ubi_wl_entry *e, struct rb_root *root)
 	rb_insert_color(&e->u.rb, root);
 }
 
+/**
+ * wake_up_workers - wake up the background threads.
+ * @ubi: UBI device description object
+ * @erase: if there is an erasure to do
+ *
+ * The erase threads are only woken up if there is an erasure for them. Note,
+ * @ubi->wl_lock has to be locked.
+ */
+static void wake_up_workers(struct ubi_device *ubi, int erase)
+{
+	int i;
+
+	if (!ubi->thread_enabled)
+		return;
+
+	wake_up_process(ubi->bgt_thread);
+	if (erase)
+		for (i = 0; i < UBI_ERASE_THREADS; i++)
+			if (ubi->ers_threads[i])
+				wake_up_process(ubi->ers_threads[i]);
+}
+
+/**
+ * pick_work - pick the pending work to do next.
+ * @ubi: UBI device description object
+ * @erase_only: if only erasures may be picked
+ *
+ * Works are done in order, except when free physical eraseblocks run low,
+ * then erasures go first. Returns %NULL if there is nothing to do. Note,
+ * @ubi->wl_lock has to be locked.
+ */
+static struct ubi_work *pick_work(struct ubi_device *ubi, int erase_only)
+{
+	struct ubi_work *wrk;
+
+	if (erase_only || ubi->free_count < WL_FREE_LOW_WATERMARK)
+		list_for_each_entry(wrk, &ubi->works, list)
+			if (wrk->func == &erase_worker)
+				return wrk;
+
+	if (erase_only || list_empty(&ubi->works))
+		return NULL;
+	return list_entry(ubi->works.next, struct ubi_work, list);
+}
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
+ * @erase_only: if only an erasure may be done
  *
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  */
-static int do_work(struct ubi_device *ubi)
+static int do_work(struct ubi_device *ubi, int erase_only)
 {
-	int err;
+	int err, erase;
 	struct ubi_work *wrk;
 
 	cond_resched();
@@ -230,16 +286,22 @@ static int do_work(struct ubi_device *ubi)
 	 */
 	down_read(&ubi->work_sem);
 	spin_lock(&ubi->wl_lock);
-	if (list_empty(&ubi->works)) {
+	wrk = pick_work(ubi, erase_only);
+	if (!wrk) {
 		spin_unlock(&ubi->wl_lock);
 		up_read(&ubi->work_sem);
 		return 0;
 	}
 
-	wrk = list_entry(ubi->works.next, struct ubi_work, list);
 	list_del(&wrk->list);
 	ubi->works_count -= 1;
 	ubi_assert(ubi->works_count >= 0);
+	erase = (wrk->func == &erase_worker);
+	if (erase) {
+		ubi->erase_pending -= 1;
+		ubi->erase_inflight += 1;
+		ubi_assert(ubi->erase_pending >= 0);
+	}
 	spin_unlock(&ubi->wl_lock);
 
 	/*
@@ -250,6 +312,14 @@ static int do_work(struct ubi_device *ubi)
 	err = wrk->func(ubi, wrk, 0);
 	if (err)
 		ubi_err("work failed with error code %d", err);
+
+	if (erase) {
+		spin_lock(&ubi->wl_lock);
+		ubi->erase_inflight -= 1;
+		ubi_assert(ubi->erase_inflight >= 0);
+		spin_unlock(&ubi->wl_lock);
+		wake_up_all(&ubi->erase_wait);
+	}
 	up_read(&ubi->work_sem);
 
 	return err;
@@ -261,8 +331,9 @@ static int do_work(struct ubi_device *ubi)
  *
  * This function tries to make a free PEB by means of synchronous execution of
  * pending works. This may be needed if, for example the background thread is
- * disabled. Returns zero in case of success and a negative error code in case
- * of failure.
+ * disabled. If all erasures are already being done by other threads, it waits
+ * for them instead. Returns zero in case of success and a negative error code
+ * in case of failure.
  */
 static int produce_free_peb(struct ubi_device *ubi)
 {
@@ -270,10 +341,24 @@ static int produce_free_peb(struct ubi_device *ubi)
 
 	spin_lock(&ubi->wl_lock);
 	while (!ubi->free.rb_node) {
+		if (!ubi->erase_pending && ubi->erase_inflight) {
+			spin_unlock(&ubi->wl_lock);
+
+			dbg_wl("wait for %d erasures", ubi->erase_inflight);
+			wait_event(ubi->erase_wait, ubi->free.rb_node ||
+						    !ubi->erase_inflight);
+
+			spin_lock(&ubi->wl_lock);
+			continue;
+		}
+
+		if (!ubi->works_count)
+			/* Nothing can produce one, let the caller know */
+			break;
 		spin_unlock(&ubi->wl_lock);
 
 		dbg_wl("do one work synchronously");
-		err = do_work(ubi);
+		err = do_work(ubi, 0);
 		if (err)
 			return err;
 
@@ -376,6 +461,19 @@ static struct ubi_wl_entry *find_wl_entry(struct rb_root *root, int max)
 	return e;
 }
 
+/**
+ * free_root - get the tree to take free physical eraseblocks from.
+ * @ubi: UBI device description object
+ *
+ * While the checkpoint is valid, physical eraseblocks may only be taken from
+ * the checkpoint pool, because only those are scanned when attaching from the
+ * checkpoint. Note, @ubi->wl_lock has to be locked.
+ */
+static struct rb_root *free_root(struct ubi_device *ubi)
+{
+	return ubi->ckpt_valid ? &ubi->ckpt_pool : &ubi->free;
+}
+
 /**
  * ubi_wl_get_peb - get a physical eraseblock.
  * @ubi: UBI device description object
@@ -388,14 +486,33 @@ int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 {
 	int err, medium_ec;
 	struct ubi_wl_entry *e, *first, *last;
+	struct rb_root *root;
 
 	ubi_assert(dtype == UBI_LONGTERM || dtype == UBI_SHORTTERM ||
 		   dtype == UBI_UNKNOWN);
 
 retry:
 	spin_lock(&ubi->wl_lock);
-	if (!ubi->free.rb_node) {
-		if (ubi->works_count == 0) {
+	if (ubi->ckpt_valid && !ubi->ckpt_pool.rb_node) {
+		/* The pool is used up, so the checkpoint has to go */
+		spin_unlock(&ubi->wl_lock);
+
+		mutex_lock(&ubi->ckpt_mutex);
+		err = ubi_wl_ckpt_drop(ubi);
+		mutex_unlock(&ubi->ckpt_mutex);
+		if (err)
+			return err;
+		goto retry;
+	}
+
+	root = free_root(ubi);
+	if (!root->rb_node) {
+		/*
+		 * Erase threads take their works off @ubi->works, so an empty
+		 * list does not mean nothing is coming: wait for the erasures
+		 * in flight in 'produce_free_peb()' first.
+		 */
+		if (ubi->works_count == 0 && ubi->erase_inflight == 0) {
 			ubi_assert(list_empty(&ubi->works));
 			ubi_err("no free eraseblocks");
 			spin_unlock(&ubi->wl_lock);
@@ -417,7 +534,7 @@ retry:
 		 * bounded by the the lowest erase counter plus
 		 * %WL_FREE_MAX_DIFF.
 		 */
-		e = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
+		e = find_wl_entry(root, WL_FREE_MAX_DIFF);
 		break;
 	case UBI_UNKNOWN:
 		/*
@@ -426,16 +543,14 @@ retry:
 		 * eraseblock with erase counter greater or equivalent than the
 		 * lowest erase counter plus %WL_FREE_MAX_DIFF.
 		 */
-		first = rb_entry(rb_first(&ubi->free), struct ubi_wl_entry,
-					u.rb);
-		last = rb_entry(rb_last(&ubi->free), struct ubi_wl_entry, u.rb);
+		first = rb_entry(rb_first(root), struct ubi_wl_entry, u.rb);
+		last = rb_entry(rb_last(root), struct ubi_wl_entry, u.rb);
 
 		if (last->ec - first->ec < WL_FREE_MAX_DIFF)
-			e = rb_entry(ubi->free.rb_node,
-					struct ubi_wl_entry, u.rb);
+			e = rb_entry(root->rb_node, struct ubi_wl_entry, u.rb);
 		else {
 			medium_ec = (first->ec + WL_FREE_MAX_DIFF)/2;
-			e = find_wl_entry(&ubi->free, medium_ec);
+			e = find_wl_entry(root, medium_ec);
 		}
 		break;
 	case UBI_SHORTTERM:
@@ -443,19 +558,20 @@ retry:
 		 * For short term data we pick a physical eraseblock with the
 		 * lowest erase counter as we expect it will be erased soon.
 		 */
-		e = rb_entry(rb_first(&ubi->free), struct ubi_wl_entry, u.rb);
+		e = rb_entry(rb_first(root), struct ubi_wl_entry, u.rb);
 		break;
 	default:
 		BUG();
 	}
 
-	paranoid_check_in_wl_tree(e, &ubi->free);
+	paranoid_check_in_wl_tree(e, root);
 
 	/*
 	 * Move the physical eraseblock to the protection queue where it will
 	 * be protected from being moved for some time.
 	 */
-	rb_erase(&e->u.rb, &ubi->free);
+	rb_erase(&e->u.rb, root);
+	ubi->free_count -= 1;
 	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
 	prot_queue_add(ubi, e);
 	spin_unlock(&ubi->wl_lock);
@@ -609,18 +725,21 @@ repeat:
  */
 static void schedule_ubi_work(struct ubi_device *ubi, struct ubi_work *wrk)
 {
+	int erase = (wrk->func == &erase_worker);
+
 	spin_lock(&ubi->wl_lock);
 	list_add_tail(&wrk->list, &ubi->works);
 	ubi_assert(ubi->works_count >= 0);
 	ubi->works_count += 1;
-	if (ubi->thread_enabled)
-		wake_up_process(ubi->bgt_thread);
+	if (erase) {
+		ubi->erase_pending += 1;
+		if (ubi->erase_pending > ubi->erase_pending_max)
+			ubi->erase_pending_max = ubi->erase_pending;
+	}
+	wake_up_workers(ubi, erase);
 	spin_unlock(&ubi->wl_lock);
 }
 
-static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
-			int cancel);
-
 /**
  * schedule_erase - schedule an erase work.
  * @ubi: UBI device description object
@@ -646,6 +765,19 @@ static int schedule_erase(struct ubi_device *ubi, struct ubi_wl_entry *e,
 	wl_wrk->e = e;
 	wl_wrk->torture = torture;
 
+	spin_lock(&ubi->wl_lock);
+	if (ubi->ckpt_valid) {
+		/*
+		 * The checkpoint may record the contents of this physical
+		 * eraseblock, so it must not be erased while the checkpoint is
+		 * valid.
+		 */
+		list_add_tail(&wl_wrk->list, &ubi->ckpt_works);
+		spin_unlock(&ubi->wl_lock);
+		return 0;
+	}
+	spin_unlock(&ubi->wl_lock);
+
 	schedule_ubi_work(ubi, wl_wrk);
 	return 0;
 }
@@ -681,7 +813,7 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 	ubi_assert(!ubi->move_from && !ubi->move_to);
 	ubi_assert(!ubi->move_to_put);
 
-	if (!ubi->free.rb_node ||
+	if (!free_root(ubi)->rb_node ||
 	    (!ubi->used.rb_node && !ubi->scrub.rb_node)) {
 		/*
 		 * No free physical eraseblocks? Well, they must be waiting in
@@ -694,7 +826,7 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 		 * triggered again.
 		 */
 		dbg_wl("cancel WL, a list is empty: free %d, used %d",
-		       !ubi->free.rb_node, !ubi->used.rb_node);
+		       !free_root(ubi)->rb_node, !ubi->used.rb_node);
 		goto out_cancel;
 	}
 
@@ -705,7 +837,7 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 		 * counters differ much enough, start wear-leveling.
 		 */
 		e1 = rb_entry(rb_first(&ubi->used), struct ubi_wl_entry, u.rb);
-		e2 = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
+		e2 = find_wl_entry(free_root(ubi), WL_FREE_MAX_DIFF);
 
 		if (!(e2->ec - e1->ec >= UBI_WL_THRESHOLD)) {
 			dbg_wl("no WL needed: min used EC %d, max free EC %d",
@@ -720,14 +852,15 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 		/* Perform scrubbing */
 		scrubbing = 1;
 		e1 = rb_entry(rb_first(&ubi->scrub), struct ubi_wl_entry, u.rb);
-		e2 = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
+		e2 = find_wl_entry(free_root(ubi), WL_FREE_MAX_DIFF);
 		paranoid_check_in_wl_tree(e1, &ubi->scrub);
 		rb_erase(&e1->u.rb, &ubi->scrub);
 		dbg_wl("scrub PEB %d to PEB %d", e1->pnum, e2->pnum);
 	}
 
-	paranoid_check_in_wl_tree(e2, &ubi->free);
-	rb_erase(&e2->u.rb, &ubi->free);
+	paranoid_check_in_wl_tree(e2, free_root(ubi));
+	rb_erase(&e2->u.rb, free_root(ubi));
+	ubi->free_count -= 1;
 	ubi->move_from = e1;
 	ubi->move_to = e2;
 	spin_unlock(&ubi->wl_lock);
@@ -948,7 +1081,7 @@ static int ensure_wear_leveling(struct ubi_device *ubi)
 	 * the WL worker has to be scheduled anyway.
 	 */
 	if (!ubi->scrub.rb_node) {
-		if (!ubi->used.rb_node || !ubi->free.rb_node)
+		if (!ubi->used.rb_node || !free_root(ubi)->rb_node)
 			/* No physical eraseblocks - no deal */
 			goto out_unlock;
 
@@ -959,7 +1092,7 @@ static int ensure_wear_leveling(struct ubi_device *ubi)
 		 * %UBI_WL_THRESHOLD.
 		 */
 		e1 = rb_entry(rb_first(&ubi->used), struct ubi_wl_entry, u.rb);
-		e2 = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
+		e2 = find_wl_entry(free_root(ubi), WL_FREE_MAX_DIFF);
 
 		if (!(e2->ec - e1->ec >= UBI_WL_THRESHOLD))
 			goto out_unlock;
@@ -1021,6 +1154,7 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 
 		spin_lock(&ubi->wl_lock);
 		wl_tree_add(e, &ubi->free);
+		ubi->free_count += 1;
 		spin_unlock(&ubi->wl_lock);
 
 		/*
@@ -1264,7 +1398,15 @@ retry:
  */
 int ubi_wl_flush(struct ubi_device *ubi)
 {
-	int err;
+	int err = 0;
+
+	/* Erasures held back by the checkpoint have to be flushed too */
+	mutex_lock(&ubi->ckpt_mutex);
+	if (!list_empty(&ubi->ckpt_works))
+		err = ubi_wl_ckpt_drop(ubi);
+	mutex_unlock(&ubi->ckpt_mutex);
+	if (err)
+		return err;
 
 	/*
 	 * Erase while the pending works queue is not empty, but not more than
@@ -1272,7 +1414,7 @@ int ubi_wl_flush(struct ubi_device *ubi)
 	 */
 	dbg_wl("flush (%d pending works)", ubi->works_count);
 	while (ubi->works_count) {
-		err = do_work(ubi);
+		err = do_work(ubi, 0);
 		if (err)
 			return err;
 	}
@@ -1290,7 +1432,7 @@ int ubi_wl_flush(struct ubi_device *ubi)
 	 */
 	while (ubi->works_count) {
 		dbg_wl("flush more (%d pending works)", ubi->works_count);
-		err = do_work(ubi);
+		err = do_work(ubi, 0);
 		if (err)
 			return err;
 	}
@@ -1329,6 +1471,221 @@ static void tree_destroy(struct rb_root *root)
 	}
 }
 
+/**
+ * release_ckpt_pool - return the checkpoint pool to the free tree.
+ * @ubi: UBI device description object
+ *
+ * Note, @ubi->wl_lock has to be locked.
+ */
+static void release_ckpt_pool(struct ubi_device *ubi)
+{
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+
+	while ((rb = rb_first(&ubi->ckpt_pool))) {
+		e = rb_entry(rb, struct ubi_wl_entry, u.rb);
+		rb_erase(rb, &ubi->ckpt_pool);
+		wl_tree_add(e, &ubi->free);
+	}
+}
+
+/**
+ * drop_ckpt - invalidate the checkpoint.
+ * @ubi: UBI device description object
+ *
+ * This function erases the checkpoint, after which all free physical
+ * eraseblocks may be used and the erasures held back by the checkpoint may
+ * be done. The erased anchor stays reserved in @ubi->ckpt_anchor, so that
+ * the next checkpoint still finds a physical eraseblock below
+ * %UBI_CKPT_MAX_START. Returns zero in case of success and a negative error
+ * code in case of failure.
+ */
+static int drop_ckpt(struct ubi_device *ubi)
+{
+	int err, count = 0;
+	struct ubi_work *wrk;
+
+	if (!ubi->ckpt_valid)
+		return 0;
+
+	dbg_wl("drop checkpoint in PEB %d", ubi->ckpt_anchor->pnum);
+	err = sync_erase(ubi, ubi->ckpt_anchor, 0);
+	if (err) {
+		/* A stale checkpoint must not be left on the flash */
+		ubi_err("cannot erase checkpoint in PEB %d, error %d",
+			ubi->ckpt_anchor->pnum, err);
+		ubi_ro_mode(ubi);
+		return err;
+	}
+
+	spin_lock(&ubi->wl_lock);
+	ubi->ckpt_valid = 0;
+	release_ckpt_pool(ubi);
+
+	/* Only erasures are held back */
+	list_for_each_entry(wrk, &ubi->ckpt_works, list)
+		count += 1;
+	list_splice_tail_init(&ubi->ckpt_works, &ubi->works);
+	ubi->works_count += count;
+	ubi->erase_pending += count;
+	if (ubi->erase_pending > ubi->erase_pending_max)
+		ubi->erase_pending_max = ubi->erase_pending;
+	if (count)
+		wake_up_workers(ubi, 1);
+	spin_unlock(&ubi->wl_lock);
+
+	return 0;
+}
+
+/**
+ * ubi_wl_ckpt_drop - invalidate the checkpoint.
+ * @ubi: UBI device description object
+ *
+ * This function invalidates the checkpoint and asks the background thread
+ * for a new one. The caller has to hold @ubi->ckpt_mutex. Returns zero in case
+ * of success and a negative error code in case of failure.
+ */
+int ubi_wl_ckpt_drop(struct ubi_device *ubi)
+{
+	int err;
+
+	err = drop_ckpt(ubi);
+	if (err)
+		return err;
+
+	spin_lock(&ubi->wl_lock);
+	if (ubi->ckpt_enabled) {
+		ubi->ckpt_needed = 1;
+		wake_up_workers(ubi, 0);
+	}
+	spin_unlock(&ubi->wl_lock);
+
+	return 0;
+}
+
+/**
+ * ubi_wl_ckpt_prepare - prepare taking a checkpoint.
+ * @ubi: UBI device description object
+ * @pebs: per physical eraseblock records to fill
+ *
+ * This function invalidates the old checkpoint, picks the physical eraseblock
+ * for the new one and fills the checkpoint pool. The checkpoint is valid from
+ * now on, so nothing the checkpoint records can change any more: physical
+ * eraseblocks are only taken from the pool, and erasures are held back. The
+ * state of every physical eraseblock is recorded in @pebs, except which
+ * logical eraseblock is stored in used ones. The caller has to hold
+ * @ubi->ckpt_mutex.
+ *
+ * Returns the physical eraseblock to write the checkpoint to in case of
+ * success, %-ENOSPC if there are not enough free physical eraseblocks and
+ * other negative error codes in case of failure.
+ */
+int ubi_wl_ckpt_prepare(struct ubi_device *ubi, struct ubi_ckpt_peb *pebs)
+{
+	int err, i, count = 0;
+	struct rb_node *rb;
+	struct ubi_work *wrk;
+	struct ubi_wl_entry *e, *anchor = NULL;
+
+	err = drop_ckpt(ubi);
+	if (err)
+		return err;
+
+	spin_lock(&ubi->wl_lock);
+	/*
+	 * The anchor is kept reserved between checkpoints, as the free
+	 * physical eraseblocks below %UBI_CKPT_MAX_START may all be used up
+	 * in the meantime. It is only swapped for a less worn free one in
+	 * that range, which is the first one found as @ubi->free is sorted by
+	 * erase counter.
+	 */
+	anchor = ubi->ckpt_anchor;
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb)
+		if (e->pnum < UBI_CKPT_MAX_START) {
+			if (!anchor || anchor->ec - e->ec >= UBI_WL_THRESHOLD) {
+				if (anchor) {
+					wl_tree_add(anchor, &ubi->free);
+					ubi->free_count += 1;
+				}
+				rb_erase(&e->u.rb, &ubi->free);
+				ubi->free_count -= 1;
+				anchor = e;
+			}
+			break;
+		}
+	if (!anchor) {
+		spin_unlock(&ubi->wl_lock);
+		ubi_warn("no free PEB below %d for the checkpoint",
+			 UBI_CKPT_MAX_START);
+		return -ENOSPC;
+	}
+	ubi->ckpt_anchor = anchor;
+
+	while (count < ubi->ckpt_pool_size && ubi->free.rb_node) {
+		e = rb_entry(rb_first(&ubi->free), struct ubi_wl_entry, u.rb);
+		rb_erase(&e->u.rb, &ubi->free);
+		wl_tree_add(e, &ubi->ckpt_pool);
+		count += 1;
+	}
+	if (count < UBI_CKPT_POOL_MIN) {
+		release_ckpt_pool(ubi);
+		spin_unlock(&ubi->wl_lock);
+		ubi_warn("only %d free PEBs for the checkpoint pool", count);
+		return -ENOSPC;
+	}
+
+	ubi->ckpt_valid = 1;
+
+	/*
+	 * Physical eraseblocks which are not found below are bad, or are being
+	 * erased right now. They are scanned when attaching.
+	 */
+	for (i = 0; i < ubi->peb_count; i++)
+		pebs[i].state = UBI_CKPT_PEB_SCAN;
+
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb) {
+		pebs[e->pnum].state = UBI_CKPT_PEB_FREE;
+		pebs[e->pnum].ec = cpu_to_be32(e->ec);
+	}
+
+	ubi_rb_for_each_entry(rb, e, &ubi->used, u.rb) {
+		pebs[e->pnum].state = UBI_CKPT_PEB_USED;
+		pebs[e->pnum].ec = cpu_to_be32(e->ec);
+	}
+	ubi_rb_for_each_entry(rb, e, &ubi->scrub, u.rb) {
+		pebs[e->pnum].state = UBI_CKPT_PEB_USED;
+		pebs[e->pnum].ec = cpu_to_be32(e->ec);
+	}
+	ubi_rb_for_each_entry(rb, e, &ubi->erroneous, u.rb) {
+		pebs[e->pnum].state = UBI_CKPT_PEB_USED;
+		pebs[e->pnum].ec = cpu_to_be32(e->ec);
+	}
+	for (i = 0; i < UBI_PROT_QUEUE_LEN; i++)
+		list_for_each_entry(e, &ubi->pq[i], u.list) {
+			pebs[e->pnum].state = UBI_CKPT_PEB_USED;
+			pebs[e->pnum].ec = cpu_to_be32(e->ec);
+		}
+	if (ubi->move_from) {
+		e = ubi->move_from;
+		pebs[e->pnum].state = UBI_CKPT_PEB_USED;
+		pebs[e->pnum].ec = cpu_to_be32(e->ec);
+	}
+	if (ubi->move_to) {
+		e = ubi->move_to;
+		pebs[e->pnum].state = UBI_CKPT_PEB_USED;
+		pebs[e->pnum].ec = cpu_to_be32(e->ec);
+	}
+
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (wrk->func == &erase_worker) {
+			pebs[wrk->e->pnum].state = UBI_CKPT_PEB_ERASE;
+			pebs[wrk->e->pnum].ec = cpu_to_be32(wrk->e->ec);
+		}
+	spin_unlock(&ubi->wl_lock);
+
+	return anchor->pnum;
+}
+
 /**
  * ubi_thread - UBI background thread.
  * @u: the UBI device description object pointer
@@ -1343,7 +1700,7 @@ int ubi_thread(void *u)
 
 	set_freezable();
 	for (;;) {
-		int err;
+		int err, idle;
 
 		if (kthread_should_stop())
 			break;
@@ -1352,7 +1709,8 @@ int ubi_thread(void *u)
 			continue;
 
 		spin_lock(&ubi->wl_lock);
-		if (list_empty(&ubi->works) || ubi->ro_mode ||
+		idle = list_empty(&ubi->works);
+		if ((idle && !ubi->ckpt_needed) || ubi->ro_mode ||
 			       !ubi->thread_enabled) {
 			set_current_state(TASK_INTERRUPTIBLE);
 			spin_unlock(&ubi->wl_lock);
@@ -1361,7 +1719,11 @@ int ubi_thread(void *u)
 		}
 		spin_unlock(&ubi->wl_lock);
 
-		err = do_work(ubi);
+		/* A new checkpoint is written once all works are done */
+		if (idle)
+			err = ubi_ckpt_write(ubi);
+		else
+			err = do_work(ubi, 0);
 		if (err) {
 			ubi_err("%s: work failed with error code %d",
 				ubi->bgt_name, err);
@@ -1386,6 +1748,50 @@ int ubi_thread(void *u)
 	return 0;
 }
 
+/**
+ * ubi_erase_thread - UBI erase thread.
+ * @u: the UBI device description object pointer
+ *
+ * Erase threads only do erase works, so that several physical eraseblocks may
+ * be erased at a time while the background thread is busy with other works.
+ */
+int ubi_erase_thread(void *u)
+{
+	struct ubi_device *ubi = u;
+
+	dbg_wl("erase thread \"%s\" started, PID %d", current->comm,
+	       task_pid_nr(current));
+
+	set_freezable();
+	for (;;) {
+		if (kthread_should_stop())
+			break;
+
+		if (try_to_freeze())
+			continue;
+
+		spin_lock(&ubi->wl_lock);
+		if (!ubi->erase_pending || ubi->ro_mode ||
+		    !ubi->thread_enabled) {
+			set_current_state(TASK_INTERRUPTIBLE);
+			spin_unlock(&ubi->wl_lock);
+			schedule();
+			continue;
+		}
+		spin_unlock(&ubi->wl_lock);
+
+		/*
+		 * Failures are reported by 'do_work()', and fatal ones make
+		 * 'erase_worker()' switch to read-only mode.
+		 */
+		do_work(ubi, 1);
+		cond_resched();
+	}
+
+	dbg_wl("erase thread \"%s\" is killed", current->comm);
+	return 0;
+}
+
 /**
  * cancel_pending - cancel all pending works.
  * @ubi: UBI device description object
@@ -1397,10 +1803,20 @@ static void cancel_pending(struct ubi_device *ubi)
 
 		wrk = list_entry(ubi->works.next, struct ubi_work, list);
 		list_del(&wrk->list);
+		if (wrk->func == &erase_worker)
+			ubi->erase_pending -= 1;
 		wrk->func(ubi, wrk, 1);
 		ubi->works_count -= 1;
 		ubi_assert(ubi->works_count >= 0);
 	}
+
+	while (!list_empty(&ubi->ckpt_works)) {
+		struct ubi_work *wrk;
+
+		wrk = list_entry(ubi->ckpt_works.next, struct ubi_work, list);
+		list_del(&wrk->list);
+		wrk->func(ubi, wrk, 1);
+	}
 }
 
 /**
@@ -1425,6 +1841,10 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	init_rwsem(&ubi->work_sem);
 	ubi->max_ec = si->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
+	init_waitqueue_head(&ubi->erase_wait);
+	ubi->ckpt_pool = RB_ROOT;
+	INIT_LIST_HEAD(&ubi->ckpt_works);
+	mutex_init(&ubi->ckpt_mutex);
 
 	sprintf(ubi->bgt_name, UBI_BGT_NAME_PATTERN, ubi->ubi_num);
 
@@ -1464,6 +1884,7 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 		e->ec = seb->ec;
 		ubi_assert(e->ec >= 0);
 		wl_tree_add(e, &ubi->free);
+		ubi->free_count += 1;
 		ubi->lookuptbl[e->pnum] = e;
 	}
 
@@ -1560,6 +1981,9 @@ void ubi_wl_close(struct ubi_device *ubi)
 	tree_destroy(&ubi->erroneous);
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
+	tree_destroy(&ubi->ckpt_pool);
+	if (ubi->ckpt_anchor)
+		kmem_cache_free(ubi_wl_entry_slab, ubi->ckpt_anchor);
 	kfree(ubi->lookuptbl);
 }
 
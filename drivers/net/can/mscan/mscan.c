@@ -0,0 +1,697 @@
+/*
+ * CAN bus driver for the Freescale MSCAN controller
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the version 2 of the GNU General Public License
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Received frames are handled by NAPI: the interrupt only masks the
+ * receive interrupts and schedules mscan_rx_poll(), which also reports
+ * overruns and error state changes.
+ *
+ * All three transmit buffers are used.  A frame's local priority (TBPR)
+ * is taken from the top bits of its identifier, so the controller sends
+ * queued frames in the order the bus arbitration would, rather than in
+ * buffer order.  Frames with the same priority are kept in submission
+ * order by never putting one into a lower numbered buffer than an earlier
+ * one of that priority still in flight.
+ *
+ * The acceptance filters are programmed with the span of the filters of
+ * all CAN sockets using the device (see can_rx_filter_span()), so frames
+ * nobody listens to don't even raise an interrupt.  With the "loopback"
+ * control mode set, frames are looped back in the controller and no bus
+ * is needed, which allows testing the driver just like vcan.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/interrupt.h>
+#include <linux/delay.h>
+#include <linux/netdevice.h>
+#include <linux/if_arp.h>
+#include <linux/if_ether.h>
+#include <linux/skbuff.h>
+#include <linux/can.h>
+#include <linux/can/core.h>
+#include <linux/can/dev.h>
+#include <linux/can/error.h>
+#include <linux/io.h>
+
+#include "mscan.h"
+
+#define DRV_NAME "mscan"
+
+#define MSCAN_NAPI_WEIGHT	32
+#define MSCAN_SET_MODE_RETRIES	255
+
+static struct can_bittiming_const mscan_bittiming_const = {
+	.name = DRV_NAME,
+	.tseg1_min = 4,
+	.tseg1_max = 16,
+	.tseg2_min = 2,
+	.tseg2_max = 8,
+	.sjw_max = 4,
+	.brp_min = 1,
+	.brp_max = 64,
+	.brp_inc = 1,
+};
+
+/*
+ * Init mode stops the controller: it aborts transfers in progress and
+ * resets the flag and interrupt enable registers.  The bus timing, mode
+ * and acceptance filter registers can only be written in init mode.
+ */
+static int mscan_enter_init(struct mscan_regs __iomem *regs)
+{
+	int i;
+
+	setbits8(&regs->canctl0, MSCAN_INITRQ);
+	for (i = 0; i < MSCAN_SET_MODE_RETRIES; i++) {
+		if (in_8(&regs->canctl1) & MSCAN_INITAK)
+			return 0;
+		udelay(10);
+	}
+	return -ETIMEDOUT;
+}
+
+static int mscan_leave_init(struct mscan_regs __iomem *regs)
+{
+	int i;
+
+	clrbits8(&regs->canctl0, MSCAN_INITRQ);
+	for (i = 0; i < MSCAN_SET_MODE_RETRIES; i++) {
+		if (!(in_8(&regs->canctl1) & MSCAN_INITAK))
+			return 0;
+		udelay(10);
+	}
+	return -ETIMEDOUT;
+}
+
+static int mscan_set_bittiming(struct net_device *dev)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+	struct mscan_regs __iomem *regs = priv->reg_base;
+	struct can_bittiming *bt = &priv->can.bittiming;
+	u8 btr0, btr1;
+
+	btr0 = ((bt->brp - 1) & 0x3f) | (((bt->sjw - 1) & 0x3) << 6);
+	btr1 = ((bt->prop_seg + bt->phase_seg1 - 1) & 0xf) |
+		(((bt->phase_seg2 - 1) & 0x7) << 4);
+	if (priv->can.ctrlmode & CAN_CTRLMODE_3_SAMPLES)
+		btr1 |= MSCAN_SAMP;
+
+	dev_info(dev->dev.parent,
+		 "setting BTR0=0x%02x BTR1=0x%02x\n", btr0, btr1);
+
+	/* Only called while the device is down, i.e. in init mode */
+	out_8(&regs->canbtr0, btr0);
+	out_8(&regs->canbtr1, btr1);
+
+	return 0;
+}
+
+/*
+ * Acceptance filters
+ */
+static u32 mscan_eff_id32(canid_t id)
+{
+	return ((id >> 18) << MSCAN_ID32_SFF_SHIFT) | ((id & 0x3ffff) << 1);
+}
+
+static void mscan_calc_filter(struct net_device *dev, struct mscan_filter *f)
+{
+	struct can_filter sff = { 0 }, eff = { 0 };
+	int span;
+
+	memset(f, 0, sizeof(*f));
+	span = can_rx_filter_span(dev, &sff, &eff);
+
+	/* Filter 0 passes SFF frames, filter 1 EFF frames; the RTR and SRR
+	 * bits and for SFF the unused identifier bits are "don't care" */
+	f->ar[0] = sff.can_id << MSCAN_ID32_SFF_SHIFT;
+	f->mr[0] = ~((sff.can_mask << MSCAN_ID32_SFF_SHIFT) | MSCAN_ID32_IDE);
+	f->ar[1] = mscan_eff_id32(eff.can_id) | MSCAN_ID32_IDE;
+	f->mr[1] = ~(mscan_eff_id32(eff.can_mask) | MSCAN_ID32_IDE);
+
+	f->idac = MSCAN_IDAM_32BIT;
+	switch (span) {
+	case 0:
+		f->idac = MSCAN_IDAM_CLOSED;
+		break;
+	case CAN_RX_SPAN_SFF:
+		f->ar[1] = f->ar[0];
+		f->mr[1] = f->mr[0];
+		break;
+	case CAN_RX_SPAN_EFF:
+		f->ar[0] = f->ar[1];
+		f->mr[0] = f->mr[1];
+		break;
+	}
+}
+
+static void mscan_write_filter(struct mscan_regs __iomem *regs,
+			       struct mscan_filter *f)
+{
+	int i;
+
+	out_8(&regs->canidac, f->idac);
+	for (i = 0; i < 2; i++) {
+		out_be16(&regs->filter[i].ar, f->ar[i] >> 16);
+		out_be16(&regs->filter[i].ar2, f->ar[i]);
+		out_be16(&regs->filter[i].mr, f->mr[i] >> 16);
+		out_be16(&regs->filter[i].mr2, f->mr[i]);
+	}
+}
+
+/*
+ * (Re)start the controller with the current bit timing, control mode and
+ * acceptance filters.  Transmissions in progress are lost.
+ */
+static int mscan_start(struct net_device *dev)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+	struct mscan_regs __iomem *regs = priv->reg_base;
+	unsigned long flags;
+	u8 ctl1;
+	int i, err;
+
+	spin_lock_irqsave(&priv->lock, flags);
+
+	err = mscan_enter_init(regs);
+	if (err)
+		goto out;
+
+	ctl1 = MSCAN_CANE | priv->clksrc;
+	if (priv->can.ctrlmode & CAN_CTRLMODE_LOOPBACK)
+		ctl1 |= MSCAN_LOOPB;
+	if (priv->can.ctrlmode & CAN_CTRLMODE_LISTENONLY)
+		ctl1 |= MSCAN_LISTEN;
+	out_8(&regs->canctl1, ctl1);
+
+	mscan_set_bittiming(dev);
+	mscan_write_filter(regs, &priv->filter);
+
+	err = mscan_leave_init(regs);
+	if (err)
+		goto out;
+
+	/* Whatever was queued has been thrown away by init mode */
+	for (i = 0; i < MSCAN_TX_BUFS; i++) {
+		if (priv->can.echo_skb[i]) {
+			kfree_skb(priv->can.echo_skb[i]);
+			priv->can.echo_skb[i] = NULL;
+			dev->stats.tx_dropped++;
+		}
+	}
+	priv->tx_active = 0;
+
+	out_8(&regs->canrflg, MSCAN_RFLG_EVENTS);
+	out_8(&regs->canrier, MSCAN_RX_INTS);
+	priv->can.state = CAN_STATE_ERROR_ACTIVE;
+
+ out:
+	spin_unlock_irqrestore(&priv->lock, flags);
+	if (err)
+		dev_err(dev->dev.parent, "controller does not leave init mode\n");
+	return err;
+}
+
+static void mscan_stop(struct net_device *dev)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	mscan_enter_init(priv->reg_base);
+	priv->tx_active = 0;
+	priv->can.state = CAN_STATE_STOPPED;
+	spin_unlock_irqrestore(&priv->lock, flags);
+}
+
+static void mscan_filter_work(struct work_struct *work)
+{
+	struct mscan_priv *priv = container_of(work, struct mscan_priv,
+					       filter_work);
+	struct net_device *dev = priv->dev;
+	struct mscan_filter f;
+	int i;
+
+	if (!netif_running(dev))
+		return;
+
+	/* The restart also drops what is still in the receive FIFO, so
+	 * only do it if the acceptance registers really change */
+	mscan_calc_filter(dev, &f);
+	if (!memcmp(&f, &priv->filter, sizeof(f)))
+		return;
+
+	/* Let the queued frames go out; init mode would abort them.  The
+	 * interrupt handler must not restart the queue meanwhile. */
+	spin_lock_irq(&priv->lock);
+	priv->filter_pending = 1;
+	netif_stop_queue(dev);
+	spin_unlock_irq(&priv->lock);
+	for (i = 0; i < 100 && priv->tx_active; i++)
+		msleep(1);
+
+	napi_disable(&priv->napi);
+	memcpy(&priv->filter, &f, sizeof(f));
+	if (priv->can.state != CAN_STATE_BUS_OFF)
+		mscan_start(dev);
+	napi_enable(&priv->napi);
+
+	spin_lock_irq(&priv->lock);
+	priv->filter_pending = 0;
+	if (priv->can.state != CAN_STATE_BUS_OFF)
+		netif_wake_queue(dev);
+	spin_unlock_irq(&priv->lock);
+}
+
+static void mscan_set_rx_mode(struct net_device *dev)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+
+	/* Called in atomic context; reprogramming needs init mode */
+	schedule_work(&priv->filter_work);
+}
+
+/*
+ * Transmit
+ */
+static u8 mscan_tx_prio(canid_t id)
+{
+	/* The top eight identifier bits decide bus arbitration first */
+	if (id & CAN_EFF_FLAG)
+		return (id & CAN_EFF_MASK) >> 21;
+	return (id & CAN_SFF_MASK) >> 3;
+}
+
+static int mscan_start_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	struct can_frame *frame = (struct can_frame *)skb->data;
+	struct mscan_priv *priv = netdev_priv(dev);
+	struct mscan_regs __iomem *regs = priv->reg_base;
+	unsigned long flags;
+	u8 prio, free;
+	u32 id32;
+	int buf, i;
+
+	if (frame->can_dlc > 8) {
+		kfree_skb(skb);
+		dev->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
+	prio = mscan_tx_prio(frame->can_id);
+
+	spin_lock_irqsave(&priv->lock, flags);
+
+	free = ~priv->tx_active & in_8(&regs->cantflg) & MSCAN_TXE;
+	for (i = 0; i < MSCAN_TX_BUFS; i++) {
+		if ((priv->tx_active & (1 << i)) && priv->tx_prio[i] == prio)
+			free &= ~((2 << i) - 1);
+	}
+	if (!free) {
+		/* Woken up again by the next transmit interrupt */
+		netif_stop_queue(dev);
+		spin_unlock_irqrestore(&priv->lock, flags);
+		return NETDEV_TX_BUSY;
+	}
+	buf = ffs(free) - 1;
+
+	out_8(&regs->cantbsel, 1 << buf);
+
+	if (frame->can_id & CAN_EFF_FLAG) {
+		id32 = mscan_eff_id32(frame->can_id & CAN_EFF_MASK) |
+			MSCAN_ID32_SRR | MSCAN_ID32_IDE;
+		if (frame->can_id & CAN_RTR_FLAG)
+			id32 |= MSCAN_ID32_EFF_RTR;
+	} else {
+		id32 = (frame->can_id & CAN_SFF_MASK) << MSCAN_ID32_SFF_SHIFT;
+		if (frame->can_id & CAN_RTR_FLAG)
+			id32 |= MSCAN_ID32_SFF_RTR;
+	}
+	out_be16(&regs->tx.idr1_0, id32 >> 16);
+	out_be16(&regs->tx.idr3_2, id32);
+
+	if (!(frame->can_id & CAN_RTR_FLAG)) {
+		for (i = 0; i < frame->can_dlc; i += 2)
+			out_be16(&regs->tx.dsr[i], (frame->data[i] << 8) |
+				 frame->data[i + 1]);
+	}
+	out_8(&regs->tx.dlr, frame->can_dlc);
+	out_8(&regs->tx.tbpr, prio);
+
+	dev->stats.tx_bytes += frame->can_dlc;
+	can_put_echo_skb(skb, dev, buf);
+
+	priv->tx_prio[buf] = prio;
+	priv->tx_active |= 1 << buf;
+
+	/* Clearing the buffer empty flag schedules the transmission */
+	out_8(&regs->cantflg, 1 << buf);
+	out_8(&regs->cantier, priv->tx_active);
+
+	if (priv->tx_active == MSCAN_TXE)
+		netif_stop_queue(dev);
+	dev->trans_start = jiffies;
+
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	return NETDEV_TX_OK;
+}
+
+/*
+ * Receive
+ */
+static void mscan_get_rx_frame(struct mscan_regs __iomem *regs,
+			       struct can_frame *frame)
+{
+	u32 id32;
+	int i;
+
+	id32 = (in_be16(&regs->rx.idr1_0) << 16) | in_be16(&regs->rx.idr3_2);
+	if (id32 & MSCAN_ID32_IDE) {
+		frame->can_id = ((id32 >> MSCAN_ID32_SFF_SHIFT) << 18) |
+			((id32 >> 1) & 0x3ffff) | CAN_EFF_FLAG;
+		if (id32 & MSCAN_ID32_EFF_RTR)
+			frame->can_id |= CAN_RTR_FLAG;
+	} else {
+		frame->can_id = id32 >> MSCAN_ID32_SFF_SHIFT;
+		if (id32 & MSCAN_ID32_SFF_RTR)
+			frame->can_id |= CAN_RTR_FLAG;
+	}
+
+	frame->can_dlc = min_t(u8, in_8(&regs->rx.dlr) & 0xf, 8);
+	if (!(frame->can_id & CAN_RTR_FLAG)) {
+		for (i = 0; i < frame->can_dlc; i += 2) {
+			u16 data = in_be16(&regs->rx.dsr[i]);
+
+			frame->data[i] = data >> 8;
+			if (i + 1 < frame->can_dlc)
+				frame->data[i + 1] = data;
+		}
+	}
+}
+
+static enum can_state mscan_state(u8 canrflg)
+{
+	static const enum can_state state_map[] = {
+		[MSCAN_STATE_OK] = CAN_STATE_ERROR_ACTIVE,
+		[MSCAN_STATE_WARNING] = CAN_STATE_ERROR_WARNING,
+		[MSCAN_STATE_PASSIVE] = CAN_STATE_ERROR_PASSIVE,
+		[MSCAN_STATE_BUS_OFF] = CAN_STATE_BUS_OFF,
+	};
+	u8 rstat = (canrflg & MSCAN_RSTAT_MSK) >> 4;
+	u8 tstat = (canrflg & MSCAN_TSTAT_MSK) >> 2;
+
+	return state_map[max(rstat, tstat)];
+}
+
+static void mscan_get_err_frame(struct net_device *dev,
+				struct can_frame *frame, u8 canrflg)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+	struct mscan_regs __iomem *regs = priv->reg_base;
+	enum can_state state;
+	u8 rxerr, txerr;
+
+	frame->can_id = CAN_ERR_FLAG;
+	frame->can_dlc = CAN_ERR_DLC;
+
+	if (canrflg & MSCAN_OVRIF) {
+		frame->can_id |= CAN_ERR_CRTL;
+		frame->data[1] = CAN_ERR_CRTL_RX_OVERFLOW;
+		dev->stats.rx_over_errors++;
+		dev->stats.rx_errors++;
+	}
+
+	if (!(canrflg & MSCAN_CSCIF))
+		return;
+
+	state = mscan_state(canrflg);
+	if (state == priv->can.state)
+		return;
+
+	rxerr = in_8(&regs->canrxerr);
+	txerr = in_8(&regs->cantxerr);
+
+	switch (state) {
+	case CAN_STATE_ERROR_WARNING:
+		frame->can_id |= CAN_ERR_CRTL;
+		frame->data[1] |= (txerr > rxerr) ? CAN_ERR_CRTL_TX_WARNING :
+			CAN_ERR_CRTL_RX_WARNING;
+		priv->can.can_stats.error_warning++;
+		break;
+	case CAN_STATE_ERROR_PASSIVE:
+		frame->can_id |= CAN_ERR_CRTL;
+		frame->data[1] |= (txerr > rxerr) ? CAN_ERR_CRTL_TX_PASSIVE :
+			CAN_ERR_CRTL_RX_PASSIVE;
+		priv->can.can_stats.error_passive++;
+		break;
+	case CAN_STATE_BUS_OFF:
+		frame->can_id |= CAN_ERR_BUSOFF;
+		/* Hold the controller off the bus until restarted */
+		mscan_stop(dev);
+		netif_stop_queue(dev);
+		can_bus_off(dev);
+		break;
+	default:
+		break;
+	}
+	priv->can.state = state;
+}
+
+static int mscan_rx_poll(struct napi_struct *napi, int quota)
+{
+	struct mscan_priv *priv = container_of(napi, struct mscan_priv, napi);
+	struct net_device *dev = priv->dev;
+	struct mscan_regs __iomem *regs = priv->reg_base;
+	struct net_device_stats *stats = &dev->stats;
+	struct can_frame *frame;
+	struct sk_buff *skb;
+	int npackets = 0;
+	u8 canrflg;
+
+	while (npackets < quota) {
+		canrflg = in_8(&regs->canrflg);
+		if (!(canrflg & (MSCAN_RXF | MSCAN_CSCIF | MSCAN_OVRIF)))
+			break;
+
+		skb = dev_alloc_skb(sizeof(struct can_frame));
+		if (!skb) {
+			if (printk_ratelimit())
+				dev_notice(dev->dev.parent, "no memory for "
+					   "skb, frame dropped\n");
+			stats->rx_dropped++;
+			out_8(&regs->canrflg, canrflg & MSCAN_RFLG_EVENTS);
+			npackets++;
+			continue;
+		}
+		skb->dev = dev;
+		skb->protocol = htons(ETH_P_CAN);
+		frame = (struct can_frame *)skb_put(skb, sizeof(*frame));
+		memset(frame, 0, sizeof(*frame));
+
+		if (canrflg & MSCAN_RXF) {
+			mscan_get_rx_frame(regs, frame);
+			stats->rx_packets++;
+			stats->rx_bytes += frame->can_dlc;
+			out_8(&regs->canrflg, MSCAN_RXF);
+		} else {
+			mscan_get_err_frame(dev, frame, canrflg);
+			stats->rx_packets++;
+			stats->rx_bytes += frame->can_dlc;
+			out_8(&regs->canrflg, canrflg &
+			      (MSCAN_CSCIF | MSCAN_OVRIF));
+		}
+
+		netif_receive_skb(skb);
+		npackets++;
+	}
+
+	if (npackets < quota) {
+		napi_complete(napi);
+		if (priv->can.state != CAN_STATE_BUS_OFF)
+			out_8(&regs->canrier, MSCAN_RX_INTS);
+	}
+
+	dev->last_rx = jiffies;
+	return npackets;
+}
+
+static irqreturn_t mscan_isr(int irq, void *dev_id)
+{
+	struct net_device *dev = dev_id;
+	struct mscan_priv *priv = netdev_priv(dev);
+	struct mscan_regs __iomem *regs = priv->reg_base;
+	irqreturn_t ret = IRQ_NONE;
+	u8 done;
+	int i;
+
+	spin_lock(&priv->lock);
+	done = in_8(&regs->cantflg) & priv->tx_active;
+	if (done) {
+		for (i = 0; i < MSCAN_TX_BUFS; i++) {
+			if (!(done & (1 << i)))
+				continue;
+			dev->stats.tx_packets++;
+			can_get_echo_skb(dev, i);
+		}
+		priv->tx_active &= ~done;
+		out_8(&regs->cantier, priv->tx_active);
+		if (priv->can.state != CAN_STATE_BUS_OFF &&
+		    !priv->filter_pending)
+			netif_wake_queue(dev);
+		ret = IRQ_HANDLED;
+	}
+	spin_unlock(&priv->lock);
+
+	if (in_8(&regs->canrier) &&
+	    (in_8(&regs->canrflg) & (MSCAN_RXF | MSCAN_CSCIF | MSCAN_OVRIF))) {
+		/* mscan_rx_poll() takes over until it runs dry */
+		out_8(&regs->canrier, 0);
+		napi_schedule(&priv->napi);
+		ret = IRQ_HANDLED;
+	}
+
+	return ret;
+}
+
+static int mscan_do_set_mode(struct net_device *dev, enum can_mode mode)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+	unsigned long flags;
+	int err;
+
+	switch (mode) {
+	case CAN_MODE_START:
+		err = mscan_start(dev);
+		if (err)
+			return err;
+		spin_lock_irqsave(&priv->lock, flags);
+		if (netif_queue_stopped(dev) && !priv->filter_pending)
+			netif_wake_queue(dev);
+		spin_unlock_irqrestore(&priv->lock, flags);
+		break;
+
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static int mscan_open(struct net_device *dev)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+	int err;
+
+	/* common open */
+	err = open_candev(dev);
+	if (err)
+		return err;
+
+	err = request_irq(dev->irq, mscan_isr, 0, dev->name, dev);
+	if (err) {
+		dev_err(dev->dev.parent, "failed to attach interrupt\n");
+		goto exit_close;
+	}
+
+	mscan_calc_filter(dev, &priv->filter);
+	napi_enable(&priv->napi);
+
+	err = mscan_start(dev);
+	if (err)
+		goto exit_free_irq;
+
+	netif_start_queue(dev);
+
+	return 0;
+
+ exit_free_irq:
+	napi_disable(&priv->napi);
+	free_irq(dev->irq, dev);
+ exit_close:
+	close_candev(dev);
+	return err;
+}
+
+static int mscan_close(struct net_device *dev)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+
+	netif_stop_queue(dev);
+	cancel_work_sync(&priv->filter_work);
+	napi_disable(&priv->napi);
+
+	mscan_stop(dev);
+	free_irq(dev->irq, dev);
+
+	close_candev(dev);
+
+	return 0;
+}
+
+static const struct net_device_ops mscan_netdev_ops = {
+	.ndo_open		= mscan_open,
+	.ndo_stop		= mscan_close,
+	.ndo_start_xmit		= mscan_start_xmit,
+	.ndo_set_rx_mode	= mscan_set_rx_mode,
+};
+
+int register_mscandev(struct net_device *dev, int clock_src)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+	struct mscan_regs __iomem *regs = priv->reg_base;
+
+	priv->clksrc = clock_src ? MSCAN_CLKSRC : 0;
+
+	/* The controller comes out of reset in init mode; enable it and
+	 * keep it there until the device is opened */
+	out_8(&regs->canctl1, MSCAN_CANE | priv->clksrc);
+	udelay(100);
+	mscan_enter_init(regs);
+	out_8(&regs->canidac, MSCAN_IDAM_CLOSED);
+
+	return register_candev(dev);
+}
+
+void unregister_mscandev(struct net_device *dev)
+{
+	struct mscan_priv *priv = netdev_priv(dev);
+
+	unregister_candev(dev);
+	mscan_enter_init(priv->reg_base);
+	clrbits8(&priv->reg_base->canctl1, MSCAN_CANE);
+}
+
+struct net_device *alloc_mscandev(void)
+{
+	struct net_device *dev;
+	struct mscan_priv *priv;
+
+	dev = alloc_candev(sizeof(struct mscan_priv));
+	if (!dev)
+		return NULL;
+	priv = netdev_priv(dev);
+
+	dev->netdev_ops = &mscan_netdev_ops;
+	dev->flags |= IFF_ECHO;	/* we support local echo */
+
+	priv->dev = dev;
+	spin_lock_init(&priv->lock);
+	INIT_WORK(&priv->filter_work, mscan_filter_work);
+	netif_napi_add(dev, &priv->napi, mscan_rx_poll, MSCAN_NAPI_WEIGHT);
+
+	priv->can.bittiming_const = &mscan_bittiming_const;
+	priv->can.do_set_bittiming = mscan_set_bittiming;
+	priv->can.do_set_mode = mscan_do_set_mode;
+
+	return dev;
+}
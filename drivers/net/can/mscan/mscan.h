@@ -0,0 +1,189 @@
+/*
+ * Definitions of the Freescale MSCAN controller
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the version 2 of the GNU General Public License
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MSCAN_H__
+#define __MSCAN_H__
+
+#include <linux/types.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/netdevice.h>
+#include <linux/can/dev.h>
+
+/* MSCAN control register 0 (CANCTL0) bits */
+#define MSCAN_RXFRM		0x80
+#define MSCAN_RXACT		0x40
+#define MSCAN_CSWAI		0x20
+#define MSCAN_SYNCH		0x10
+#define MSCAN_TIME		0x08
+#define MSCAN_WUPE		0x04
+#define MSCAN_SLPRQ		0x02
+#define MSCAN_INITRQ		0x01
+
+/* MSCAN control register 1 (CANCTL1) bits */
+#define MSCAN_CANE		0x80
+#define MSCAN_CLKSRC		0x40	/* 1: IP bus clock, 0: oscillator */
+#define MSCAN_LOOPB		0x20
+#define MSCAN_LISTEN		0x10
+#define MSCAN_BORM		0x08
+#define MSCAN_WUPM		0x04
+#define MSCAN_SLPAK		0x02
+#define MSCAN_INITAK		0x01
+
+/* MSCAN bus timing register 1 (CANBTR1) bits */
+#define MSCAN_SAMP		0x80
+
+/* MSCAN receiver flag register (CANRFLG) bits */
+#define MSCAN_WUPIF		0x80
+#define MSCAN_CSCIF		0x40
+#define MSCAN_RSTAT_MSK		0x30
+#define MSCAN_TSTAT_MSK		0x0c
+#define MSCAN_OVRIF		0x02
+#define MSCAN_RXF		0x01
+#define MSCAN_RFLG_EVENTS	(MSCAN_WUPIF | MSCAN_CSCIF | MSCAN_OVRIF | \
+				 MSCAN_RXF)
+
+/* RSTAT/TSTAT values, shifted down */
+#define MSCAN_STATE_OK		0
+#define MSCAN_STATE_WARNING	1
+#define MSCAN_STATE_PASSIVE	2
+#define MSCAN_STATE_BUS_OFF	3
+
+/* MSCAN receiver interrupt enable register (CANRIER) bits */
+#define MSCAN_WUPIE		0x80
+#define MSCAN_CSCIE		0x40
+#define MSCAN_RSTATE_ALL	0x30
+#define MSCAN_TSTATE_ALL	0x0c
+#define MSCAN_OVRIE		0x02
+#define MSCAN_RXFIE		0x01
+#define MSCAN_RX_INTS		(MSCAN_CSCIE | MSCAN_RSTATE_ALL | \
+				 MSCAN_TSTATE_ALL | MSCAN_OVRIE | MSCAN_RXFIE)
+
+/* MSCAN transmitter flag/interrupt enable/buffer select bits */
+#define MSCAN_TX_BUFS		3
+#define MSCAN_TXE		((1 << MSCAN_TX_BUFS) - 1)
+
+/* MSCAN identifier acceptance control register (CANIDAC) bits */
+#define MSCAN_IDAM_32BIT	0x00
+#define MSCAN_IDAM_16BIT	0x10
+#define MSCAN_IDAM_8BIT		0x20
+#define MSCAN_IDAM_CLOSED	0x30
+
+/*
+ * The four identifier registers of a message buffer read as one 32 bit
+ * value (IDR0 in the top byte).  The same layout is used by the acceptance
+ * filters in 32 bit mode, where a set mask bit means "don't care".
+ */
+#define MSCAN_ID32_SFF_SHIFT	21
+#define MSCAN_ID32_SFF_RTR	0x00100000
+#define MSCAN_ID32_SRR		0x00100000
+#define MSCAN_ID32_IDE		0x00080000
+#define MSCAN_ID32_EFF_RTR	0x00000001
+
+/*
+ * MSCAN register layout of the MPC5200: the 8 bit registers of the generic
+ * MSCAN are laid out in pairs, one pair per 32 bit word.
+ */
+struct mscan_regs {
+	u8 canctl0;			/* + 0x00 */
+	u8 canctl1;			/* + 0x01 */
+	u8 reserved_1[2];
+	u8 canbtr0;			/* + 0x04 */
+	u8 canbtr1;			/* + 0x05 */
+	u8 reserved_2[2];
+	u8 canrflg;			/* + 0x08 */
+	u8 canrier;			/* + 0x09 */
+	u8 reserved_3[2];
+	u8 cantflg;			/* + 0x0c */
+	u8 cantier;			/* + 0x0d */
+	u8 reserved_4[2];
+	u8 cantarq;			/* + 0x10 */
+	u8 cantaak;			/* + 0x11 */
+	u8 reserved_5[2];
+	u8 cantbsel;			/* + 0x14 */
+	u8 canidac;			/* + 0x15 */
+	u8 reserved_6[2];
+	u8 reserved_7;			/* + 0x18 */
+	u8 canmisc;			/* + 0x19 */
+	u8 reserved_8[2];
+	u8 canrxerr;			/* + 0x1c */
+	u8 cantxerr;			/* + 0x1d */
+	u8 reserved_9[2];
+	struct {
+		u16 ar;			/* IDARn, IDARn+1 */
+		u8 reserved_a[2];
+		u16 ar2;		/* IDARn+2, IDARn+3 */
+		u8 reserved_b[2];
+		u16 mr;			/* IDMRn, IDMRn+1 */
+		u8 reserved_c[2];
+		u16 mr2;		/* IDMRn+2, IDMRn+3 */
+		u8 reserved_d[2];
+	} filter[2];			/* + 0x20, + 0x30 */
+	struct mscan_buf {
+		u16 idr1_0;		/* + 0x00 */
+		u8 reserved_1[2];
+		u16 idr3_2;		/* + 0x04 */
+		u8 reserved_2[2];
+		u16 dsr[8];		/* + 0x08, bytes 2n, 2n+1 in dsr[2n] */
+		u8 dlr;			/* + 0x18 */
+		u8 tbpr;		/* + 0x19, tx buffer only */
+		u8 reserved_3[2];
+		u16 time;		/* + 0x1c */
+		u8 reserved_4[2];
+	} rx, tx;			/* + 0x40, + 0x60 */
+} __attribute__ ((packed));
+
+/* Acceptance filter setup, kept while the controller is down */
+struct mscan_filter {
+	u8 idac;
+	u32 ar[2];
+	u32 mr[2];
+};
+
+/**
+ * struct mscan_priv - MSCAN driver private data
+ * @can: common CAN device data; must come first
+ * @dev: the network device
+ * @reg_base: the controller registers
+ * @clksrc: MSCAN_CLKSRC if the IP bus clock drives the controller
+ * @lock: protects the transmit side and the registers it uses
+ * @tx_active: mask of transmit buffers in flight
+ * @tx_prio: local priority of the frame in each transmit buffer
+ * @filter_pending: @filter_work is draining the transmit buffers, keep
+ *                  the queue stopped
+ * @napi: receive polling
+ * @filter: acceptance filters programmed into the hardware
+ * @filter_work: reprograms @filter after the CAN receivers changed
+ */
+struct mscan_priv {
+	struct can_priv can;
+	struct net_device *dev;
+	struct mscan_regs __iomem *reg_base;
+	u8 clksrc;
+
+	spinlock_t lock;
+	u8 tx_active;
+	u8 tx_prio[MSCAN_TX_BUFS];
+	u8 filter_pending;
+
+	struct napi_struct napi;
+
+	struct mscan_filter filter;
+	struct work_struct filter_work;
+};
+
+extern struct net_device *alloc_mscandev(void);
+extern int register_mscandev(struct net_device *dev, int clock_src);
+extern void unregister_mscandev(struct net_device *dev);
+
+#endif /* __MSCAN_H__ */
@@ -32,6 +32,7 @@
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
 #include <linux/skbuff.h>
+#include <linux/workqueue.h>
 
 #include <asm/io.h>
 #include <asm/delay.h>
@@ -54,9 +55,24 @@ struct mpc52xx_fec_priv {
 	struct mpc52xx_fec __iomem *fec;
 	struct bcom_task *rx_dmatsk;
 	struct bcom_task *tx_dmatsk;
-	spinlock_t lock;
 	int msg_enable;
 
+	/* RX processing and TX reclaim are done in softirq context from the
+	 * NAPI poll.  The TX ring is single producer (start_xmit) / single
+	 * consumer (poll) and needs no lock. */
+	struct napi_struct napi;
+
+	/* Set while the BestComm task interrupts are masked for NAPI */
+	int irqs_masked;
+
+	/* FIFO error and TX timeout recovery, see mpc52xx_fec_reset_task() */
+	struct work_struct reset_task;
+
+	/* TX completed skbs kept for reuse as RX buffers.  Only used from
+	 * the NAPI poll, or with NAPI disabled (open, close, reset), hence
+	 * the unlocked queue operations. */
+	struct sk_buff_head rx_recycle;
+
 	/* MDIO link details */
 	unsigned int mdio_speed;
 	struct device_node *phy_node;
@@ -83,15 +99,23 @@ static int debug = -1;	/* the above default */
 module_param(debug, int, 0);
 MODULE_PARM_DESC(debug, "debugging messages level");
 
+static int napi_weight = FEC_NAPI_WEIGHT;
+module_param(napi_weight, int, 0444);
+MODULE_PARM_DESC(napi_weight, "max number of frames received per NAPI poll");
+
+static int copybreak = FEC_RX_COPYBREAK;
+module_param(copybreak, int, 0644);
+MODULE_PARM_DESC(copybreak, "frames up to this size are copied out of the DMA buffer");
+
 static void mpc52xx_fec_tx_timeout(struct net_device *dev)
 {
-	dev_warn(&dev->dev, "transmit timed out\n");
+	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
 
-	mpc52xx_fec_reset(dev);
+	dev_warn(&dev->dev, "transmit timed out\n");
 
 	dev->stats.tx_errors++;
 
-	netif_wake_queue(dev);
+	schedule_work(&priv->reset_task);
 }
 
 static void mpc52xx_fec_set_paddr(struct net_device *dev, u8 *mac)
@@ -135,13 +159,42 @@ static void mpc52xx_fec_free_rx_buffers(struct net_device *dev, struct bcom_task
 	}
 }
 
+/* Get a receive buffer, preferably one recycled from the TX path.
+ * NAPI context or NAPI disabled, see struct mpc52xx_fec_priv. */
+static struct sk_buff *mpc52xx_fec_rx_skb(struct mpc52xx_fec_priv *priv)
+{
+	struct sk_buff *skb;
+
+	skb = __skb_dequeue(&priv->rx_recycle);
+	if (!skb)
+		skb = dev_alloc_skb(FEC_RX_BUFFER_SIZE);
+
+	return skb;
+}
+
+/* Hand a still mapped receive buffer back to BestComm */
+static void mpc52xx_fec_rx_requeue(struct mpc52xx_fec_priv *priv,
+		struct sk_buff *skb, dma_addr_t skb_pa)
+{
+	struct bcom_fec_bd *bd;
+
+	bd = (struct bcom_fec_bd *)bcom_prepare_next_buffer(priv->rx_dmatsk);
+
+	bd->status = FEC_RX_BUFFER_SIZE;
+	bd->skb_pa = skb_pa;
+
+	bcom_submit_next_buffer(priv->rx_dmatsk, skb);
+}
+
 static int mpc52xx_fec_alloc_rx_buffers(struct net_device *dev, struct bcom_task *rxtsk)
 {
+	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
+
 	while (!bcom_queue_full(rxtsk)) {
 		struct sk_buff *skb;
 		struct bcom_fec_bd *bd;
 
-		skb = dev_alloc_skb(FEC_RX_BUFFER_SIZE);
+		skb = mpc52xx_fec_rx_skb(priv);
 		if (skb == NULL)
 			return -EAGAIN;
 
@@ -251,6 +304,9 @@ static int mpc52xx_fec_open(struct net_device *dev)
 		goto free_irqs;
 	}
 
+	priv->irqs_masked = 0;
+	napi_enable(&priv->napi);
+
 	bcom_enable(priv->rx_dmatsk);
 	bcom_enable(priv->tx_dmatsk);
 
@@ -282,9 +338,15 @@ static int mpc52xx_fec_close(struct net_device *dev)
 
 	netif_stop_queue(dev);
 
+	cancel_work_sync(&priv->reset_task);
+
 	mpc52xx_fec_stop(dev);
 
+	bcom_coalesce_cancel(priv->rx_dmatsk);
+	napi_disable(&priv->napi);
+
 	mpc52xx_fec_free_rx_buffers(dev, priv->rx_dmatsk);
+	skb_queue_purge(&priv->rx_recycle);
 
 	free_irq(dev->irq, dev);
 	free_irq(priv->r_irq, dev);
@@ -316,23 +378,28 @@ static int mpc52xx_fec_start_xmit(struct sk_buff *skb, struct net_device *dev)
 		return NETDEV_TX_BUSY;
 	}
 
-	spin_lock_irq(&priv->lock);
 	dev->trans_start = jiffies;
 
+	/* No NETIF_F_SG, so the frame is linear and takes a single BD */
 	bd = (struct bcom_fec_bd *)
-		bcom_prepare_next_buffer(priv->tx_dmatsk);
+		bcom_prepare_buffer(priv->tx_dmatsk, 0);
 
 	bd->status = skb->len | BCOM_FEC_TX_BD_TFD | BCOM_FEC_TX_BD_TC;
 	bd->skb_pa = dma_map_single(dev->dev.parent, skb->data, skb->len,
 				    DMA_TO_DEVICE);
 
-	bcom_submit_next_buffer(priv->tx_dmatsk, skb);
+	/* Only kicks the task if it ran out of work */
+	bcom_submit_buffers_lazy(priv->tx_dmatsk, 1, skb);
 
 	if (bcom_queue_full(priv->tx_dmatsk)) {
 		netif_stop_queue(dev);
-	}
 
-	spin_unlock_irq(&priv->lock);
+		/* The reclaim may have freed BDs before it could see the
+		 * queue stopped; restart it ourselves in that case. */
+		smp_mb();
+		if (bcom_queue_space(priv->tx_dmatsk) >= FEC_TX_WAKE_THRESHOLD)
+			netif_start_queue(dev);
+	}
 
 	return NETDEV_TX_OK;
 }
@@ -352,80 +419,169 @@ static void mpc52xx_fec_poll_controller(struct net_device *dev)
 #endif
 
 
+/* Both BestComm task interrupts are masked while NAPI is scheduled and
+ * unmasked again by the poll routine once all work is done.
+ */
+static void mpc52xx_fec_napi_schedule(struct net_device *dev)
+{
+	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
+
+	if (napi_schedule_prep(&priv->napi)) {
+		/* Still masked during a coalescing holdoff, when netpoll may
+		 * call us; the poll unmasks only once */
+		if (!priv->irqs_masked) {
+			disable_irq_nosync(priv->r_irq);
+			disable_irq_nosync(priv->t_irq);
+			priv->irqs_masked = 1;
+		}
+		__napi_schedule(&priv->napi);
+	}
+}
+
 /* This handles BestComm transmit task interrupts
  */
 static irqreturn_t mpc52xx_fec_tx_interrupt(int irq, void *dev_id)
 {
-	struct net_device *dev = dev_id;
-	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
+	mpc52xx_fec_napi_schedule(dev_id);
+
+	return IRQ_HANDLED;
+}
 
-	spin_lock(&priv->lock);
+/* This handles BestComm receive task interrupts
+ */
+static irqreturn_t mpc52xx_fec_rx_interrupt(int irq, void *dev_id)
+{
+	mpc52xx_fec_napi_schedule(dev_id);
+
+	return IRQ_HANDLED;
+}
+
+/* Release the skbs of all transmitted frames and restart the queue once
+ * enough descriptors are available again.
+ */
+static int mpc52xx_fec_tx_reclaim(struct net_device *dev)
+{
+	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
+	int done = 0;
 
 	while (bcom_buffer_done(priv->tx_dmatsk)) {
 		struct sk_buff *skb;
 		struct bcom_fec_bd *bd;
 		skb = bcom_retrieve_buffer(priv->tx_dmatsk, NULL,
 				(struct bcom_bd **)&bd);
+
 		dma_unmap_single(dev->dev.parent, bd->skb_pa, skb->len,
 				 DMA_TO_DEVICE);
 
-		dev_kfree_skb_irq(skb);
+		if (skb_queue_len(&priv->rx_recycle) < FEC_RX_NUM_BD &&
+		    skb_recycle_check(skb, FEC_RX_BUFFER_SIZE))
+			__skb_queue_head(&priv->rx_recycle, skb);
+		else
+			dev_kfree_skb(skb);
+		done++;
 	}
 
-	netif_wake_queue(dev);
-
-	spin_unlock(&priv->lock);
+	/* Pairs with the barrier in mpc52xx_fec_start_xmit() */
+	smp_mb();
+	if (unlikely(netif_queue_stopped(dev)) &&
+	    bcom_queue_space(priv->tx_dmatsk) >= FEC_TX_WAKE_THRESHOLD)
+		netif_wake_queue(dev);
 
-	return IRQ_HANDLED;
+	return done;
 }
 
-static irqreturn_t mpc52xx_fec_rx_interrupt(int irq, void *dev_id)
+/* End of an interrupt coalescing holdoff; the task interrupts are still
+ * masked from the previous poll */
+static void mpc52xx_fec_coalesce_expire(void *data)
 {
-	struct net_device *dev = dev_id;
+	struct net_device *dev = data;
 	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
 
-	while (bcom_buffer_done(priv->rx_dmatsk)) {
+	napi_schedule(&priv->napi);
+}
+
+static int mpc52xx_fec_rx_poll(struct napi_struct *napi, int budget)
+{
+	struct mpc52xx_fec_priv *priv =
+		container_of(napi, struct mpc52xx_fec_priv, napi);
+	struct net_device *dev = priv->ndev;
+	int work_done = 0;
+	int tx_done;
+
+	tx_done = mpc52xx_fec_tx_reclaim(dev);
+
+	while (work_done < budget && bcom_buffer_done(priv->rx_dmatsk)) {
 		struct sk_buff *skb;
 		struct sk_buff *rskb;
 		struct bcom_fec_bd *bd;
+		dma_addr_t skb_pa;
 		u32 status;
+		int length;
 
 		rskb = bcom_retrieve_buffer(priv->rx_dmatsk, &status,
 				(struct bcom_bd **)&bd);
-		dma_unmap_single(dev->dev.parent, bd->skb_pa, rskb->len,
-				 DMA_FROM_DEVICE);
+		skb_pa = bd->skb_pa;
+		work_done++;
 
 		/* Test for errors in received frame */
 		if (status & BCOM_FEC_RX_BD_ERRORS) {
-			/* Drop packet and reuse the buffer */
-			bd = (struct bcom_fec_bd *)
-				bcom_prepare_next_buffer(priv->rx_dmatsk);
+			/* Drop packet and reuse the buffer.  The CPU never
+			 * touched it, so it can go back without a remap. */
+			mpc52xx_fec_rx_requeue(priv, rskb, skb_pa);
 
-			bd->status = FEC_RX_BUFFER_SIZE;
-			bd->skb_pa = dma_map_single(dev->dev.parent,
-					rskb->data,
-					FEC_RX_BUFFER_SIZE, DMA_FROM_DEVICE);
+			dev->stats.rx_dropped++;
+
+			continue;
+		}
 
-			bcom_submit_next_buffer(priv->rx_dmatsk, rskb);
+		length = (status & BCOM_FEC_RX_BD_LEN_MASK) - 4; /* without CRC32 */
+
+		/* Small frames are copied to a right-sized skb, and the DMA
+		 * buffer goes straight back to BestComm with only the cache
+		 * lines we read invalidated again. */
+		if (length <= copybreak) {
+			skb = netdev_alloc_skb(dev, length + NET_IP_ALIGN);
+			if (skb) {
+				skb_reserve(skb, NET_IP_ALIGN);
+
+				dma_sync_single_for_cpu(dev->dev.parent, skb_pa,
+						length, DMA_FROM_DEVICE);
+				skb_copy_to_linear_data(skb, rskb->data, length);
+				dma_sync_single_for_device(dev->dev.parent,
+						skb_pa, length, DMA_FROM_DEVICE);
+			} else {
+				dev_notice(&dev->dev, "Memory squeeze, dropping packet.\n");
+				dev->stats.rx_dropped++;
+			}
 
-			dev->stats.rx_dropped++;
+			mpc52xx_fec_rx_requeue(priv, rskb, skb_pa);
+
+			if (skb) {
+				skb_put(skb, length);
+				skb->protocol = eth_type_trans(skb, dev);
+				napi_gro_receive(napi, skb);
+			}
 
 			continue;
 		}
 
 		/* skbs are allocated on open, so now we allocate a new one,
 		 * and remove the old (with the packet) */
-		skb = dev_alloc_skb(FEC_RX_BUFFER_SIZE);
+		skb = mpc52xx_fec_rx_skb(priv);
 		if (skb) {
 			/* Process the received skb */
-			int length = status & BCOM_FEC_RX_BD_LEN_MASK;
+			dma_unmap_single(dev->dev.parent, skb_pa,
+					FEC_RX_BUFFER_SIZE, DMA_FROM_DEVICE);
 
-			skb_put(rskb, length - 4);	/* length without CRC32 */
+			skb_put(rskb, length);
 
 			rskb->dev = dev;
 			rskb->protocol = eth_type_trans(rskb, dev);
 
-			netif_rx(rskb);
+			napi_gro_receive(napi, rskb);
+
+			skb_pa = dma_map_single(dev->dev.parent, skb->data,
+					FEC_RX_BUFFER_SIZE, DMA_FROM_DEVICE);
 		} else {
 			/* Can't get a new one : reuse the same & drop pkt */
 			dev_notice(&dev->dev, "Memory squeeze, dropping packet.\n");
@@ -434,17 +590,27 @@ static irqreturn_t mpc52xx_fec_rx_interrupt(int irq, void *dev_id)
 			skb = rskb;
 		}
 
-		bd = (struct bcom_fec_bd *)
-			bcom_prepare_next_buffer(priv->rx_dmatsk);
-
-		bd->status = FEC_RX_BUFFER_SIZE;
-		bd->skb_pa = dma_map_single(dev->dev.parent, skb->data,
-				FEC_RX_BUFFER_SIZE, DMA_FROM_DEVICE);
+		mpc52xx_fec_rx_requeue(priv, skb, skb_pa);
+	}
 
-		bcom_submit_next_buffer(priv->rx_dmatsk, skb);
+	/* Ring drained: leave polling mode and let the tasks interrupt
+	 * us again.  A BD completed in between leaves its IntPend bit
+	 * set, so the unmask below re-raises the interrupt. */
+	if (work_done < budget) {
+		napi_complete(napi);
+
+		/* Under load, stay masked and come back after a holdoff */
+		if ((bcom_coalesce_due(priv->rx_dmatsk, work_done) ||
+		     bcom_coalesce_due(priv->tx_dmatsk, tx_done)) &&
+		    bcom_coalesce_holdoff(priv->rx_dmatsk))
+			return work_done;
+
+		priv->irqs_masked = 0;
+		enable_irq(priv->r_irq);
+		enable_irq(priv->t_irq);
 	}
 
-	return IRQ_HANDLED;
+	return work_done;
 }
 
 static irqreturn_t mpc52xx_fec_interrupt(int irq, void *dev_id)
@@ -470,9 +636,7 @@ static irqreturn_t mpc52xx_fec_interrupt(int irq, void *dev_id)
 		if (net_ratelimit() && (ievent & FEC_IEVENT_XFIFO_ERROR))
 			dev_warn(&dev->dev, "FEC_IEVENT_XFIFO_ERROR\n");
 
-		mpc52xx_fec_reset(dev);
-
-		netif_wake_queue(dev);
+		schedule_work(&priv->reset_task);
 		return IRQ_HANDLED;
 	}
 
@@ -743,7 +907,7 @@ static void mpc52xx_fec_stop(struct net_device *dev)
 	out_be32(&fec->ecntrl, in_be32(&fec->ecntrl) & ~FEC_ECNTRL_ETHER_EN);
 }
 
-/* reset fec and bestcomm tasks */
+/* reset fec and bestcomm tasks, with NAPI disabled and the TX lock held */
 static void mpc52xx_fec_reset(struct net_device *dev)
 {
 	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
@@ -775,6 +939,36 @@ static void mpc52xx_fec_reset(struct net_device *dev)
 	mpc52xx_fec_start(dev);
 }
 
+/* The reset touches the BestComm tasks and rings that start_xmit and the
+ * NAPI poll work on without a lock, and the PHY, which may sleep.  So it
+ * runs here, in process context, with both of them shut out.
+ */
+static void mpc52xx_fec_reset_task(struct work_struct *work)
+{
+	struct mpc52xx_fec_priv *priv =
+		container_of(work, struct mpc52xx_fec_priv, reset_task);
+	struct net_device *dev = priv->ndev;
+
+	if (!netif_running(dev))
+		return;
+
+	napi_disable(&priv->napi);
+	bcom_coalesce_cancel(priv->rx_dmatsk);
+	netif_tx_lock_bh(dev);
+
+	mpc52xx_fec_reset(dev);
+
+	netif_tx_unlock_bh(dev);
+	napi_enable(&priv->napi);
+
+	/* A holdoff cut short left the task interrupts masked; the poll
+	 * unmasks them */
+	if (priv->irqs_masked)
+		napi_schedule(&priv->napi);
+
+	netif_wake_queue(dev);
+}
+
 
 /* ethtool interface */
 static void mpc52xx_fec_get_drvinfo(struct net_device *dev,
@@ -815,6 +1009,53 @@ static void mpc52xx_fec_set_msglevel(struct net_device *dev, u32 level)
 	priv->msg_enable = level;
 }
 
+/*
+ * Interrupt coalescing.  rx-usecs is the holdoff period of the BestComm
+ * tasks, entered when a poll finds at least rx-frames received or
+ * tx-frames transmitted buffers.  RX and TX share one NAPI context and
+ * one timer, so there is no separate tx-usecs.
+ */
+static int mpc52xx_fec_get_coalesce(struct net_device *dev,
+		struct ethtool_coalesce *ec)
+{
+	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
+
+	memset(ec, 0, sizeof(*ec));
+	ec->rx_coalesce_usecs = priv->rx_dmatsk->coal_usecs;
+	ec->rx_max_coalesced_frames = priv->rx_dmatsk->coal_bds;
+	ec->tx_max_coalesced_frames = priv->tx_dmatsk->coal_bds;
+
+	return 0;
+}
+
+static int mpc52xx_fec_set_coalesce(struct net_device *dev,
+		struct ethtool_coalesce *ec)
+{
+	struct mpc52xx_fec_priv *priv = netdev_priv(dev);
+	unsigned int rx_frames = 0, tx_frames = 0;
+	int rv;
+
+	if (ec->tx_coalesce_usecs)
+		return -EINVAL;
+
+	/* Frame thresholds are meaningless without a holdoff period */
+	if (ec->rx_coalesce_usecs) {
+		rx_frames = max(ec->rx_max_coalesced_frames, 1u);
+		tx_frames = ec->tx_max_coalesced_frames;
+	}
+
+	rv = bcom_set_coalesce(priv->rx_dmatsk, rx_frames,
+			       ec->rx_coalesce_usecs);
+	if (rv)
+		return rv;
+
+	rv = bcom_set_coalesce(priv->tx_dmatsk, tx_frames, 0);
+	if (rv)
+		bcom_set_coalesce(priv->rx_dmatsk, 0, 0);
+
+	return rv;
+}
+
 static const struct ethtool_ops mpc52xx_fec_ethtool_ops = {
 	.get_drvinfo = mpc52xx_fec_get_drvinfo,
 	.get_settings = mpc52xx_fec_get_settings,
@@ -822,6 +1063,8 @@ static const struct ethtool_ops mpc52xx_fec_ethtool_ops = {
 	.get_link = ethtool_op_get_link,
 	.get_msglevel = mpc52xx_fec_get_msglevel,
 	.set_msglevel = mpc52xx_fec_set_msglevel,
+	.get_coalesce = mpc52xx_fec_get_coalesce,
+	.set_coalesce = mpc52xx_fec_set_coalesce,
 };
 
 
@@ -864,6 +1107,7 @@ mpc52xx_fec_probe(struct of_device *op, const struct of_device_id *match)
 	struct resource mem;
 	const u32 *prop;
 	int prop_size;
+	struct device_node *timer_node;
 
 	phys_addr_t rx_fifo;
 	phys_addr_t tx_fifo;
@@ -898,9 +1142,14 @@ mpc52xx_fec_probe(struct of_device *op, const struct of_device_id *match)
 	ndev->ethtool_ops	= &mpc52xx_fec_ethtool_ops;
 	ndev->watchdog_timeo	= FEC_WATCHDOG_TIMEOUT;
 	ndev->base_addr		= mem.start;
+	/* The FEC can't checksum, and the stack drops NETIF_F_SG without a
+	 * checksum feature, so no scatter-gather either. */
+	ndev->features		|= NETIF_F_GRO;
 	SET_NETDEV_DEV(ndev, &op->dev);
 
-	spin_lock_init(&priv->lock);
+	netif_napi_add(ndev, &priv->napi, mpc52xx_fec_rx_poll, napi_weight);
+	INIT_WORK(&priv->reset_task, mpc52xx_fec_reset_task);
+	skb_queue_head_init(&priv->rx_recycle);
 
 	/* ioremap the zones */
 	priv->fec = ioremap(mem.start, sizeof(struct mpc52xx_fec));
@@ -960,6 +1209,16 @@ mpc52xx_fec_probe(struct of_device *op, const struct of_device_id *match)
 	/* If there is a phy handle, then get the PHY node */
 	priv->phy_node = of_parse_phandle(op->node, "phy-handle", 0);
 
+	/* Optional GPT used to time interrupt coalescing holdoffs */
+	timer_node = of_parse_phandle(op->node, "fsl,coalesce-timer", 0);
+	if (timer_node) {
+		if (bcom_coalesce_attach(priv->rx_dmatsk, timer_node,
+					 mpc52xx_fec_coalesce_expire, ndev))
+			dev_warn(&ndev->dev, "can't use coalescing timer %s\n",
+				 timer_node->full_name);
+		of_node_put(timer_node);
+	}
+
 	/* the 7-wire property means don't use MII mode */
 	if (of_find_property(op->node, "fsl,7-wire-mode", NULL)) {
 		priv->seven_wire_mode = 1;
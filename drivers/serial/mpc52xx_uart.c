@@ -67,6 +67,7 @@
 #include <linux/device.h>
 #include <linux/module.h>
 #include <linux/tty.h>
+#include <linux/tty_flip.h>
 #include <linux/serial.h>
 #include <linux/sysrq.h>
 #include <linux/console.h>
@@ -78,6 +79,13 @@
 #include <asm/mpc52xx.h>
 #include <asm/mpc52xx_psc.h>
 
+#ifdef CONFIG_SERIAL_MPC52xx_DMA
+#include <linux/dma-mapping.h>
+#include <linux/hrtimer.h>
+#include <sysdev/bestcomm/bestcomm.h>
+#include <sysdev/bestcomm/gen_bd.h>
+#endif
+
 #if defined(CONFIG_SERIAL_MPC52xx_CONSOLE) && defined(CONFIG_MAGIC_SYSRQ)
 #define SUPPORT_SYSRQ
 #endif
@@ -415,6 +423,485 @@ static struct psc_ops mpc512x_psc_ops = {
 
 static struct psc_ops *psc_ops;
 
+/* ======================================================================== */
+/* BestComm DMA                                                             */
+/* ======================================================================== */
+
+#ifdef CONFIG_SERIAL_MPC52xx_DMA
+
+/*
+ * PSCs flagged with 'fsl,bestcomm-dma' in the device tree move their data
+ * with a pair of BestComm gen_bd tasks instead of per character FIFO
+ * accesses.  The console port always stays in PIO mode.
+ *
+ * The gen_bd rx task can't tell how much of a buffer it has filled, so a
+ * receive BD is only ever submitted for data the FIFO already holds: the
+ * RXRDY interrupt masks itself and the FIFO level is read, and once it
+ * reaches MPC52xx_UART_DMA_RX_THRESH that many whole words are queued into
+ * one of two ping-pong buffers.  While BestComm fills one buffer, the
+ * other is handed to the tty layer with tty_insert_flip_string().  While
+ * less than the threshold is in the FIFO, an hrtimer samples the FIFO
+ * level every MPC52xx_UART_DMA_IDLE_CHARS character times: data still
+ * arriving re-arms it until the threshold is reached, an idle line gets
+ * the FIFO flushed and RXRDY re-enabled.  The FIFO holds far more than
+ * arrives between two samples, so it can't overrun meanwhile.
+ *
+ * Transmit maps the contiguous part of the circ buffer and hands it to
+ * the tx task as a single BD.
+ */
+
+#define MPC52xx_UART_DMA_RX_BUFSIZE	512	/* FIFO size, bounds one BD */
+#define MPC52xx_UART_DMA_RX_THRESH	64
+#define MPC52xx_UART_DMA_IDLE_CHARS	4
+
+struct mpc52xx_uart_dma {
+	struct uart_port *port;
+	int active;
+	struct bcom_task *rx_task;
+	struct bcom_task *tx_task;
+	int rx_irq;
+	int tx_irq;
+
+	/* receive */
+	void *rx_buf[2];
+	dma_addr_t rx_buf_pa[2];
+	int rx_cur;			/* buffer of the last rx BD */
+	int rx_busy;			/* rx BD in flight */
+	ktime_t rx_timeout;		/* idle line time */
+	struct hrtimer rx_timer;
+	unsigned int rx_level;		/* FIFO level at the last sample */
+
+	/* transmit */
+	dma_addr_t tx_pa;
+	unsigned int tx_count;		/* bytes in flight, 0 if idle */
+};
+
+static struct mpc52xx_uart_dma *mpc52xx_uart_dma[MPC52xx_PSC_MAXNUM];
+
+static inline struct mpc52xx_uart_dma *
+mpc52xx_uart_dma_get(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma[port->line];
+
+	return (dma && dma->active) ? dma : NULL;
+}
+
+static inline int
+mpc52xx_uart_dma_active(struct uart_port *port)
+{
+	return mpc52xx_uart_dma_get(port) != NULL;
+}
+
+/* Hand a received chunk to the tty layer.  port->lock held */
+static void
+mpc52xx_uart_dma_rx_push(struct uart_port *port, const unsigned char *buf,
+			 unsigned int len)
+{
+	struct tty_struct *tty = port->info->port.tty;
+	unsigned short status;
+
+	port->icount.rx += len;
+	tty_insert_flip_string(tty, buf, len);
+
+	/* The characters of a chunk can't be told apart, so errors are
+	 * only accounted for */
+	status = in_be16(&PSC(port)->mpc52xx_psc_status);
+	if (status & (MPC52xx_PSC_SR_PE | MPC52xx_PSC_SR_FE |
+		      MPC52xx_PSC_SR_RB | MPC52xx_PSC_SR_OE)) {
+		if (status & MPC52xx_PSC_SR_RB) {
+			uart_handle_break(port);
+			port->icount.brk++;
+		} else if (status & MPC52xx_PSC_SR_PE)
+			port->icount.parity++;
+		else if (status & MPC52xx_PSC_SR_FE)
+			port->icount.frame++;
+		if (status & MPC52xx_PSC_SR_OE) {
+			tty_insert_flip_char(tty, 0, TTY_OVERRUN);
+			port->icount.overrun++;
+		}
+		out_8(&PSC(port)->command, MPC52xx_PSC_RST_ERR_STAT);
+	}
+
+	spin_unlock(&port->lock);
+	tty_flip_buffer_push(tty);
+	spin_lock(&port->lock);
+}
+
+/*
+ * Queue the data waiting in the FIFO, port->lock held and no rx BD in
+ * flight.  Unless flushing, less than MPC52xx_UART_DMA_RX_THRESH bytes
+ * are left for the idle timer.  A flush moves whatever is there and, once
+ * the FIFO is empty, returns the receiver to RXRDY interrupts.  RXRDY is
+ * never left masked without the idle timer running.
+ */
+static void
+mpc52xx_uart_dma_rx_kick(struct uart_port *port, int flush)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+	struct bcom_gen_bd *bd;
+	unsigned int n;
+
+	n = in_be16(&FIFO_52xx(port)->rfnum);
+	n = min(n, (unsigned int)MPC52xx_UART_DMA_RX_BUFSIZE);
+
+	if (n >= (flush ? 4 : MPC52xx_UART_DMA_RX_THRESH)) {
+		/* BestComm moves whole words */
+		n &= ~3;
+		dma->rx_cur ^= 1;
+		bd = (struct bcom_gen_bd *)
+			bcom_prepare_next_buffer(dma->rx_task);
+		bd->status = n;
+		bd->buf_pa = dma->rx_buf_pa[dma->rx_cur];
+		bcom_submit_next_buffer(dma->rx_task, (void *)(unsigned long)n);
+		bcom_enable(dma->rx_task);
+		dma->rx_busy = 1;
+		return;
+	}
+
+	if (!flush) {
+		dma->rx_level = n;
+		hrtimer_start(&dma->rx_timer, dma->rx_timeout,
+			      HRTIMER_MODE_REL);
+		return;
+	}
+
+	/* Line idle: pick up the odd last bytes and wait for the next ones */
+	if (n) {
+		struct tty_struct *tty = port->info->port.tty;
+
+		port->icount.rx += n;
+		while (n--)
+			tty_insert_flip_char(tty, psc_ops->read_char(port),
+					     TTY_NORMAL);
+		spin_unlock(&port->lock);
+		tty_flip_buffer_push(tty);
+		spin_lock(&port->lock);
+	}
+
+	port->read_status_mask |= MPC52xx_PSC_IMR_RXRDY;
+	out_be16(&PSC(port)->mpc52xx_psc_imr, port->read_status_mask);
+}
+
+/* RXRDY seen by the PSC interrupt handler.  port->lock held */
+static void
+mpc52xx_uart_dma_rx_int(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+
+	/* Stay off until the FIFO has been flushed again */
+	port->read_status_mask &= ~MPC52xx_PSC_IMR_RXRDY;
+	out_be16(&PSC(port)->mpc52xx_psc_imr, port->read_status_mask);
+
+	if (!dma->rx_busy)
+		mpc52xx_uart_dma_rx_kick(port, 0);
+}
+
+static enum hrtimer_restart
+mpc52xx_uart_dma_rx_timeout(struct hrtimer *timer)
+{
+	struct mpc52xx_uart_dma *dma =
+		container_of(timer, struct mpc52xx_uart_dma, rx_timer);
+	struct uart_port *port = dma->port;
+	unsigned long flags;
+	unsigned int n;
+
+	spin_lock_irqsave(&port->lock, flags);
+	if (dma->active && !dma->rx_busy) {
+		/* Still receiving: queue at the threshold, else sample again */
+		n = in_be16(&FIFO_52xx(port)->rfnum);
+		mpc52xx_uart_dma_rx_kick(port, n == dma->rx_level);
+	}
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+static irqreturn_t
+mpc52xx_uart_dma_rx_irq(int irq, void *dev_id)
+{
+	struct uart_port *port = dev_id;
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+	unsigned int len;
+	int cur;
+
+	spin_lock(&port->lock);
+
+	if (dma && bcom_buffer_done(dma->rx_task)) {
+		len = (unsigned long)
+			bcom_retrieve_buffer(dma->rx_task, NULL, NULL);
+		cur = dma->rx_cur;
+		dma->rx_busy = 0;
+
+		/* Get BestComm going on the other buffer first */
+		mpc52xx_uart_dma_rx_kick(port, 0);
+		mpc52xx_uart_dma_rx_push(port, dma->rx_buf[cur], len);
+	}
+
+	spin_unlock(&port->lock);
+
+	return IRQ_HANDLED;
+}
+
+/* Start sending the contiguous part of the circ buffer.  port->lock held */
+static void
+mpc52xx_uart_dma_start_tx(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+	struct circ_buf *xmit = &port->info->xmit;
+	struct bcom_gen_bd *bd;
+	unsigned int count;
+
+	if (!dma || dma->tx_count ||
+	    uart_circ_empty(xmit) || uart_tx_stopped(port))
+		return;
+
+	count = CIRC_CNT_TO_END(xmit->head, xmit->tail, UART_XMIT_SIZE);
+	dma->tx_pa = dma_map_single(port->dev, xmit->buf + xmit->tail,
+				    count, DMA_TO_DEVICE);
+	dma->tx_count = count;
+
+	bd = (struct bcom_gen_bd *)bcom_prepare_next_buffer(dma->tx_task);
+	bd->status = count;
+	bd->buf_pa = dma->tx_pa;
+	bcom_submit_next_buffer(dma->tx_task, NULL);
+	bcom_enable(dma->tx_task);
+}
+
+static irqreturn_t
+mpc52xx_uart_dma_tx_irq(int irq, void *dev_id)
+{
+	struct uart_port *port = dev_id;
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+	struct circ_buf *xmit = &port->info->xmit;
+
+	spin_lock(&port->lock);
+
+	if (dma && bcom_buffer_done(dma->tx_task)) {
+		bcom_retrieve_buffer(dma->tx_task, NULL, NULL);
+		dma_unmap_single(port->dev, dma->tx_pa, dma->tx_count,
+				 DMA_TO_DEVICE);
+		xmit->tail = (xmit->tail + dma->tx_count) &
+			     (UART_XMIT_SIZE - 1);
+		port->icount.tx += dma->tx_count;
+		dma->tx_count = 0;
+
+		if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS)
+			uart_write_wakeup(port);
+
+		mpc52xx_uart_dma_start_tx(port);
+	}
+
+	spin_unlock(&port->lock);
+
+	return IRQ_HANDLED;
+}
+
+/* Has BestComm finished with the transmit data ? */
+static int
+mpc52xx_uart_dma_tx_done(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+
+	return !dma || !dma->tx_count || bcom_buffer_done(dma->tx_task);
+}
+
+/* Stop receiving, e.g. before the receiver gets reset.  port->lock held */
+static void
+mpc52xx_uart_dma_rx_stop(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+
+	if (!dma)
+		return;
+
+	hrtimer_try_to_cancel(&dma->rx_timer);
+	bcom_gen_bd_rx_reset(dma->rx_task);
+	dma->rx_busy = 0;
+}
+
+/* (Re)start receiving from an empty FIFO.  port->lock held */
+static void
+mpc52xx_uart_dma_rx_start(struct uart_port *port)
+{
+	if (!mpc52xx_uart_dma_active(port))
+		return;
+
+	/* Raise the DMA request as soon as a word is in the FIFO */
+	out_be16(&FIFO_52xx(port)->rfalarm, MPC52xx_UART_DMA_RX_BUFSIZE - 4);
+
+	port->read_status_mask |= MPC52xx_PSC_IMR_RXRDY;
+	out_be16(&PSC(port)->mpc52xx_psc_imr, port->read_status_mask);
+}
+
+/* Work out the idle line timeout for the new line settings */
+static void
+mpc52xx_uart_dma_set_baud(struct uart_port *port, unsigned int baud)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+
+	if (!dma)
+		return;
+
+	/* ~10 bits per character */
+	dma->rx_timeout = ktime_set(0, MPC52xx_UART_DMA_IDLE_CHARS * 10 *
+				       (NSEC_PER_SEC / baud));
+}
+
+static int
+mpc52xx_uart_dma_startup(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma[port->line];
+	int ret;
+
+	if (!dma)
+		return 0;
+
+	/* The console writes behind the driver's back, keep it on PIO */
+	dma->active = !uart_console(port);
+	if (!dma->active)
+		return 0;
+
+	bcom_gen_bd_rx_reset(dma->rx_task);
+	bcom_gen_bd_tx_reset(dma->tx_task);
+	dma->rx_busy = 0;
+	dma->tx_count = 0;
+	if (!ktime_to_ns(dma->rx_timeout))
+		dma->rx_timeout = ktime_set(0, NSEC_PER_MSEC);
+
+	ret = request_irq(dma->rx_irq, mpc52xx_uart_dma_rx_irq, 0,
+			  "mpc52xx_psc_uart_rx", port);
+	if (ret)
+		goto err;
+	ret = request_irq(dma->tx_irq, mpc52xx_uart_dma_tx_irq, 0,
+			  "mpc52xx_psc_uart_tx", port);
+	if (ret) {
+		free_irq(dma->rx_irq, port);
+		goto err;
+	}
+
+	return 0;
+
+err:
+	dma->active = 0;
+	return ret;
+}
+
+static void
+mpc52xx_uart_dma_shutdown(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma_get(port);
+
+	if (!dma)
+		return;
+
+	hrtimer_cancel(&dma->rx_timer);
+	bcom_gen_bd_rx_reset(dma->rx_task);
+	bcom_gen_bd_tx_reset(dma->tx_task);
+	if (dma->tx_count)
+		dma_unmap_single(port->dev, dma->tx_pa, dma->tx_count,
+				 DMA_TO_DEVICE);
+	dma->tx_count = 0;
+	dma->rx_busy = 0;
+
+	free_irq(dma->rx_irq, port);
+	free_irq(dma->tx_irq, port);
+	dma->active = 0;
+}
+
+static void
+mpc52xx_uart_dma_remove(struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma = mpc52xx_uart_dma[port->line];
+
+	if (!dma)
+		return;
+
+	mpc52xx_uart_dma[port->line] = NULL;
+	bcom_gen_bd_rx_release(dma->rx_task);
+	bcom_gen_bd_tx_release(dma->tx_task);
+	dma_free_coherent(port->dev, 2 * MPC52xx_UART_DMA_RX_BUFSIZE,
+			  dma->rx_buf[0], dma->rx_buf_pa[0]);
+	kfree(dma);
+}
+
+static void
+mpc52xx_uart_dma_probe(struct of_device *op, struct uart_port *port)
+{
+	struct mpc52xx_uart_dma *dma;
+	const u32 *psc_nump;
+	phys_addr_t fifo;
+
+	if (psc_ops != &mpc52xx_psc_ops ||
+	    !of_get_property(op->node, "fsl,bestcomm-dma", NULL))
+		return;
+
+	psc_nump = of_get_property(op->node, "cell-index", NULL);
+	if (!psc_nump || *psc_nump >= MPC52xx_PSC_MAXNUM) {
+		dev_warn(&op->dev, "no valid cell-index, DMA disabled\n");
+		return;
+	}
+
+	dma = kzalloc(sizeof *dma, GFP_KERNEL);
+	if (!dma)
+		return;
+
+	dma->rx_buf[0] = dma_alloc_coherent(&op->dev,
+					    2 * MPC52xx_UART_DMA_RX_BUFSIZE,
+					    &dma->rx_buf_pa[0], GFP_KERNEL);
+	if (!dma->rx_buf[0])
+		goto err_free;
+	dma->rx_buf[1] = dma->rx_buf[0] + MPC52xx_UART_DMA_RX_BUFSIZE;
+	dma->rx_buf_pa[1] = dma->rx_buf_pa[0] + MPC52xx_UART_DMA_RX_BUFSIZE;
+
+	fifo = port->mapbase + offsetof(struct mpc52xx_psc, buffer.buffer_32);
+	dma->rx_task = bcom_psc_gen_bd_rx_init(*psc_nump, 2, fifo,
+					       MPC52xx_UART_DMA_RX_BUFSIZE);
+	if (!dma->rx_task)
+		goto err_buf;
+	dma->tx_task = bcom_psc_gen_bd_tx_init(*psc_nump, 2, fifo);
+	if (!dma->tx_task)
+		goto err_rx;
+
+	dma->rx_irq = bcom_get_task_irq(dma->rx_task);
+	dma->tx_irq = bcom_get_task_irq(dma->tx_task);
+	dma->port = port;
+	hrtimer_init(&dma->rx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dma->rx_timer.function = mpc52xx_uart_dma_rx_timeout;
+
+	mpc52xx_uart_dma[port->line] = dma;
+	return;
+
+err_rx:
+	bcom_gen_bd_rx_release(dma->rx_task);
+err_buf:
+	dma_free_coherent(&op->dev, 2 * MPC52xx_UART_DMA_RX_BUFSIZE,
+			  dma->rx_buf[0], dma->rx_buf_pa[0]);
+err_free:
+	kfree(dma);
+	dev_warn(&op->dev, "could not set up BestComm DMA, using PIO\n");
+}
+
+#else /* CONFIG_SERIAL_MPC52xx_DMA */
+
+static inline int mpc52xx_uart_dma_active(struct uart_port *port)
+{ return 0; }
+static inline void mpc52xx_uart_dma_rx_int(struct uart_port *port) { }
+static inline void mpc52xx_uart_dma_start_tx(struct uart_port *port) { }
+static inline int mpc52xx_uart_dma_tx_done(struct uart_port *port)
+{ return 1; }
+static inline void mpc52xx_uart_dma_rx_stop(struct uart_port *port) { }
+static inline void mpc52xx_uart_dma_rx_start(struct uart_port *port) { }
+static inline void
+mpc52xx_uart_dma_set_baud(struct uart_port *port, unsigned int baud) { }
+static inline int mpc52xx_uart_dma_startup(struct uart_port *port)
+{ return 0; }
+static inline void mpc52xx_uart_dma_shutdown(struct uart_port *port) { }
+static inline void mpc52xx_uart_dma_remove(struct uart_port *port) { }
+static inline void
+mpc52xx_uart_dma_probe(struct of_device *op, struct uart_port *port) { }
+
+#endif /* CONFIG_SERIAL_MPC52xx_DMA */
+
 /* ======================================================================== */
 /* UART operations                                                          */
 /* ======================================================================== */
@@ -422,7 +909,8 @@ static struct psc_ops *psc_ops;
 static unsigned int
 mpc52xx_uart_tx_empty(struct uart_port *port)
 {
-	return psc_ops->tx_empty(port) ? TIOCSER_TEMT : 0;
+	return (psc_ops->tx_empty(port) && mpc52xx_uart_dma_tx_done(port)) ?
+		TIOCSER_TEMT : 0;
 }
 
 static void
@@ -459,7 +947,13 @@ static void
 mpc52xx_uart_start_tx(struct uart_port *port)
 {
 	/* port->lock taken by caller */
-	psc_ops->start_tx(port);
+	if (mpc52xx_uart_dma_active(port)) {
+		/* XON/XOFF bypass BestComm, the TXRDY interrupt sends them */
+		if (port->x_char)
+			psc_ops->start_tx(port);
+		mpc52xx_uart_dma_start_tx(port);
+	} else
+		psc_ops->start_tx(port);
 }
 
 static void
@@ -470,8 +964,9 @@ mpc52xx_uart_send_xchar(struct uart_port *port, char ch)
 
 	port->x_char = ch;
 	if (ch) {
-		/* Make sure tx interrupts are on */
-		/* Truly necessary ??? They should be anyway */
+		/* Make sure tx interrupts are on.  In DMA mode they are
+		 * off while BestComm feeds the FIFO, and only
+		 * mpc52xx_uart_int_tx_chars() sends port->x_char */
 		psc_ops->start_tx(port);
 	}
 
@@ -534,6 +1029,13 @@ mpc52xx_uart_startup(struct uart_port *port)
 
 	psc_ops->fifo_init(port);
 
+	ret = mpc52xx_uart_dma_startup(port);
+	if (ret) {
+		free_irq(port->irq, port);
+		return ret;
+	}
+	mpc52xx_uart_dma_rx_start(port);
+
 	out_8(&psc->command, MPC52xx_PSC_TX_ENABLE);
 	out_8(&psc->command, MPC52xx_PSC_RX_ENABLE);
 
@@ -553,6 +1055,8 @@ mpc52xx_uart_shutdown(struct uart_port *port)
 	port->read_status_mask = 0;
 	out_be16(&psc->mpc52xx_psc_imr, port->read_status_mask);
 
+	mpc52xx_uart_dma_shutdown(port);
+
 	/* Release interrupt */
 	free_irq(port->irq, port);
 }
@@ -611,6 +1115,7 @@ mpc52xx_uart_set_termios(struct uart_port *port, struct ktermios *new,
 
 	/* Update the per-port timeout */
 	uart_update_timeout(port, new->c_cflag, baud);
+	mpc52xx_uart_dma_set_baud(port, baud);
 
 	/* Do our best to flush TX & RX, so we don't lose anything */
 	/* But we don't wait indefinitely ! */
@@ -628,6 +1133,7 @@ mpc52xx_uart_set_termios(struct uart_port *port, struct ktermios *new,
 			"Some chars may have been lost.\n");
 
 	/* Reset the TX & RX */
+	mpc52xx_uart_dma_rx_stop(port);
 	out_8(&psc->command, MPC52xx_PSC_RST_RX);
 	out_8(&psc->command, MPC52xx_PSC_RST_TX);
 
@@ -642,6 +1148,7 @@ mpc52xx_uart_set_termios(struct uart_port *port, struct ktermios *new,
 		mpc52xx_uart_enable_ms(port);
 
 	/* Reenable TX & RX */
+	mpc52xx_uart_dma_rx_start(port);
 	out_8(&psc->command, MPC52xx_PSC_TX_ENABLE);
 	out_8(&psc->command, MPC52xx_PSC_RX_ENABLE);
 
@@ -822,6 +1329,13 @@ mpc52xx_uart_int_tx_chars(struct uart_port *port)
 		return 1;
 	}
 
+	/* The data itself is sent by BestComm */
+	if (mpc52xx_uart_dma_active(port)) {
+		mpc52xx_uart_stop_tx(port);
+		mpc52xx_uart_dma_start_tx(port);
+		return 0;
+	}
+
 	/* Nothing to do ? */
 	if (uart_circ_empty(xmit) || uart_tx_stopped(port)) {
 		mpc52xx_uart_stop_tx(port);
@@ -866,8 +1380,12 @@ mpc52xx_uart_int(int irq, void *dev_id)
 		keepgoing = 0;
 
 		psc_ops->rx_clr_irq(port);
-		if (psc_ops->rx_rdy(port))
-			keepgoing |= mpc52xx_uart_int_rx_chars(port);
+		if (psc_ops->rx_rdy(port)) {
+			if (mpc52xx_uart_dma_active(port))
+				mpc52xx_uart_dma_rx_int(port);
+			else
+				keepgoing |= mpc52xx_uart_int_rx_chars(port);
+		}
 
 		psc_ops->tx_clr_irq(port);
 		if (psc_ops->tx_rdy(port))
@@ -1161,9 +1679,12 @@ mpc52xx_uart_of_probe(struct of_device *op, const struct of_device_id *match)
 	dev_dbg(&op->dev, "mpc52xx-psc uart at %p, irq=%x, freq=%i\n",
 		(void *)port->mapbase, port->irq, port->uartclk);
 
+	mpc52xx_uart_dma_probe(op, port);
+
 	/* Add the port to the uart sub-system */
 	ret = uart_add_one_port(&mpc52xx_uart_driver, port);
 	if (ret) {
+		mpc52xx_uart_dma_remove(port);
 		irq_dispose_mapping(port->irq);
 		return ret;
 	}
@@ -1180,6 +1701,7 @@ mpc52xx_uart_of_remove(struct of_device *op)
 
 	if (port) {
 		uart_remove_one_port(&mpc52xx_uart_driver, port);
+		mpc52xx_uart_dma_remove(port);
 		irq_dispose_mapping(port->irq);
 	}
 
@@ -17,10 +17,12 @@
 #include <linux/errno.h>
 #include <linux/interrupt.h>
 #include <linux/of_platform.h>
-#include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
 #include <linux/completion.h>
 #include <linux/io.h>
 #include <linux/delay.h>
+#include <linux/dma-mapping.h>
 #include <linux/spi/spi.h>
 #include <linux/fsl_devices.h>
 #include <linux/of_spi.h>
@@ -28,8 +30,34 @@
 #include <asm/mpc52xx.h>
 #include <asm/mpc52xx_psc.h>
 
+#include <sysdev/bestcomm/bestcomm.h>
+#include <sysdev/bestcomm/gen_bd.h>
+
 #define MCLK 20000000 /* PSC port MClk in hz */
 
+/* Number of BDs in each of the BestComm rx/tx rings */
+#define MPC52xx_PSC_SPI_DMA_NUM_BD	4
+/* Largest chunk of a transfer described by one BD */
+#define MPC52xx_PSC_SPI_DMA_CHUNK	2048
+/* Transfers shorter than this are done by PIO */
+#define MPC52xx_PSC_SPI_DMA_THRESHOLD	64
+
+static int dma_threshold = MPC52xx_PSC_SPI_DMA_THRESHOLD;
+module_param(dma_threshold, int, 0644);
+MODULE_PARM_DESC(dma_threshold, "Minimum transfer length in bytes to use "
+		 "BestComm DMA for, 0 to always use PIO");
+
+static int pump_prio = MAX_USER_RT_PRIO / 2;
+module_param(pump_prio, int, 0444);
+MODULE_PARM_DESC(pump_prio, "SCHED_FIFO priority of the message pump "
+		 "thread, 0 for SCHED_NORMAL");
+
+static int sync_limit;
+module_param(sync_limit, int, 0644);
+MODULE_PARM_DESC(sync_limit, "Messages up to this many bytes are run "
+		 "directly in the caller's context when the bus is idle, "
+		 "0 to disable");
+
 struct mpc52xx_psc_spi {
 	/* fsl_spi_platform data */
 	void (*cs_control)(struct spi_device *spi, bool on);
@@ -42,21 +70,81 @@ struct mpc52xx_psc_spi {
 	u8 bits_per_word;
 	u8 busy;
 
-	struct workqueue_struct *workqueue;
-	struct work_struct work;
+	/* shadow of the mode dependent PSC registers */
+	u32 sicr;
+	u16 ccr;
+	/* device whose chip select is currently asserted */
+	struct spi_device *cs_active;
+
+	struct task_struct *pump;
 
 	struct list_head queue;
 	spinlock_t lock;
 
+	/* messages run by the fast path, completed from complete_tasklet so
+	 * that no completion is called from inside spi_async() */
+	struct list_head completed;
+	struct tasklet_struct complete_tasklet;
+
 	struct completion done;
+
+	/* BestComm DMA, only used if both tasks could be allocated */
+	struct bcom_task *rx_dmatsk;
+	struct bcom_task *tx_dmatsk;
+	unsigned int rx_dma_irq;
+	struct completion dma_done;
+
+	/* zeroes to send for rx only transfers, and a sink for tx only */
+	void *dummy;
+	dma_addr_t dummy_dma;
 };
 
 /* controller state */
 struct mpc52xx_psc_spi_cs {
 	int bits_per_word;
 	int speed_hz;
+
+	/* register values for the above, loaded only when they differ
+	 * from what the PSC was last programmed with */
+	u32 sicr;
+	u16 ccr;
 };
 
+/* SICR bits selected by spi->mode */
+#define MPC52xx_PSC_SICR_CPHA	0x00001000
+#define MPC52xx_PSC_SICR_CPOL	0x00002000
+#define MPC52xx_PSC_SICR_LSB	0x10000000
+
+static void mpc52xx_psc_spi_cs_config(struct spi_device *spi)
+{
+	struct mpc52xx_psc_spi_cs *cs = spi->controller_state;
+	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
+	u32 sicr;
+	u16 ccr;
+
+	/* Set clock phase and polarity */
+	sicr = mps->sicr & ~(MPC52xx_PSC_SICR_CPHA | MPC52xx_PSC_SICR_CPOL |
+			     MPC52xx_PSC_SICR_LSB);
+	if (spi->mode & SPI_CPHA)
+		sicr |= MPC52xx_PSC_SICR_CPHA;
+	if (spi->mode & SPI_CPOL)
+		sicr |= MPC52xx_PSC_SICR_CPOL;
+	if (spi->mode & SPI_LSB_FIRST)
+		sicr |= MPC52xx_PSC_SICR_LSB;
+	cs->sicr = sicr;
+
+	/* Set clock frequency
+	 * Because psc->ccr is defined as 16bit register instead of 32bit
+	 * just set the lower byte of BitClkDiv
+	 */
+	ccr = mps->ccr & 0xFF00;
+	if (cs->speed_hz)
+		ccr |= (MCLK / cs->speed_hz - 1) & 0xFF;
+	else /* by default SPI Clk 1MHz */
+		ccr |= (MCLK / 1000000 - 1) & 0xFF;
+	cs->ccr = ccr;
+}
+
 /* set clock freq, clock ramp, bits per work
  * if t is NULL then reset the values to the default values
  */
@@ -64,53 +152,44 @@ static int mpc52xx_psc_spi_transfer_setup(struct spi_device *spi,
 		struct spi_transfer *t)
 {
 	struct mpc52xx_psc_spi_cs *cs = spi->controller_state;
+	int speed_hz;
 
-	cs->speed_hz = (t && t->speed_hz)
+	speed_hz = (t && t->speed_hz)
 			? t->speed_hz : spi->max_speed_hz;
 	cs->bits_per_word = (t && t->bits_per_word)
 			? t->bits_per_word : spi->bits_per_word;
 	cs->bits_per_word = ((cs->bits_per_word + 7) / 8) * 8;
+	if (speed_hz != cs->speed_hz) {
+		cs->speed_hz = speed_hz;
+		mpc52xx_psc_spi_cs_config(spi);
+	}
 	return 0;
 }
 
-static void mpc52xx_psc_spi_activate_cs(struct spi_device *spi)
+/* Load the device's configuration, touching only registers that change */
+static void mpc52xx_psc_spi_load_config(struct spi_device *spi)
 {
 	struct mpc52xx_psc_spi_cs *cs = spi->controller_state;
 	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
 	struct mpc52xx_psc __iomem *psc = mps->psc;
-	u32 sicr;
-	u16 ccr;
 
-	sicr = in_be32(&psc->sicr);
+	if (cs->sicr != mps->sicr) {
+		out_be32(&psc->sicr, cs->sicr);
+		mps->sicr = cs->sicr;
+	}
+	if (cs->ccr != mps->ccr) {
+		out_be16((u16 __iomem *)&psc->ccr, cs->ccr);
+		mps->ccr = cs->ccr;
+	}
+	mps->bits_per_word = cs->bits_per_word;
+}
 
-	/* Set clock phase and polarity */
-	if (spi->mode & SPI_CPHA)
-		sicr |= 0x00001000;
-	else
-		sicr &= ~0x00001000;
-	if (spi->mode & SPI_CPOL)
-		sicr |= 0x00002000;
-	else
-		sicr &= ~0x00002000;
+static void mpc52xx_psc_spi_activate_cs(struct spi_device *spi)
+{
+	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
 
-	if (spi->mode & SPI_LSB_FIRST)
-		sicr |= 0x10000000;
-	else
-		sicr &= ~0x10000000;
-	out_be32(&psc->sicr, sicr);
-
-	/* Set clock frequency and bits per word
-	 * Because psc->ccr is defined as 16bit register instead of 32bit
-	 * just set the lower byte of BitClkDiv
-	 */
-	ccr = in_be16((u16 __iomem *)&psc->ccr);
-	ccr &= 0xFF00;
-	if (cs->speed_hz)
-		ccr |= (MCLK / cs->speed_hz - 1) & 0xFF;
-	else /* by default SPI Clk 1MHz */
-		ccr |= (MCLK / 1000000 - 1) & 0xFF;
-	out_be16((u16 __iomem *)&psc->ccr, ccr);
-	mps->bits_per_word = cs->bits_per_word;
+	mpc52xx_psc_spi_load_config(spi);
+	mps->cs_active = spi;
 
 	if (mps->cs_control)
 		mps->cs_control(spi, (spi->mode & SPI_CS_HIGH) ? 1 : 0);
@@ -120,6 +199,9 @@ static void mpc52xx_psc_spi_deactivate_cs(struct spi_device *spi)
 {
 	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
 
+	if (mps->cs_active == spi)
+		mps->cs_active = NULL;
+
 	if (mps->cs_control)
 		mps->cs_control(spi, (spi->mode & SPI_CS_HIGH) ? 0 : 1);
 }
@@ -128,14 +210,138 @@ static void mpc52xx_psc_spi_deactivate_cs(struct spi_device *spi)
 /* wake up when 80% fifo full */
 #define MPC52xx_PSC_RFALARM (MPC52xx_PSC_BUFSIZE * 20 / 100)
 
-static int mpc52xx_psc_spi_transfer_rxtx(struct spi_device *spi,
-						struct spi_transfer *t)
+/* Receive alarm used while BestComm drains the fifo: request a transfer
+ * as soon as a complete word is available */
+#define MPC52xx_PSC_DMA_RFALARM (MPC52xx_PSC_BUFSIZE - 4)
+
+/*
+ * Move the first len bytes of the transfer with BestComm.  len must be a
+ * multiple of 4, the gen_bd tasks move whole words from and to the fifo.
+ */
+static int mpc52xx_psc_spi_transfer_dma(struct spi_device *spi,
+		struct spi_transfer *t, unsigned len, int is_dma_mapped)
 {
 	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
+	struct mpc52xx_psc_spi_cs *cs = spi->controller_state;
+	struct device *dev = spi->master->dev.parent;
 	struct mpc52xx_psc __iomem *psc = mps->psc;
 	struct mpc52xx_psc_fifo __iomem *fifo = mps->fifo;
-	unsigned rb = 0;	/* number of bytes receieved */
-	unsigned sb = 0;	/* number of bytes sent */
+	dma_addr_t dummy_tx_dma = mps->dummy_dma;
+	dma_addr_t dummy_rx_dma = mps->dummy_dma + MPC52xx_PSC_SPI_DMA_CHUNK;
+	dma_addr_t tx_dma = 0, rx_dma = 0;
+	unsigned queued = 0, done = 0;
+	unsigned int byte_us;
+	int ret = 0;
+
+	if (is_dma_mapped) {
+		tx_dma = t->tx_dma;
+		rx_dma = t->rx_dma;
+	} else {
+		if (t->tx_buf) {
+			tx_dma = dma_map_single(dev, (void *)t->tx_buf, len,
+						DMA_TO_DEVICE);
+			if (dma_mapping_error(dev, tx_dma))
+				return -ENOMEM;
+		}
+		if (t->rx_buf) {
+			rx_dma = dma_map_single(dev, t->rx_buf, len,
+						DMA_FROM_DEVICE);
+			if (dma_mapping_error(dev, rx_dma)) {
+				if (t->tx_buf)
+					dma_unmap_single(dev, tx_dma, len,
+							 DMA_TO_DEVICE);
+				return -ENOMEM;
+			}
+		}
+	}
+
+	bcom_gen_bd_rx_reset(mps->rx_dmatsk);
+	bcom_gen_bd_tx_reset(mps->tx_dmatsk);
+	INIT_COMPLETION(mps->dma_done);
+
+	out_8(&fifo->rfcntl, 0);
+	out_be16(&fifo->rfalarm, MPC52xx_PSC_DMA_RFALARM);
+
+	/* Wire time of one byte, to bound the wait for the rx BDs */
+	byte_us = DIV_ROUND_UP(8 * USEC_PER_SEC,
+			       cs->speed_hz ? cs->speed_hz : 1000000);
+
+	while (done < len) {
+		/* Keep both rings filled, one rx BD per tx BD */
+		while (queued < len && !bcom_queue_full(mps->rx_dmatsk) &&
+		       !bcom_queue_full(mps->tx_dmatsk)) {
+			unsigned n = min(len - queued,
+					 (unsigned)MPC52xx_PSC_SPI_DMA_CHUNK);
+			struct bcom_gen_bd *bd;
+
+			bd = (struct bcom_gen_bd *)
+				bcom_prepare_next_buffer(mps->rx_dmatsk);
+			bd->status = n;
+			bd->buf_pa = t->rx_buf ? rx_dma + queued : dummy_rx_dma;
+			bcom_submit_next_buffer(mps->rx_dmatsk,
+						(void *)(unsigned long)n);
+
+			bd = (struct bcom_gen_bd *)
+				bcom_prepare_next_buffer(mps->tx_dmatsk);
+			bd->status = n;
+			bd->buf_pa = t->tx_buf ? tx_dma + queued : dummy_tx_dma;
+			bcom_submit_next_buffer(mps->tx_dmatsk, NULL);
+
+			queued += n;
+		}
+		bcom_enable(mps->rx_dmatsk);
+		bcom_enable(mps->tx_dmatsk);
+
+		if (!wait_for_completion_timeout(&mps->dma_done,
+				usecs_to_jiffies(2 * (queued - done) * byte_us) +
+				HZ / 10)) {
+			dev_err(&spi->dev, "DMA timeout, %u of %u bytes "
+				"transferred\n", done, len);
+			bcom_disable(mps->rx_dmatsk);
+			bcom_disable(mps->tx_dmatsk);
+			bcom_gen_bd_rx_reset(mps->rx_dmatsk);
+			bcom_gen_bd_tx_reset(mps->tx_dmatsk);
+			out_8(&psc->command, MPC52xx_PSC_RST_RX);
+			out_8(&psc->command, MPC52xx_PSC_RST_TX);
+			ret = -ETIMEDOUT;
+			goto unmap;
+		}
+
+		while (bcom_buffer_done(mps->tx_dmatsk))
+			bcom_retrieve_buffer(mps->tx_dmatsk, NULL, NULL);
+		while (bcom_buffer_done(mps->rx_dmatsk)) {
+			void *n = bcom_retrieve_buffer(mps->rx_dmatsk,
+						       NULL, NULL);
+			done += (unsigned long)n;
+		}
+	}
+
+	bcom_disable(mps->rx_dmatsk);
+	bcom_disable(mps->tx_dmatsk);
+
+	dev_dbg(&spi->dev, "%d bytes transferred by DMA\n", len);
+
+ unmap:
+	if (!is_dma_mapped) {
+		if (t->tx_buf)
+			dma_unmap_single(dev, tx_dma, len, DMA_TO_DEVICE);
+		if (t->rx_buf)
+			dma_unmap_single(dev, rx_dma, len, DMA_FROM_DEVICE);
+	}
+
+	return ret;
+}
+
+/* Move the transfer from offset on with the cpu, setting EOF on the last
+ * byte so that the PSC deasserts its chip select */
+static void mpc52xx_psc_spi_transfer_pio(struct spi_device *spi,
+		struct spi_transfer *t, unsigned offset)
+{
+	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
+	struct mpc52xx_psc __iomem *psc = mps->psc;
+	struct mpc52xx_psc_fifo __iomem *fifo = mps->fifo;
+	unsigned rb = offset;	/* number of bytes receieved */
+	unsigned sb = offset;	/* number of bytes sent */
 	unsigned char *rx_buf = (unsigned char *)t->rx_buf;
 	unsigned char *tx_buf = (unsigned char *)t->tx_buf;
 	unsigned rfalarm;
@@ -143,11 +349,6 @@ static int mpc52xx_psc_spi_transfer_rxtx(struct spi_device *spi,
 	unsigned recv_at_once;
 	int last_block = 0;
 
-	if (!t->tx_buf && !t->rx_buf && t->len)
-		return -EINVAL;
-
-	/* enable transmiter/receiver */
-	out_8(&psc->command, MPC52xx_PSC_TX_ENABLE | MPC52xx_PSC_RX_ENABLE);
 	while (rb < t->len) {
 		if (t->len - rb > MPC52xx_PSC_BUFSIZE) {
 			rfalarm = MPC52xx_PSC_RFALARM;
@@ -196,68 +397,237 @@ static int mpc52xx_psc_spi_transfer_rxtx(struct spi_device *spi,
 				in_8(&psc->mpc52xx_psc_buffer_8);
 		}
 	}
-	/* disable transmiter/receiver */
+}
+
+/*
+ * Busy-waiting variant of the PIO loop for transfers that fit the fifo.
+ * Used by the synchronous fast path, which may run in atomic context, so
+ * the wait is bounded by counting microseconds rather than by jiffies:
+ * twice the time the bytes take on the wire, plus some slack.
+ */
+static int mpc52xx_psc_spi_transfer_poll(struct spi_device *spi,
+		struct spi_transfer *t)
+{
+	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
+	struct mpc52xx_psc_spi_cs *cs = spi->controller_state;
+	struct mpc52xx_psc __iomem *psc = mps->psc;
+	struct mpc52xx_psc_fifo __iomem *fifo = mps->fifo;
+	unsigned char *rx_buf = (unsigned char *)t->rx_buf;
+	unsigned char *tx_buf = (unsigned char *)t->tx_buf;
+	unsigned int byte_us, timeout;
+	unsigned i;
+
+	byte_us = DIV_ROUND_UP(8 * USEC_PER_SEC,
+			       cs->speed_hz ? cs->speed_hz : 1000000);
+	timeout = 2 * t->len * byte_us + 100;
+
+	out_8(&psc->command, MPC52xx_PSC_TX_ENABLE | MPC52xx_PSC_RX_ENABLE);
+	for (i = 0; i < t->len; i++) {
+		/* set EOF flag before the last word is sent */
+		if (i == t->len - 1)
+			out_8(&psc->ircr2, 0x01);
+		out_8(&psc->mpc52xx_psc_buffer_8, tx_buf ? tx_buf[i] : 0);
+	}
+
+	while (in_be16(&fifo->rfnum) < t->len) {
+		if (!timeout--) {
+			dev_err(&spi->dev, "timeout waiting for %d rx bytes\n",
+				t->len);
+			out_8(&psc->command, MPC52xx_PSC_RST_RX);
+			out_8(&psc->command, MPC52xx_PSC_RST_TX);
+			out_8(&psc->command, MPC52xx_PSC_TX_DISABLE |
+					     MPC52xx_PSC_RX_DISABLE);
+			return -ETIMEDOUT;
+		}
+		udelay(1);
+	}
+
+	for (i = 0; i < t->len; i++) {
+		if (rx_buf)
+			rx_buf[i] = in_8(&psc->mpc52xx_psc_buffer_8);
+		else
+			in_8(&psc->mpc52xx_psc_buffer_8);
+	}
 	out_8(&psc->command, MPC52xx_PSC_TX_DISABLE | MPC52xx_PSC_RX_DISABLE);
 
 	return 0;
 }
 
-static void mpc52xx_psc_spi_work(struct work_struct *work)
+static int mpc52xx_psc_spi_transfer_rxtx(struct spi_device *spi,
+		struct spi_transfer *t, int is_dma_mapped)
 {
-	struct mpc52xx_psc_spi *mps =
-		container_of(work, struct mpc52xx_psc_spi, work);
+	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(spi->master);
+	struct mpc52xx_psc __iomem *psc = mps->psc;
+	unsigned offset = 0;
+	int ret = 0;
 
-	spin_lock_irq(&mps->lock);
-	mps->busy = 1;
-	while (!list_empty(&mps->queue)) {
-		struct spi_message *m;
-		struct spi_device *spi;
-		struct spi_transfer *t = NULL;
-		unsigned cs_change;
-		int status;
-
-		m = container_of(mps->queue.next, struct spi_message, queue);
-		list_del_init(&m->queue);
-		spin_unlock_irq(&mps->lock);
+	if (!t->tx_buf && !t->rx_buf && t->len)
+		return -EINVAL;
 
-		spi = m->spi;
-		cs_change = 1;
-		status = 0;
-		list_for_each_entry (t, &m->transfers, transfer_list) {
-			if (t->bits_per_word || t->speed_hz) {
-				status = mpc52xx_psc_spi_transfer_setup(spi, t);
-				if (status < 0)
-					break;
-			}
+	/* enable transmiter/receiver */
+	out_8(&psc->command, MPC52xx_PSC_TX_ENABLE | MPC52xx_PSC_RX_ENABLE);
 
-			if (cs_change)
-				mpc52xx_psc_spi_activate_cs(spi);
-			cs_change = t->cs_change;
+	/* Let BestComm move the bulk of the data.  At least the last byte is
+	 * left for PIO since only the cpu can flag the end of the frame. */
+	if (mps->rx_dmatsk && dma_threshold && t->len >= dma_threshold)
+		offset = (t->len - 1) & ~3;
+	if (offset)
+		ret = mpc52xx_psc_spi_transfer_dma(spi, t, offset,
+						   is_dma_mapped);
 
-			status = mpc52xx_psc_spi_transfer_rxtx(spi, t);
-			if (status)
-				break;
-			m->actual_length += t->len;
+	if (!ret)
+		mpc52xx_psc_spi_transfer_pio(spi, t, offset);
 
-			if (t->delay_usecs)
-				udelay(t->delay_usecs);
+	/* disable transmiter/receiver */
+	out_8(&psc->command, MPC52xx_PSC_TX_DISABLE | MPC52xx_PSC_RX_DISABLE);
+
+	return ret;
+}
 
-			if (cs_change)
-				mpc52xx_psc_spi_deactivate_cs(spi);
+/*
+ * Run one message.  A chip select left asserted by the previous message
+ * (cs_change set on its last transfer) is kept if this message is for the
+ * same device, which saves the deselect/select cycle between them.
+ */
+static void mpc52xx_psc_spi_do_message(struct mpc52xx_psc_spi *mps,
+		struct spi_message *m, int poll)
+{
+	struct spi_device *spi = m->spi;
+	struct spi_transfer *t = NULL;
+	unsigned cs_change;
+	int status = 0;
+
+	if (mps->cs_active && mps->cs_active != spi)
+		mpc52xx_psc_spi_deactivate_cs(mps->cs_active);
+	cs_change = mps->cs_active != spi;
+
+	list_for_each_entry (t, &m->transfers, transfer_list) {
+		if (t->bits_per_word || t->speed_hz) {
+			status = mpc52xx_psc_spi_transfer_setup(spi, t);
+			if (status < 0)
+				break;
 		}
 
-		m->status = status;
+		if (cs_change)
+			mpc52xx_psc_spi_activate_cs(spi);
+		else
+			mpc52xx_psc_spi_load_config(spi);
+		cs_change = t->cs_change;
+
+		if (poll)
+			status = mpc52xx_psc_spi_transfer_poll(spi, t);
+		else
+			status = mpc52xx_psc_spi_transfer_rxtx(spi, t,
+							m->is_dma_mapped);
+		if (status)
+			break;
+		m->actual_length += t->len;
+
+		if (t->delay_usecs)
+			udelay(t->delay_usecs);
+
+		/* on the last transfer cs_change asks to keep the chip
+		 * selected for the next message */
+		if (cs_change && !list_is_last(&t->transfer_list,
+					       &m->transfers))
+			mpc52xx_psc_spi_deactivate_cs(spi);
+	}
+
+	if (status || !cs_change)
+		mpc52xx_psc_spi_deactivate_cs(spi);
+
+	mpc52xx_psc_spi_transfer_setup(spi, NULL);
+
+	m->status = status;
+	if (poll) {
+		unsigned long flags;
+
+		spin_lock_irqsave(&mps->lock, flags);
+		list_add_tail(&m->queue, &mps->completed);
+		spin_unlock_irqrestore(&mps->lock, flags);
+		tasklet_schedule(&mps->complete_tasklet);
+	} else {
 		m->complete(m->context);
+	}
+}
 
-		if (status || !cs_change)
-			mpc52xx_psc_spi_deactivate_cs(spi);
+static void mpc52xx_psc_spi_complete(unsigned long data)
+{
+	struct mpc52xx_psc_spi *mps = (struct mpc52xx_psc_spi *)data;
+	struct spi_message *m, *tmp;
+	LIST_HEAD(completed);
 
-		mpc52xx_psc_spi_transfer_setup(spi, NULL);
+	spin_lock_irq(&mps->lock);
+	list_splice_init(&mps->completed, &completed);
+	spin_unlock_irq(&mps->lock);
 
-		spin_lock_irq(&mps->lock);
+	list_for_each_entry_safe(m, tmp, &completed, queue) {
+		list_del_init(&m->queue);
+		m->complete(m->context);
 	}
+}
+
+/* Called with mps->lock held once the queue has run dry */
+static void mpc52xx_psc_spi_idle(struct mpc52xx_psc_spi *mps)
+{
+	if (mps->cs_active)
+		mpc52xx_psc_spi_deactivate_cs(mps->cs_active);
 	mps->busy = 0;
-	spin_unlock_irq(&mps->lock);
+}
+
+static int mpc52xx_psc_spi_pump(void *data)
+{
+	struct mpc52xx_psc_spi *mps = data;
+
+	for (;;) {
+		/* Set the state before testing for work, so that neither
+		 * kthread_stop() nor a new message can be missed */
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop())
+			break;
+		spin_lock_irq(&mps->lock);
+		/* busy without us running means the fast path owns the bus,
+		 * it wakes us again when it is done */
+		if (mps->busy || list_empty(&mps->queue)) {
+			spin_unlock_irq(&mps->lock);
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		mps->busy = 1;
+		while (!list_empty(&mps->queue)) {
+			struct spi_message *m;
+
+			m = container_of(mps->queue.next, struct spi_message,
+					 queue);
+			list_del_init(&m->queue);
+			spin_unlock_irq(&mps->lock);
+
+			mpc52xx_psc_spi_do_message(mps, m, 0);
+
+			spin_lock_irq(&mps->lock);
+		}
+		mpc52xx_psc_spi_idle(mps);
+		spin_unlock_irq(&mps->lock);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+/* Can the message be run with mpc52xx_psc_spi_transfer_poll()? */
+static int mpc52xx_psc_spi_can_poll(struct spi_message *m)
+{
+	struct spi_transfer *t;
+	unsigned len = 0;
+
+	list_for_each_entry (t, &m->transfers, transfer_list) {
+		if (!t->tx_buf && !t->rx_buf && t->len)
+			return 0;
+		len += t->len;
+	}
+	return len <= sync_limit && len <= MPC52xx_PSC_BUFSIZE;
 }
 
 static int mpc52xx_psc_spi_setup(struct spi_device *spi)
@@ -279,6 +649,8 @@ static int mpc52xx_psc_spi_setup(struct spi_device *spi)
 	cs->bits_per_word = spi->bits_per_word;
 	cs->speed_hz = spi->max_speed_hz;
 
+	mpc52xx_psc_spi_cs_config(spi);
+
 	spin_lock_irqsave(&mps->lock, flags);
 	if (!mps->busy)
 		mpc52xx_psc_spi_deactivate_cs(spi);
@@ -297,8 +669,24 @@ static int mpc52xx_psc_spi_transfer(struct spi_device *spi,
 	m->status = -EINPROGRESS;
 
 	spin_lock_irqsave(&mps->lock, flags);
-	list_add_tail(&m->queue, &mps->queue);
-	queue_work(mps->workqueue, &mps->work);
+	if (sync_limit && !mps->busy && list_empty(&mps->queue) &&
+	    mpc52xx_psc_spi_can_poll(m)) {
+		/* Short message on an idle bus: skip the pump thread */
+		mps->busy = 1;
+		spin_unlock_irqrestore(&mps->lock, flags);
+
+		mpc52xx_psc_spi_do_message(mps, m, 1);
+
+		spin_lock_irqsave(&mps->lock, flags);
+		if (list_empty(&mps->queue))
+			mpc52xx_psc_spi_idle(mps);
+		else
+			mps->busy = 0;
+	} else {
+		list_add_tail(&m->queue, &mps->queue);
+	}
+	if (!mps->busy && !list_empty(&mps->queue))
+		wake_up_process(mps->pump);
 	spin_unlock_irqrestore(&mps->lock, flags);
 
 	return 0;
@@ -333,8 +721,10 @@ static int mpc52xx_psc_spi_port_config(int psc_id, struct mpc52xx_psc_spi *mps)
 
 	/* Configure 8bit codec mode as a SPI master and use EOF flags */
 	/* SICR_SIM_CODEC8|SICR_GENCLK|SICR_SPI|SICR_MSTR|SICR_USEEOF */
-	out_be32(&psc->sicr, 0x0180C800);
-	out_be16((u16 __iomem *)&psc->ccr, 0x070F); /* default SPI Clk 1MHz */
+	mps->sicr = 0x0180C800;
+	out_be32(&psc->sicr, mps->sicr);
+	mps->ccr = 0x070F; /* default SPI Clk 1MHz */
+	out_be16((u16 __iomem *)&psc->ccr, mps->ccr);
 
 	/* Set 2ms DTL delay */
 	out_8(&psc->ctur, 0x00);
@@ -350,7 +740,7 @@ static irqreturn_t mpc52xx_psc_spi_isr(int irq, void *dev_id)
 	struct mpc52xx_psc_spi *mps = (struct mpc52xx_psc_spi *)dev_id;
 	struct mpc52xx_psc __iomem *psc = mps->psc;
 
-	/* disable interrupt and wake up the work queue */
+	/* disable interrupt and wake up the message pump */
 	if (in_be16(&psc->mpc52xx_psc_isr) & MPC52xx_PSC_IMR_RXRDY) {
 		out_be16(&psc->mpc52xx_psc_imr, 0);
 		complete(&mps->done);
@@ -359,6 +749,74 @@ static irqreturn_t mpc52xx_psc_spi_isr(int irq, void *dev_id)
 	return IRQ_NONE;
 }
 
+static irqreturn_t mpc52xx_psc_spi_dma_isr(int irq, void *dev_id)
+{
+	struct mpc52xx_psc_spi *mps = (struct mpc52xx_psc_spi *)dev_id;
+
+	/* an rx BD completed, let the message pump reap it and refill */
+	complete(&mps->dma_done);
+	return IRQ_HANDLED;
+}
+
+/* Set up the BestComm tasks; on failure the driver silently sticks to PIO */
+static void mpc52xx_psc_spi_dma_init(struct of_device *op,
+		struct mpc52xx_psc_spi *mps, u32 regaddr, int psc_num)
+{
+	phys_addr_t fifo = regaddr + offsetof(struct mpc52xx_psc,
+					      buffer.buffer_32);
+
+	if (psc_num < 0 || psc_num >= MPC52xx_PSC_MAXNUM)
+		return;
+
+	mps->dummy = dma_alloc_coherent(&op->dev,
+					2 * MPC52xx_PSC_SPI_DMA_CHUNK,
+					&mps->dummy_dma, GFP_KERNEL);
+	if (!mps->dummy)
+		return;
+	memset(mps->dummy, 0, 2 * MPC52xx_PSC_SPI_DMA_CHUNK);
+
+	mps->rx_dmatsk = bcom_psc_gen_bd_rx_init(psc_num,
+			MPC52xx_PSC_SPI_DMA_NUM_BD, fifo,
+			MPC52xx_PSC_SPI_DMA_CHUNK);
+	mps->tx_dmatsk = bcom_psc_gen_bd_tx_init(psc_num,
+			MPC52xx_PSC_SPI_DMA_NUM_BD, fifo);
+	if (!mps->rx_dmatsk || !mps->tx_dmatsk)
+		goto err;
+
+	init_completion(&mps->dma_done);
+	mps->rx_dma_irq = bcom_get_task_irq(mps->rx_dmatsk);
+	if (request_irq(mps->rx_dma_irq, mpc52xx_psc_spi_dma_isr, 0,
+			"mpc52xx-psc-spi-dma", mps))
+		goto err;
+
+	return;
+
+err:
+	dev_info(&op->dev, "BestComm DMA unavailable, using PIO\n");
+	if (mps->rx_dmatsk)
+		bcom_gen_bd_rx_release(mps->rx_dmatsk);
+	if (mps->tx_dmatsk)
+		bcom_gen_bd_tx_release(mps->tx_dmatsk);
+	mps->rx_dmatsk = NULL;
+	mps->tx_dmatsk = NULL;
+	dma_free_coherent(&op->dev, 2 * MPC52xx_PSC_SPI_DMA_CHUNK,
+			  mps->dummy, mps->dummy_dma);
+	mps->dummy = NULL;
+}
+
+static void mpc52xx_psc_spi_dma_release(struct device *dev,
+		struct mpc52xx_psc_spi *mps)
+{
+	if (!mps->rx_dmatsk)
+		return;
+
+	free_irq(mps->rx_dma_irq, mps);
+	bcom_gen_bd_rx_release(mps->rx_dmatsk);
+	bcom_gen_bd_tx_release(mps->tx_dmatsk);
+	dma_free_coherent(dev, 2 * MPC52xx_PSC_SPI_DMA_CHUNK,
+			  mps->dummy, mps->dummy_dma);
+}
+
 /* bus_num is used only for the case dev->platform_data == NULL */
 static int __init mpc52xx_psc_spi_do_probe(struct of_device *op, u32 regaddr,
 				u32 size, unsigned int irq, s16 bus_num)
@@ -414,16 +872,30 @@ static int __init mpc52xx_psc_spi_do_probe(struct of_device *op, u32 regaddr,
 	if (ret < 0)
 		goto free_irq;
 
+	/* bus_num is the 1 based PSC id, BestComm counts from 0 */
+	mpc52xx_psc_spi_dma_init(op, mps, regaddr, master->bus_num - 1);
+
 	spin_lock_init(&mps->lock);
 	init_completion(&mps->done);
-	INIT_WORK(&mps->work, mpc52xx_psc_spi_work);
 	INIT_LIST_HEAD(&mps->queue);
-
-	mps->workqueue = create_singlethread_workqueue(
-		dev_name(master->dev.parent));
-	if (mps->workqueue == NULL) {
-		ret = -EBUSY;
-		goto free_irq;
+	INIT_LIST_HEAD(&mps->completed);
+	tasklet_init(&mps->complete_tasklet, mpc52xx_psc_spi_complete,
+		     (unsigned long)mps);
+
+	mps->pump = kthread_run(mpc52xx_psc_spi_pump, mps, "%s",
+				dev_name(master->dev.parent));
+	if (IS_ERR(mps->pump)) {
+		ret = PTR_ERR(mps->pump);
+		goto free_dma;
+	}
+	if (pump_prio > 0) {
+		struct sched_param param = {
+			.sched_priority = min(pump_prio, MAX_USER_RT_PRIO - 1),
+		};
+
+		if (sched_setscheduler(mps->pump, SCHED_FIFO, &param))
+			dev_warn(&op->dev, "could not make message pump "
+				 "real-time\n");
 	}
 
 	ret = spi_register_master(master);
@@ -435,7 +907,9 @@ static int __init mpc52xx_psc_spi_do_probe(struct of_device *op, u32 regaddr,
 	return ret;
 
 unreg_master:
-	destroy_workqueue(mps->workqueue);
+	kthread_stop(mps->pump);
+free_dma:
+	mpc52xx_psc_spi_dma_release(&op->dev, mps);
 free_irq:
 	free_irq(mps->irq, mps);
 free_master:
@@ -451,9 +925,10 @@ static int __exit mpc52xx_psc_spi_do_remove(struct device *dev)
 	struct spi_master *master = dev_get_drvdata(dev);
 	struct mpc52xx_psc_spi *mps = spi_master_get_devdata(master);
 
-	flush_workqueue(mps->workqueue);
-	destroy_workqueue(mps->workqueue);
 	spi_unregister_master(master);
+	kthread_stop(mps->pump);
+	tasklet_kill(&mps->complete_tasklet);
+	mpc52xx_psc_spi_dma_release(dev, mps);
 	free_irq(mps->irq, mps);
 	if (mps->psc)
 		iounmap(mps->psc);
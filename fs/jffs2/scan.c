@@ -16,12 +16,21 @@
 #include <linux/pagemap.h>
 #include <linux/crc32.h>
 #include <linux/compiler.h>
+#include <linux/kthread.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
 #include "nodelist.h"
 #include "summary.h"
 #include "debug.h"
 
 #define DEFAULT_EMPTY_SCAN_SIZE 1024
 
+#ifdef CONFIG_JFFS2_FS_SCAN_THREADS
+#define SCAN_THREADS CONFIG_JFFS2_FS_SCAN_THREADS
+#else
+#define SCAN_THREADS 0
+#endif
+
 #define noisy_printk(noise, args...) do { \
 	if (*(noise)) { \
 		printk(KERN_NOTICE args); \
@@ -36,6 +45,8 @@ static uint32_t pseudo_random;
 
 static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
 				  unsigned char *buf, uint32_t buf_size, struct jffs2_summary *s);
+static int jffs2_fill_scan_buf(struct jffs2_sb_info *c, void *buf,
+			       uint32_t ofs, uint32_t len);
 
 /* These helper functions _must_ increase ofs and also do the dirty/used space accounting.
  * Returning an error will abort the mount - bad checksums etc. should just mark the space
@@ -86,6 +97,198 @@ static int file_dirty(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb)
 	return 0;
 }
 
+#if SCAN_THREADS
+/*
+ * Read-ahead for jffs2_scan_medium(). Without summaries every eraseblock is
+ * read in full, and the scan waits for each read before it can parse the
+ * block. Instead, read-ahead threads read whole eraseblocks into their own
+ * buffers, and the scan parses those as if they were pointed to directly.
+ * Thread N reads eraseblocks N, N + nr_slots, ... into slot N, and the
+ * blocks are still parsed in order by the mounting task, so the result is
+ * the same as without read-ahead.
+ *
+ * Eraseblocks with a summary, bad ones, and ones which fail to read are left
+ * to the normal scan, which only reads what it needs and handles the errors.
+ * So are empty eraseblocks and ones holding just a cleanmarker: like the
+ * normal scan, only their first EMPTY_SCAN_SIZE bytes are read to tell.
+ */
+enum {
+	RA_EMPTY,	/* Slot is free for the thread to fill */
+	RA_FULL,	/* Slot holds the whole eraseblock */
+	RA_SKIPPED,	/* Eraseblock has to be scanned normally */
+};
+
+struct jffs2_scan_ra;
+
+struct jffs2_scan_ra_slot {
+	struct jffs2_scan_ra *ra;
+	struct task_struct *task;
+	unsigned char *buf;
+	int state;
+};
+
+struct jffs2_scan_ra {
+	struct jffs2_sb_info *c;
+	wait_queue_head_t wait;
+	int nr_slots;
+	struct jffs2_scan_ra_slot slot[SCAN_THREADS];
+};
+
+/* Would jffs2_scan_eraseblock() stop after the first EMPTY_SCAN_SIZE bytes? */
+static int jffs2_scan_ra_empty(struct jffs2_sb_info *c, unsigned char *buf)
+{
+	struct jffs2_unknown_node *node = (void *)buf;
+	uint32_t ofs = 0, end = EMPTY_SCAN_SIZE(c->sector_size);
+
+	/* A cleanmarker followed by EMPTY_SCAN_SIZE / 8 of 0xFF is enough */
+	if (c->cleanmarker_size &&
+	    je16_to_cpu(node->magic) == JFFS2_MAGIC_BITMASK &&
+	    je16_to_cpu(node->nodetype) == JFFS2_NODETYPE_CLEANMARKER) {
+		ofs = PAD(c->cleanmarker_size);
+		end /= 8;
+	}
+
+	while (ofs < end && *(uint32_t *)&buf[ofs] == 0xFFFFFFFF)
+		ofs += 4;
+
+	return ofs >= end;
+}
+
+static int jffs2_scan_ra_read(struct jffs2_sb_info *c,
+			      struct jffs2_eraseblock *jeb, unsigned char *buf)
+{
+	uint32_t head = EMPTY_SCAN_SIZE(c->sector_size);
+	uint32_t tail = 0;
+
+	if (c->mtd->block_isbad && c->mtd->block_isbad(c->mtd, jeb->offset))
+		return RA_SKIPPED;
+
+	if (jffs2_sum_active()) {
+		struct jffs2_sum_marker *sm;
+
+		/* Read the end first, like the scan does, to look for a summary */
+		tail = c->wbuf_pagesize ? c->wbuf_pagesize : sizeof(*sm);
+		if (jffs2_fill_scan_buf(c, buf + c->sector_size - tail,
+					jeb->offset + c->sector_size - tail, tail))
+			return RA_SKIPPED;
+
+		sm = (void *)buf + c->sector_size - sizeof(*sm);
+		if (je32_to_cpu(sm->magic) == JFFS2_SUM_MAGIC)
+			return RA_SKIPPED;
+	}
+
+	/* Empty eraseblocks are common, don't read them in full */
+	head = min_t(uint32_t, head, c->sector_size - tail);
+	if (jffs2_fill_scan_buf(c, buf, jeb->offset, head))
+		return RA_SKIPPED;
+	if (jffs2_scan_ra_empty(c, buf))
+		return RA_SKIPPED;
+
+	if (jffs2_fill_scan_buf(c, buf + head, jeb->offset + head,
+				c->sector_size - tail - head))
+		return RA_SKIPPED;
+
+	return RA_FULL;
+}
+
+static int jffs2_scan_ra_thread(void *_slot)
+{
+	struct jffs2_scan_ra_slot *slot = _slot;
+	struct jffs2_scan_ra *ra = slot->ra;
+	struct jffs2_sb_info *c = ra->c;
+	int i, state;
+
+	for (i = slot - ra->slot; i < c->nr_blocks; i += ra->nr_slots) {
+		wait_event(ra->wait, slot->state == RA_EMPTY ||
+			   kthread_should_stop());
+		if (kthread_should_stop())
+			return 0;
+
+		state = jffs2_scan_ra_read(c, &c->blocks[i], slot->buf);
+
+		/* The scan must see the data before the state */
+		smp_wmb();
+		slot->state = state;
+		wake_up(&ra->wait);
+	}
+
+	/* Nothing left to read; kthread_stop() expects us to still be here */
+	wait_event(ra->wait, kthread_should_stop());
+	return 0;
+}
+
+static void jffs2_scan_ra_stop(struct jffs2_scan_ra *ra)
+{
+	int i;
+
+	for (i = 0; i < ra->nr_slots; i++) {
+		if (ra->slot[i].task)
+			kthread_stop(ra->slot[i].task);
+		vfree(ra->slot[i].buf);
+	}
+	kfree(ra);
+}
+
+/* Returns NULL if read-ahead can't be set up. The scan works without it. */
+static struct jffs2_scan_ra *jffs2_scan_ra_start(struct jffs2_sb_info *c)
+{
+	struct jffs2_scan_ra *ra;
+	int i;
+
+	ra = kzalloc(sizeof(*ra), GFP_KERNEL);
+	if (!ra)
+		return NULL;
+
+	ra->c = c;
+	init_waitqueue_head(&ra->wait);
+	ra->nr_slots = min_t(int, SCAN_THREADS, c->nr_blocks);
+
+	for (i = 0; i < ra->nr_slots; i++) {
+		struct jffs2_scan_ra_slot *slot = &ra->slot[i];
+
+		slot->ra = ra;
+		slot->state = RA_EMPTY;
+		slot->buf = vmalloc(c->sector_size);
+		if (!slot->buf)
+			goto fail;
+		slot->task = kthread_create(jffs2_scan_ra_thread, slot,
+					    "jffs2_scan_mtd%d", c->mtd->index);
+		if (IS_ERR(slot->task)) {
+			slot->task = NULL;
+			goto fail;
+		}
+	}
+
+	for (i = 0; i < ra->nr_slots; i++)
+		wake_up_process(ra->slot[i].task);
+
+	D1(printk(KERN_DEBUG "Reading ahead with %d threads\n", ra->nr_slots));
+	return ra;
+
+ fail:
+	printk(KERN_NOTICE "jffs2_scan_medium(): Can't set up read-ahead, scanning without\n");
+	jffs2_scan_ra_stop(ra);
+	return NULL;
+}
+
+/* Wait for eraseblock 'block'. NULL means it has to be scanned normally */
+static unsigned char *jffs2_scan_ra_get(struct jffs2_scan_ra *ra, int block)
+{
+	struct jffs2_scan_ra_slot *slot = &ra->slot[block % ra->nr_slots];
+
+	wait_event(ra->wait, slot->state != RA_EMPTY);
+	smp_rmb();
+
+	return slot->state == RA_FULL ? slot->buf : NULL;
+}
+
+static void jffs2_scan_ra_put(struct jffs2_scan_ra *ra, int block)
+{
+	ra->slot[block % ra->nr_slots].state = RA_EMPTY;
+	wake_up(&ra->wait);
+}
+#endif /* SCAN_THREADS */
+
 int jffs2_scan_medium(struct jffs2_sb_info *c)
 {
 	int i, ret;
@@ -93,6 +296,9 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	unsigned char *flashbuf = NULL;
 	uint32_t buf_size = 0;
 	struct jffs2_summary *s = NULL; /* summary info collected by the scan process */
+#if SCAN_THREADS
+	struct jffs2_scan_ra *ra = NULL;
+#endif
 #ifndef __ECOS
 	size_t pointlen;
 
@@ -125,6 +331,10 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 		flashbuf = kmalloc(buf_size, GFP_KERNEL);
 		if (!flashbuf)
 			return -ENOMEM;
+
+#if SCAN_THREADS
+		ra = jffs2_scan_ra_start(c);
+#endif
 	}
 
 	if (jffs2_sum_active()) {
@@ -138,14 +348,28 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 
 	for (i=0; i<c->nr_blocks; i++) {
 		struct jffs2_eraseblock *jeb = &c->blocks[i];
+		unsigned char *rabuf = NULL;
 
 		cond_resched();
 
 		/* reset summary info for next eraseblock scan */
 		jffs2_sum_reset_collected(s);
 
-		ret = jffs2_scan_eraseblock(c, jeb, buf_size?flashbuf:(flashbuf+jeb->offset),
+#if SCAN_THREADS
+		if (ra)
+			rabuf = jffs2_scan_ra_get(ra, i);
+#endif
+		if (rabuf) {
+			/* Read ahead in full: scan it like pointed-to flash */
+			ret = jffs2_scan_eraseblock(c, jeb, rabuf, 0, s);
+		} else {
+			ret = jffs2_scan_eraseblock(c, jeb, buf_size?flashbuf:(flashbuf+jeb->offset),
 						buf_size, s);
+		}
+#if SCAN_THREADS
+		if (ra)
+			jffs2_scan_ra_put(ra, i);
+#endif
 
 		if (ret < 0)
 			goto out;
@@ -264,6 +488,10 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	}
 	ret = 0;
  out:
+#if SCAN_THREADS
+	if (ra)
+		jffs2_scan_ra_stop(ra);
+#endif
 	if (buf_size)
 		kfree(flashbuf);
 #ifndef __ECOS
@@ -372,6 +372,100 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * avoiding the copy through the "data" cache.  This needs every page of
+ * the block (up to the end of file) to be locked and not uptodate; if one
+ * can't be grabbed, -EAGAIN tells the caller to fall back to the cache.
+ * On success all the pages, including target_page, are uptodate and
+ * unlocked.  On failure target_page is left locked.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = min(start_index | mask, file_end);
+	int pages = end_index - start_index + 1;
+	int i, n, bytes, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kcalloc(pages, sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (i = 0, n = start_index; n <= end_index; i++, n++) {
+		if (n == target_page->index) {
+			page[i] = target_page;
+			continue;
+		}
+
+		page[i] = grab_cache_page_nowait(target_page->mapping, n);
+		if (page[i] == NULL)
+			goto release_pages;
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+			goto release_pages;
+		}
+	}
+
+	/*
+	 * squashfs_read_data() sleeps, so the pages can't be mapped with
+	 * kmap_atomic().  Without highmem kmap() is just page_address().
+	 */
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+
+	/* Zero the tail of the last page written, and any pages after it */
+	if (res >= 0) {
+		bytes = res & (PAGE_CACHE_SIZE - 1);
+		for (i = res >> PAGE_CACHE_SHIFT; i < pages; i++, bytes = 0)
+			memset(pageaddr[i] + bytes, 0, PAGE_CACHE_SIZE - bytes);
+	}
+
+	for (i = 0; i < pages; i++)
+		kunmap(page[i]);
+
+	if (res < 0)
+		goto release_pages;
+
+	for (i = 0; i < pages; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+
+	res = 0;
+	goto out;
+
+release_pages:
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL || page[i] == target_page)
+			continue;
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -410,8 +504,19 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+			int res = squashfs_readpage_block(page, block, bsize);
+
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN) {
+				ERROR("Unable to read page, block %llx, size %x"
+					"\n", block, bsize);
+				goto error_out;
+			}
+
 			/*
-			 * Read and decompress datablock.
+			 * Some pages of the block are missing or uptodate,
+			 * read and decompress datablock into the cache.
 			 */
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
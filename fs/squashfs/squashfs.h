@@ -86,5 +86,11 @@ extern const struct address_space_operations squashfs_aops;
 /* namei.c */
 extern const struct inode_operations squashfs_dir_inode_ops;
 
+/* stream.c */
+extern z_stream *squashfs_get_stream(struct squashfs_sb_info *);
+extern void squashfs_put_stream(struct squashfs_sb_info *, z_stream *);
+extern int squashfs_streams_init(struct squashfs_sb_info *);
+extern void squashfs_streams_delete(struct squashfs_sb_info *);
+
 /* symlink.c */
 extern const struct address_space_operations squashfs_symlink_aops;
@@ -51,6 +51,14 @@ struct squashfs_cache_entry {
 	void			**data;
 };
 
+struct squashfs_stream_pool {
+	spinlock_t		lock;
+	struct list_head	idle;
+	int			count;
+	int			max;
+	wait_queue_head_t	wait_queue;
+};
+
 struct squashfs_sb_info {
 	int			devblksize;
 	int			devblksize_log2;
@@ -61,10 +69,9 @@ struct squashfs_sb_info {
 	__le64			*id_table;
 	__le64			*fragment_index;
 	unsigned int		*fragment_index_2;
-	struct mutex		read_data_mutex;
 	struct mutex		meta_index_mutex;
 	struct meta_index	*meta_index;
-	z_stream		stream;
+	struct squashfs_stream_pool streams;
 	__le64			*inode_lookup_table;
 	u64			inode_table;
 	u64			directory_table;
@@ -0,0 +1,174 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * Copyright (c) 2002, 2003, 2004, 2005, 2006, 2007, 2008
+ * Phillip Lougher <phillip@lougher.demon.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * stream.c
+ */
+
+/*
+ * This file implements the pool of zlib streams used to decompress blocks.
+ *
+ * A zlib stream carries state for the duration of one block's
+ * decompression, so concurrent readers each need their own.  One stream is
+ * allocated at mount time, which guarantees progress; further streams are
+ * allocated on demand, up to one per online CPU, when a reader finds all
+ * existing streams busy.  Once the limit is reached, or an allocation
+ * fails, readers wait for a stream to be released.  Streams are kept until
+ * unmount.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/cpumask.h>
+#include <linux/zlib.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+
+struct squashfs_stream {
+	z_stream		stream;
+	struct list_head	list;
+};
+
+static struct squashfs_stream *squashfs_stream_alloc(void)
+{
+	struct squashfs_stream *stream = kmalloc(sizeof(*stream), GFP_KERNEL);
+
+	if (stream == NULL)
+		return NULL;
+
+	stream->stream.workspace = kmalloc(zlib_inflate_workspacesize(),
+		GFP_KERNEL);
+	if (stream->stream.workspace == NULL) {
+		kfree(stream);
+		return NULL;
+	}
+
+	return stream;
+}
+
+
+static void squashfs_stream_free(struct squashfs_stream *stream)
+{
+	kfree(stream->stream.workspace);
+	kfree(stream);
+}
+
+
+/*
+ * Get an idle stream, allocating a new one or sleeping if there is none.
+ */
+z_stream *squashfs_get_stream(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream_pool *pool = &msblk->streams;
+	struct squashfs_stream *stream;
+
+	spin_lock(&pool->lock);
+
+	while (list_empty(&pool->idle)) {
+		if (pool->count < pool->max) {
+			pool->count++;
+			spin_unlock(&pool->lock);
+
+			stream = squashfs_stream_alloc();
+			if (stream) {
+				TRACE("Allocated another zlib stream\n");
+				return &stream->stream;
+			}
+
+			/* Make do with the streams we have */
+			spin_lock(&pool->lock);
+			pool->count--;
+			pool->max = pool->count;
+			continue;
+		}
+
+		spin_unlock(&pool->lock);
+		wait_event(pool->wait_queue, !list_empty(&pool->idle));
+		spin_lock(&pool->lock);
+	}
+
+	stream = list_first_entry(&pool->idle, struct squashfs_stream, list);
+	list_del(&stream->list);
+	spin_unlock(&pool->lock);
+
+	return &stream->stream;
+}
+
+
+/*
+ * Return a stream obtained with squashfs_get_stream() to the pool.
+ */
+void squashfs_put_stream(struct squashfs_sb_info *msblk, z_stream *z)
+{
+	struct squashfs_stream_pool *pool = &msblk->streams;
+	struct squashfs_stream *stream = container_of(z, struct squashfs_stream,
+		stream);
+
+	spin_lock(&pool->lock);
+	list_add(&stream->list, &pool->idle);
+	spin_unlock(&pool->lock);
+
+	wake_up(&pool->wait_queue);
+}
+
+
+/*
+ * Initialise the pool, with the one stream which is always there.
+ */
+int squashfs_streams_init(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream_pool *pool = &msblk->streams;
+	struct squashfs_stream *stream;
+
+	spin_lock_init(&pool->lock);
+	init_waitqueue_head(&pool->wait_queue);
+	INIT_LIST_HEAD(&pool->idle);
+	pool->max = num_online_cpus();
+
+	stream = squashfs_stream_alloc();
+	if (stream == NULL)
+		return -ENOMEM;
+
+	list_add(&stream->list, &pool->idle);
+	pool->count = 1;
+
+	return 0;
+}
+
+
+/*
+ * Free all streams.  They must all be idle.
+ */
+void squashfs_streams_delete(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream_pool *pool = &msblk->streams;
+	struct squashfs_stream *stream, *next;
+
+	list_for_each_entry_safe(stream, next, &pool->idle, list)
+		squashfs_stream_free(stream);
+
+	INIT_LIST_HEAD(&pool->idle);
+	pool->count = 0;
+}
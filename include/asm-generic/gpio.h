@@ -3,6 +3,7 @@
 
 #include <linux/types.h>
 #include <linux/errno.h>
+#include <linux/bitops.h>
 
 #ifdef CONFIG_GPIOLIB
 
@@ -44,6 +45,10 @@ struct module;
  *	returns either the value actually sensed, or zero
  * @direction_output: configures signal "offset" as output, or returns error
  * @set: assigns output value for signal "offset"
+ * @get_port: optional hook returning the values of all signals in "mask"
+ *	at once, bit n of the result being signal "offset" n
+ * @set_port: optional hook assigning "value" to all output signals in
+ *	"mask" at once, with the same bit layout as @get_port
  * @to_irq: optional hook supporting non-static gpio_to_irq() mappings;
  *	implementation may not sleep
  * @dbg_show: optional routine to show contents in debugfs; default code
@@ -88,6 +93,11 @@ struct gpio_chip {
 						unsigned offset, int value);
 	void			(*set)(struct gpio_chip *chip,
 						unsigned offset, int value);
+	unsigned long		(*get_port)(struct gpio_chip *chip,
+						unsigned long mask);
+	void			(*set_port)(struct gpio_chip *chip,
+						unsigned long mask,
+						unsigned long value);
 
 	int			(*to_irq)(struct gpio_chip *chip,
 						unsigned offset);
@@ -122,6 +132,11 @@ extern int gpio_direction_output(unsigned gpio, int value);
 extern int gpio_get_value_cansleep(unsigned gpio);
 extern void gpio_set_value_cansleep(unsigned gpio, int value);
 
+extern int gpio_port_valid(unsigned gpio, unsigned long mask);
+extern unsigned long gpio_get_port(unsigned gpio, unsigned long mask);
+extern void gpio_set_port(unsigned gpio, unsigned long mask,
+			  unsigned long value);
+
 
 /* A platform's <asm/gpio.h> code may want to inline the I/O calls when
  * the GPIO is constant and refers to some always-present controller,
@@ -174,6 +189,33 @@ static inline void gpio_set_value_cansleep(unsigned gpio, int value)
 	gpio_set_value(gpio, value);
 }
 
+/* The fallbacks below go one gpio at a time, so any gpios will do */
+static inline int gpio_port_valid(unsigned gpio, unsigned long mask)
+{
+	return 1;
+}
+
+static inline unsigned long gpio_get_port(unsigned gpio, unsigned long mask)
+{
+	unsigned long value = 0;
+	int i;
+
+	for (i = 0; i < fls_long(mask); i++)
+		if ((mask & (1UL << i)) && gpio_get_value(gpio + i))
+			value |= 1UL << i;
+	return value;
+}
+
+static inline void gpio_set_port(unsigned gpio, unsigned long mask,
+				 unsigned long value)
+{
+	int i;
+
+	for (i = 0; i < fls_long(mask); i++)
+		if (mask & (1UL << i))
+			gpio_set_value(gpio + i, value & (1UL << i));
+}
+
 #endif /* !CONFIG_HAVE_GPIO_LIB */
 
 #ifndef CONFIG_GPIO_SYSFS
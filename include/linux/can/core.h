@@ -59,6 +59,12 @@ extern void can_rx_unregister(struct net_device *dev, canid_t can_id,
 			      void (*func)(struct sk_buff *, void *),
 			      void *data);
 
+#define CAN_RX_SPAN_SFF	0x1	/* receivers for SFF frames */
+#define CAN_RX_SPAN_EFF	0x2	/* receivers for EFF frames */
+
+extern int can_rx_filter_span(struct net_device *dev, struct can_filter *sff,
+			      struct can_filter *eff);
+
 extern int can_send(struct sk_buff *skb, int loop);
 
 #endif /* CAN_CORE_H */
@@ -82,6 +82,25 @@ static inline void gpio_set_value_cansleep(unsigned gpio, int value)
 	WARN_ON(1);
 }
 
+static inline int gpio_port_valid(unsigned gpio, unsigned long mask)
+{
+	return 0;
+}
+
+static inline unsigned long gpio_get_port(unsigned gpio, unsigned long mask)
+{
+	/* GPIO can never have been requested or set as {in,out}put */
+	WARN_ON(1);
+	return 0;
+}
+
+static inline void gpio_set_port(unsigned gpio, unsigned long mask,
+				 unsigned long value)
+{
+	/* GPIO can never have been requested or set as output */
+	WARN_ON(1);
+}
+
 static inline int gpio_export(unsigned gpio, bool direction_may_change)
 {
 	/* GPIO can never have been requested or set as {in,out}put */
@@ -1486,6 +1486,7 @@ void input_ir_queue(struct input_dev *dev, int sample);
 
 int input_ir_send(struct input_dev *dev, struct ir_command *ir_command, struct file *file);
 int input_ir_register(struct input_dev *dev);
+void input_ir_unregister(struct input_dev *dev);
 
 #endif
 #endif
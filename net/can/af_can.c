@@ -395,6 +395,29 @@ static struct hlist_head *find_rcv_list(canid_t *can_id, canid_t *mask,
 	return &d->rx[RX_FIL];
 }
 
+/**
+ * can_rx_filters_changed - tell devices their set of receivers changed
+ * @dev: pointer to netdevice (NULL => all CAN devices)
+ *
+ * Description:
+ *  Devices with hardware acceptance filters reprogram them from their
+ *  ndo_set_rx_mode() callback, see can_rx_filter_span().
+ */
+static void can_rx_filters_changed(struct net_device *dev)
+{
+	if (dev) {
+		dev_set_rx_mode(dev);
+		return;
+	}
+
+	read_lock(&dev_base_lock);
+	for_each_netdev(&init_net, dev) {
+		if (dev->type == ARPHRD_CAN)
+			dev_set_rx_mode(dev);
+	}
+	read_unlock(&dev_base_lock);
+}
+
 /**
  * can_rx_register - subscribe CAN frames from a specific interface
  * @dev: pointer to netdevice (NULL => subcribe from 'all' CAN devices list)
@@ -465,6 +488,9 @@ int can_rx_register(struct net_device *dev, canid_t can_id, canid_t mask,
 
 	spin_unlock(&can_rcvlists_lock);
 
+	if (!err)
+		can_rx_filters_changed(dev);
+
 	return err;
 }
 EXPORT_SYMBOL(can_rx_register);
@@ -569,9 +595,107 @@ void can_rx_unregister(struct net_device *dev, canid_t can_id, canid_t mask,
 	/* schedule the device structure for deletion */
 	if (d)
 		call_rcu(&d->rcu, can_rx_delete_device);
+
+	if (r)
+		can_rx_filters_changed(dev);
 }
 EXPORT_SYMBOL(can_rx_unregister);
 
+/*
+ * can_rx_span_add - widen an acceptance filter to also pass can_id/mask
+ */
+static void can_rx_span_add(struct can_filter *span, int *valid,
+			    canid_t can_id, canid_t mask)
+{
+	can_id &= mask;
+
+	if (!*valid) {
+		span->can_id = can_id;
+		span->can_mask = mask;
+		*valid = 1;
+		return;
+	}
+
+	/* only the bits all filters care about and agree on are left */
+	span->can_mask &= mask & ~(span->can_id ^ can_id);
+	span->can_id &= span->can_mask;
+}
+
+static void can_rx_span_lists(struct dev_rcv_lists *d,
+			      struct can_filter *sff, int *sff_valid,
+			      struct can_filter *eff, int *eff_valid)
+{
+	struct receiver *r;
+	struct hlist_node *n;
+	int i;
+
+	if (!hlist_empty(&d->rx[RX_ALL]) || !hlist_empty(&d->rx[RX_INV])) {
+		can_rx_span_add(sff, sff_valid, 0, 0);
+		can_rx_span_add(eff, eff_valid, 0, 0);
+	}
+
+	hlist_for_each_entry_rcu(r, n, &d->rx[RX_FIL], list) {
+		/* without CAN_EFF_FLAG in the mask it applies to both */
+		if (!(r->mask & CAN_EFF_FLAG) || !(r->can_id & CAN_EFF_FLAG))
+			can_rx_span_add(sff, sff_valid,
+					r->can_id & CAN_SFF_MASK,
+					r->mask & CAN_SFF_MASK);
+		if (!(r->mask & CAN_EFF_FLAG) || (r->can_id & CAN_EFF_FLAG))
+			can_rx_span_add(eff, eff_valid,
+					r->can_id & CAN_EFF_MASK,
+					r->mask & CAN_EFF_MASK);
+	}
+
+	hlist_for_each_entry_rcu(r, n, &d->rx[RX_EFF], list)
+		can_rx_span_add(eff, eff_valid, r->can_id & CAN_EFF_MASK,
+				CAN_EFF_MASK);
+
+	for (i = 0; i < ARRAY_SIZE(d->rx_sff); i++) {
+		if (!hlist_empty(&d->rx_sff[i]))
+			can_rx_span_add(sff, sff_valid, i, CAN_SFF_MASK);
+	}
+}
+
+/**
+ * can_rx_filter_span - compute acceptance filters for a CAN controller
+ * @dev: pointer to netdevice
+ * @sff: set to an id/mask pair passing every SFF frame a receiver wants
+ * @eff: same for EFF frames
+ *
+ * Description:
+ *  Folds the filters of all receivers of @dev, including those registered
+ *  for all devices, into one id/mask pair per frame format.  The pairs are
+ *  supersets of what the receivers match; a mask of 0 means every frame of
+ *  that format is wanted.  Error frame subscriptions and the RTR flag are
+ *  not considered.
+ *
+ * Return:
+ *  CAN_RX_SPAN_SFF and/or CAN_RX_SPAN_EFF for the formats which have any
+ *  receiver; frames of the other formats may be dropped by the hardware.
+ */
+int can_rx_filter_span(struct net_device *dev, struct can_filter *sff,
+		       struct can_filter *eff)
+{
+	struct dev_rcv_lists *d;
+	int sff_valid = 0, eff_valid = 0;
+
+	rcu_read_lock();
+
+	d = find_dev_rcv_lists(NULL);
+	if (d)
+		can_rx_span_lists(d, sff, &sff_valid, eff, &eff_valid);
+
+	d = find_dev_rcv_lists(dev);
+	if (d)
+		can_rx_span_lists(d, sff, &sff_valid, eff, &eff_valid);
+
+	rcu_read_unlock();
+
+	return (sff_valid ? CAN_RX_SPAN_SFF : 0) |
+		(eff_valid ? CAN_RX_SPAN_EFF : 0);
+}
+EXPORT_SYMBOL(can_rx_filter_span);
+
 static inline void deliver(struct sk_buff *skb, struct receiver *r)
 {
 	r->func(skb, r->data);
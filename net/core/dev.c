@@ -3480,6 +3480,7 @@ void dev_set_rx_mode(struct net_device *dev)
 	__dev_set_rx_mode(dev);
 	netif_addr_unlock_bh(dev);
 }
+EXPORT_SYMBOL(dev_set_rx_mode);
 
 /* hw addresses list handling functions */
 
@@ -45,7 +45,8 @@ static irqreturn_t psc_dma_status_irq(int irq, void *_psc_dma)
  * psc_dma_bcom_enqueue_next_buffer - Enqueue another audio buffer
  * @s: pointer to stream private data structure
  *
- * Enqueues another audio period buffer into the bestcomm queue.
+ * Enqueues the next BD worth of the audio ring buffer into the bestcomm
+ * queue.
  *
  * Note: The routine must only be called when there is space available in
  * the queue.  Otherwise the enqueue will fail and the audio ring buffer
@@ -57,68 +58,39 @@ static void psc_dma_bcom_enqueue_next_buffer(struct psc_dma_stream *s)
 
 	/* Prepare and enqueue the next buffer descriptor */
 	bd = bcom_prepare_next_buffer(s->bcom_task);
-	bd->status = s->period_bytes;
+	bd->status = s->bd_bytes;
 	bd->data[0] = s->period_next_pt;
 	bcom_submit_next_buffer(s->bcom_task, NULL);
 
-	/* Update for next period */
-	s->period_next_pt += s->period_bytes;
+	/* Update for next BD */
+	s->period_next_pt += s->bd_bytes;
 	if (s->period_next_pt >= s->period_end)
 		s->period_next_pt = s->period_start;
 }
 
-static void psc_dma_bcom_enqueue_tx(struct psc_dma_stream *s)
-{
-	while (s->appl_ptr < s->runtime->control->appl_ptr) {
-
-		if (bcom_queue_full(s->bcom_task))
-			return;
-
-		s->appl_ptr += s->period_size;
-
-		psc_dma_bcom_enqueue_next_buffer(s);
-	}
-}
-
-/* Bestcomm DMA irq handler */
-static irqreturn_t psc_dma_bcom_irq_tx(int irq, void *_psc_dma_stream)
+/* Bestcomm DMA irq handler, shared by playback and capture
+ *
+ * The BDs cover the whole audio ring buffer and stay queued: every
+ * completed BD is handed straight back to the task for the next lap, so
+ * the DMA keeps running however late userspace is, and ALSA notices the
+ * xrun from the pointer. */
+static irqreturn_t psc_dma_bcom_irq(int irq, void *_psc_dma_stream)
 {
 	struct psc_dma_stream *s = _psc_dma_stream;
+	int elapsed = 0;
 
 	spin_lock(&s->psc_dma->lock);
-	/* For each finished period, dequeue the completed period buffer
-	 * and enqueue a new one in it's place. */
 	while (bcom_buffer_done(s->bcom_task)) {
 		bcom_retrieve_buffer(s->bcom_task, NULL, NULL);
 
-		s->period_current_pt += s->period_bytes;
+		s->period_current_pt += s->bd_bytes;
 		if (s->period_current_pt >= s->period_end)
 			s->period_current_pt = s->period_start;
-	}
-	psc_dma_bcom_enqueue_tx(s);
-	spin_unlock(&s->psc_dma->lock);
-
-	/* If the stream is active, then also inform the PCM middle layer
-	 * of the period finished event. */
-	if (s->active)
-		snd_pcm_period_elapsed(s->stream);
 
-	return IRQ_HANDLED;
-}
-
-static irqreturn_t psc_dma_bcom_irq_rx(int irq, void *_psc_dma_stream)
-{
-	struct psc_dma_stream *s = _psc_dma_stream;
-
-	spin_lock(&s->psc_dma->lock);
-	/* For each finished period, dequeue the completed period buffer
-	 * and enqueue a new one in it's place. */
-	while (bcom_buffer_done(s->bcom_task)) {
-		bcom_retrieve_buffer(s->bcom_task, NULL, NULL);
-
-		s->period_current_pt += s->period_bytes;
-		if (s->period_current_pt >= s->period_end)
-			s->period_current_pt = s->period_start;
+		if (++s->bd_count == s->bds_per_period) {
+			s->bd_count = 0;
+			elapsed = 1;
+		}
 
 		psc_dma_bcom_enqueue_next_buffer(s);
 	}
@@ -126,7 +98,7 @@ static irqreturn_t psc_dma_bcom_irq_rx(int irq, void *_psc_dma_stream)
 
 	/* If the stream is active, then also inform the PCM middle layer
 	 * of the period finished event. */
-	if (s->active)
+	if (elapsed && s->active)
 		snd_pcm_period_elapsed(s->stream);
 
 	return IRQ_HANDLED;
@@ -153,7 +125,7 @@ static int psc_dma_trigger(struct snd_pcm_substream *substream, int cmd)
 	struct mpc52xx_psc __iomem *regs = psc_dma->psc_regs;
 	u16 imr;
 	unsigned long flags;
-	int i;
+	int period_bytes, i;
 
 	if (substream->pstr->stream == SNDRV_PCM_STREAM_CAPTURE)
 		s = &psc_dma->capture;
@@ -166,37 +138,39 @@ static int psc_dma_trigger(struct snd_pcm_substream *substream, int cmd)
 
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
-		s->period_bytes = frames_to_bytes(runtime,
-						  runtime->period_size);
+		period_bytes = frames_to_bytes(runtime, runtime->period_size);
 		s->period_start = virt_to_phys(runtime->dma_area);
 		s->period_end = s->period_start +
-				(s->period_bytes * runtime->periods);
+				(period_bytes * runtime->periods);
 		s->period_next_pt = s->period_start;
 		s->period_current_pt = s->period_start;
-		s->period_size = runtime->period_size;
-		s->active = 1;
 
-		/* track appl_ptr so that we have a better chance of detecting
-		 * end of stream and not over running it.
-		 */
-		s->runtime = runtime;
-		s->appl_ptr = s->runtime->control->appl_ptr -
-				(runtime->period_size * runtime->periods);
+		/* Split the periods into as many BDs as the ring allows, so
+		 * that the pointer moves more often than once per period.
+		 * The gen_bd tasks move whole words. */
+		s->bds_per_period = min_t(int,
+				(PSC_DMA_NUM_BD - 1) / runtime->periods,
+				period_bytes / PSC_DMA_BD_MIN_BYTES);
+		while (s->bds_per_period > 1 &&
+		       period_bytes % (s->bds_per_period * 4))
+			s->bds_per_period--;
+		if (s->bds_per_period < 1)
+			s->bds_per_period = 1;
+		s->bd_bytes = period_bytes / s->bds_per_period;
+		s->bd_count = 0;
+		s->active = 1;
 
-		/* Fill up the bestcomm bd queue and enable DMA.
+		/* Queue the whole buffer and enable DMA.
 		 * This will begin filling the PSC's fifo.
 		 */
 		spin_lock_irqsave(&psc_dma->lock, flags);
 
-		if (substream->pstr->stream == SNDRV_PCM_STREAM_CAPTURE) {
+		if (substream->pstr->stream == SNDRV_PCM_STREAM_CAPTURE)
 			bcom_gen_bd_rx_reset(s->bcom_task);
-			for (i = 0; i < runtime->periods; i++)
-				if (!bcom_queue_full(s->bcom_task))
-					psc_dma_bcom_enqueue_next_buffer(s);
-		} else {
+		else
 			bcom_gen_bd_tx_reset(s->bcom_task);
-			psc_dma_bcom_enqueue_tx(s);
-		}
+		for (i = 0; i < runtime->periods * s->bds_per_period; i++)
+			psc_dma_bcom_enqueue_next_buffer(s);
 
 		bcom_enable(s->bcom_task);
 		spin_unlock_irqrestore(&psc_dma->lock, flags);
@@ -256,7 +230,7 @@ static const struct snd_pcm_hardware psc_dma_hardware = {
 	.period_bytes_max	= 1024 * 1024,
 	.period_bytes_min	= 32,
 	.periods_min		= 2,
-	.periods_max		= 256,
+	.periods_max		= PSC_DMA_NUM_BD - 1,
 	.buffer_bytes_max	= 2 * 1024 * 1024,
 	.fifo_size		= 512,
 };
@@ -319,14 +293,30 @@ psc_dma_pointer(struct snd_pcm_substream *substream)
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct psc_dma *psc_dma = rtd->dai->cpu_dai->private_data;
 	struct psc_dma_stream *s;
+	struct bcom_task *tsk;
+	unsigned long flags;
 	dma_addr_t count;
+	int i;
 
 	if (substream->pstr->stream == SNDRV_PCM_STREAM_CAPTURE)
 		s = &psc_dma->capture;
 	else
 		s = &psc_dma->playback;
+	tsk = s->bcom_task;
 
+	/* Also count the BDs the task has finished but whose interrupt
+	 * hasn't been handled yet */
+	spin_lock_irqsave(&psc_dma->lock, flags);
 	count = s->period_current_pt - s->period_start;
+	for (i = tsk->outdex; i != tsk->index; i = (i + 1) % tsk->num_bd) {
+		if (bcom_get_bd(tsk, i)->status & BCOM_BD_READY)
+			break;
+		count += s->bd_bytes;
+	}
+	spin_unlock_irqrestore(&psc_dma->lock, flags);
+
+	if (count >= s->period_end - s->period_start)
+		count -= s->period_end - s->period_start;
 
 	return bytes_to_frames(substream->runtime, count);
 }
@@ -470,9 +460,9 @@ int mpc5200_audio_dma_create(struct of_device *op)
 	 * DMA tasks */
 	fifo = res.start + offsetof(struct mpc52xx_psc, buffer.buffer_32);
 	psc_dma->capture.bcom_task =
-		bcom_psc_gen_bd_rx_init(psc_dma->id, 10, fifo, 512);
+		bcom_psc_gen_bd_rx_init(psc_dma->id, PSC_DMA_NUM_BD, fifo, 512);
 	psc_dma->playback.bcom_task =
-		bcom_psc_gen_bd_tx_init(psc_dma->id, 10, fifo);
+		bcom_psc_gen_bd_tx_init(psc_dma->id, PSC_DMA_NUM_BD, fifo);
 	if (!psc_dma->capture.bcom_task ||
 	    !psc_dma->playback.bcom_task) {
 		dev_err(&op->dev, "Could not allocate bestcomm tasks\n");
@@ -514,10 +504,10 @@ int mpc5200_audio_dma_create(struct of_device *op)
 	rc = request_irq(psc_dma->irq, &psc_dma_status_irq, IRQF_SHARED,
 			 "psc-dma-status", psc_dma);
 	rc |= request_irq(psc_dma->capture.irq,
-			  &psc_dma_bcom_irq_rx, IRQF_SHARED,
+			  &psc_dma_bcom_irq, IRQF_SHARED,
 			  "psc-dma-capture", &psc_dma->capture);
 	rc |= request_irq(psc_dma->playback.irq,
-			  &psc_dma_bcom_irq_tx, IRQF_SHARED,
+			  &psc_dma_bcom_irq, IRQF_SHARED,
 			  "psc-dma-playback", &psc_dma->playback);
 	if (rc) {
 		free_irq(psc_dma->irq, psc_dma);
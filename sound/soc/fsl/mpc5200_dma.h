@@ -7,6 +7,13 @@
 
 #define PSC_STREAM_NAME_LEN 32
 
+/* Size of the BestComm BD rings.  All BDs of a stream stay queued, so this
+ * bounds the number of periods of the ALSA buffer */
+#define PSC_DMA_NUM_BD		64
+
+/* Smallest BD a period gets split into, see psc_dma_trigger() */
+#define PSC_DMA_BD_MIN_BYTES	128
+
 /**
  * psc_ac97_stream - Data specific to a single stream (playback or capture)
  * @active:		flag indicating if the stream is active
@@ -16,12 +23,13 @@
  * @period_start:	physical address of start of DMA region
  * @period_end:		physical address of end of DMA region
  * @period_next_pt:	physical address of next DMA buffer to enqueue
- * @period_bytes:	size of DMA period in bytes
+ * @period_current_pt:	physical address of next DMA buffer to complete
+ * @bd_bytes:		size of a single BD; a period is split in
+ *			bds_per_period of them
+ * @bds_per_period:	number of BDs making up a period
+ * @bd_count:		BDs completed in the current period
  */
 struct psc_dma_stream {
-	struct snd_pcm_runtime *runtime;
-	snd_pcm_uframes_t appl_ptr;
-
 	int active;
 	struct psc_dma *psc_dma;
 	struct bcom_task *bcom_task;
@@ -31,8 +39,9 @@ struct psc_dma_stream {
 	dma_addr_t period_end;
 	dma_addr_t period_next_pt;
 	dma_addr_t period_current_pt;
-	int period_bytes;
-	int period_size;
+	int bd_bytes;
+	int bds_per_period;
+	int bd_count;
 };
 
 /**